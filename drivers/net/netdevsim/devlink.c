@@ -60,6 +60,20 @@ static u64 nsim_ipv6_fib_rules_res_occ_get(void *priv)
 	return nsim_fib_get_val(net, NSIM_RESOURCE_IPV6_FIB_RULES, false);
 }
 
+static u64 nsim_ipv6_seg6_encap_res_occ_get(void *priv)
+{
+	struct net *net = priv;
+
+	return nsim_fib_get_val(net, NSIM_RESOURCE_IPV6_SEG6_ENCAP, false);
+}
+
+static u64 nsim_ipv6_seg6_local_res_occ_get(void *priv)
+{
+	struct net *net = priv;
+
+	return nsim_fib_get_val(net, NSIM_RESOURCE_IPV6_SEG6_LOCAL, false);
+}
+
 static int devlink_resources_register(struct devlink *devlink)
 {
 	struct devlink_resource_size_params params = {
@@ -127,6 +141,24 @@ static int devlink_resources_register(struct devlink *devlink)
 		return err;
 	}
 
+	n = nsim_fib_get_val(net, NSIM_RESOURCE_IPV6_SEG6_ENCAP, true);
+	err = devlink_resource_register(devlink, "seg6-encap", n,
+					NSIM_RESOURCE_IPV6_SEG6_ENCAP,
+					NSIM_RESOURCE_IPV6, &params);
+	if (err) {
+		pr_err("Failed to register IPv6 seg6 encap resource\n");
+		return err;
+	}
+
+	n = nsim_fib_get_val(net, NSIM_RESOURCE_IPV6_SEG6_LOCAL, true);
+	err = devlink_resource_register(devlink, "seg6-local", n,
+					NSIM_RESOURCE_IPV6_SEG6_LOCAL,
+					NSIM_RESOURCE_IPV6, &params);
+	if (err) {
+		pr_err("Failed to register IPv6 seg6 local resource\n");
+		return err;
+	}
+
 	devlink_resource_occ_get_register(devlink,
 					  NSIM_RESOURCE_IPV4_FIB,
 					  nsim_ipv4_fib_resource_occ_get,
@@ -143,6 +175,14 @@ static int devlink_resources_register(struct devlink *devlink)
 					  NSIM_RESOURCE_IPV6_FIB_RULES,
 					  nsim_ipv6_fib_rules_res_occ_get,
 					  net);
+	devlink_resource_occ_get_register(devlink,
+					  NSIM_RESOURCE_IPV6_SEG6_ENCAP,
+					  nsim_ipv6_seg6_encap_res_occ_get,
+					  net);
+	devlink_resource_occ_get_register(devlink,
+					  NSIM_RESOURCE_IPV6_SEG6_LOCAL,
+					  nsim_ipv6_seg6_local_res_occ_get,
+					  net);
 out:
 	return err;
 }
@@ -151,7 +191,8 @@ static int nsim_devlink_reload(struct devlink *devlink)
 {
 	enum nsim_resource_id res_ids[] = {
 		NSIM_RESOURCE_IPV4_FIB, NSIM_RESOURCE_IPV4_FIB_RULES,
-		NSIM_RESOURCE_IPV6_FIB, NSIM_RESOURCE_IPV6_FIB_RULES
+		NSIM_RESOURCE_IPV6_FIB, NSIM_RESOURCE_IPV6_FIB_RULES,
+		NSIM_RESOURCE_IPV6_SEG6_ENCAP, NSIM_RESOURCE_IPV6_SEG6_LOCAL
 	};
 	struct net *net = nsim_devlink_net(devlink);
 	int i;
@@ -175,7 +216,8 @@ static void nsim_devlink_net_reset(struct net *net)
 {
 	enum nsim_resource_id res_ids[] = {
 		NSIM_RESOURCE_IPV4_FIB, NSIM_RESOURCE_IPV4_FIB_RULES,
-		NSIM_RESOURCE_IPV6_FIB, NSIM_RESOURCE_IPV6_FIB_RULES
+		NSIM_RESOURCE_IPV6_FIB, NSIM_RESOURCE_IPV6_FIB_RULES,
+		NSIM_RESOURCE_IPV6_SEG6_ENCAP, NSIM_RESOURCE_IPV6_SEG6_LOCAL
 	};
 	int i;
 
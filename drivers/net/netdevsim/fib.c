@@ -19,6 +19,9 @@
 #include <net/ip6_fib.h>
 #include <net/fib_rules.h>
 #include <net/netns/generic.h>
+#include <net/seg6.h>
+#include <linux/seg6_iptunnel.h>
+#include <linux/seg6_local.h>
 
 #include "netdevsim.h"
 
@@ -32,11 +35,21 @@ struct nsim_per_fib_data {
 	struct nsim_fib_entry rules;
 };
 
+/* SRv6 state lives in tables separate from the fib itself */
+struct nsim_seg6_data {
+	struct nsim_fib_entry encap;
+	struct nsim_fib_entry local;
+};
+
 struct nsim_fib_data {
 	struct nsim_per_fib_data ipv4;
 	struct nsim_per_fib_data ipv6;
+	struct nsim_seg6_data seg6;
 };
 
+/* deepest segment list the emulated pipeline can push */
+#define NSIM_SEG6_MAX_SEGS	8
+
 static unsigned int nsim_fib_net_id;
 
 u64 nsim_fib_get_val(struct net *net, enum nsim_resource_id res_id, bool max)
@@ -57,6 +70,12 @@ u64 nsim_fib_get_val(struct net *net, enum nsim_resource_id res_id, bool max)
 	case NSIM_RESOURCE_IPV6_FIB_RULES:
 		entry = &fib_data->ipv6.rules;
 		break;
+	case NSIM_RESOURCE_IPV6_SEG6_ENCAP:
+		entry = &fib_data->seg6.encap;
+		break;
+	case NSIM_RESOURCE_IPV6_SEG6_LOCAL:
+		entry = &fib_data->seg6.local;
+		break;
 	default:
 		return 0;
 	}
@@ -83,6 +102,12 @@ int nsim_fib_set_max(struct net *net, enum nsim_resource_id res_id, u64 val)
 	case NSIM_RESOURCE_IPV6_FIB_RULES:
 		entry = &fib_data->ipv6.rules;
 		break;
+	case NSIM_RESOURCE_IPV6_SEG6_ENCAP:
+		entry = &fib_data->seg6.encap;
+		break;
+	case NSIM_RESOURCE_IPV6_SEG6_LOCAL:
+		entry = &fib_data->seg6.local;
+		break;
 	default:
 		return 0;
 	}
@@ -154,7 +179,136 @@ static int nsim_fib_account(struct nsim_fib_entry *entry, bool add,
 	return err;
 }
 
-static int nsim_fib_event(struct fib_notifier_info *info, bool add)
+static bool nsim_seg6_srh_supported(const struct ipv6_sr_hdr *srh)
+{
+	return srh && !sr_has_hmac(srh) &&
+	       srh->first_segment < NSIM_SEG6_MAX_SEGS;
+}
+
+static bool nsim_seg6_supported(const struct seg6_offload_info *seg6)
+{
+	const struct seg6_encap_offload *encap = &seg6->encap;
+	const struct seg6_local_offload *local = &seg6->local;
+
+	if (seg6->type == LWTUNNEL_ENCAP_SEG6)
+		return encap->mode != SEG6_IPTUN_MODE_L2ENCAP &&
+		       nsim_seg6_srh_supported(encap->srh);
+
+	if (local->sw_only)
+		return false;
+
+	switch (local->action) {
+	case SEG6_LOCAL_ACTION_END:
+	case SEG6_LOCAL_ACTION_END_X:
+	case SEG6_LOCAL_ACTION_END_T:
+	case SEG6_LOCAL_ACTION_END_DX6:
+	case SEG6_LOCAL_ACTION_END_DX4:
+	case SEG6_LOCAL_ACTION_END_DT6:
+		return true;
+	case SEG6_LOCAL_ACTION_END_B6:
+	case SEG6_LOCAL_ACTION_END_B6_ENCAP:
+		return nsim_seg6_srh_supported(local->srh);
+	}
+
+	return false;
+}
+
+static struct nsim_fib_entry *nsim_fib6_seg6_entry(struct nsim_fib_data *data,
+						    struct fib6_info *rt)
+{
+	struct lwtunnel_state *lwt = rt->fib6_nh.nh_lwtstate;
+
+	if (!lwt)
+		return NULL;
+
+	switch (lwt->type) {
+	case LWTUNNEL_ENCAP_SEG6:
+		return &data->seg6.encap;
+	case LWTUNNEL_ENCAP_SEG6_LOCAL:
+		return &data->seg6.local;
+	}
+
+	return NULL;
+}
+
+/* A seg6 route which cannot be executed by the emulated pipeline, or
+ * does not fit in its tables, is still installed but trapped to the
+ * CPU so that the kernel forwards it. Only offloaded routes consume
+ * seg6 resources.
+ */
+static void nsim_fib6_seg6_add(struct nsim_fib_data *data,
+			       struct fib6_entry_notifier_info *fen6_info)
+{
+	struct fib6_info *rt = fen6_info->rt;
+	struct nsim_fib_entry *entry;
+
+	entry = nsim_fib6_seg6_entry(data, rt);
+
+	/* the route may be replayed after an inconsistent dump */
+	rt->fib6_nh.nh_flags &= ~(RTNH_F_OFFLOAD | RTNH_F_TRAP);
+
+	if (nsim_seg6_supported(fen6_info->seg6) && entry->num < entry->max) {
+		entry->num++;
+		rt->fib6_nh.nh_flags |= RTNH_F_OFFLOAD;
+	} else {
+		rt->fib6_nh.nh_flags |= RTNH_F_TRAP;
+	}
+}
+
+static void nsim_fib6_seg6_del(struct nsim_fib_data *data,
+			       struct fib6_info *rt)
+{
+	struct nsim_fib_entry *entry;
+
+	entry = nsim_fib6_seg6_entry(data, rt);
+	if (!entry)
+		return;
+
+	if (rt->fib6_nh.nh_flags & RTNH_F_OFFLOAD)
+		entry->num--;
+	rt->fib6_nh.nh_flags &= ~(RTNH_F_OFFLOAD | RTNH_F_TRAP);
+}
+
+static int nsim_fib6_event(struct nsim_fib_data *data,
+			   struct fib_notifier_info *info,
+			   unsigned long event)
+{
+	struct fib6_entry_notifier_info *fen6_info;
+	struct fib6_info *sibling;
+	int err;
+
+	fen6_info = container_of(info, struct fib6_entry_notifier_info, info);
+
+	switch (event) {
+	case FIB_EVENT_ENTRY_ADD:
+		err = nsim_fib_account(&data->ipv6.fib, true, info->extack);
+		if (err)
+			return err;
+		break;
+	case FIB_EVENT_ENTRY_DEL:
+		nsim_fib_account(&data->ipv6.fib, false, info->extack);
+		nsim_fib6_seg6_del(data, fen6_info->rt);
+		return 0;
+	case FIB_EVENT_ENTRY_REPLACE:
+		/* the replaced routes go away without a DEL */
+		if (fen6_info->old_rt) {
+			nsim_fib6_seg6_del(data, fen6_info->old_rt);
+			list_for_each_entry(sibling,
+					    &fen6_info->old_rt->fib6_siblings,
+					    fib6_siblings)
+				nsim_fib6_seg6_del(data, sibling);
+		}
+		break;
+	}
+
+	if (fen6_info->seg6)
+		nsim_fib6_seg6_add(data, fen6_info);
+
+	return 0;
+}
+
+static int nsim_fib_event(struct fib_notifier_info *info,
+			  unsigned long event)
 {
 	struct nsim_fib_data *data = net_generic(info->net, nsim_fib_net_id);
 	struct netlink_ext_ack *extack = info->extack;
@@ -162,10 +316,13 @@ static int nsim_fib_event(struct fib_notifier_info *info, bool add)
 
 	switch (info->family) {
 	case AF_INET:
-		err = nsim_fib_account(&data->ipv4.fib, add, extack);
+		if (event != FIB_EVENT_ENTRY_REPLACE)
+			err = nsim_fib_account(&data->ipv4.fib,
+					       event == FIB_EVENT_ENTRY_ADD,
+					       extack);
 		break;
 	case AF_INET6:
-		err = nsim_fib_account(&data->ipv6.fib, add, extack);
+		err = nsim_fib6_event(data, info, event);
 		break;
 	}
 
@@ -185,8 +342,9 @@ static int nsim_fib_event_nb(struct notifier_block *nb, unsigned long event,
 		break;
 
 	case FIB_EVENT_ENTRY_ADD:  /* fall through */
+	case FIB_EVENT_ENTRY_REPLACE:  /* fall through */
 	case FIB_EVENT_ENTRY_DEL:
-		err = nsim_fib_event(info, event == FIB_EVENT_ENTRY_ADD);
+		err = nsim_fib_event(info, event);
 		break;
 	}
 
@@ -208,6 +366,9 @@ static void nsim_fib_dump_inconsistent(struct notifier_block *nb)
 
 		data->ipv6.fib.num = 0ULL;
 		data->ipv6.rules.num = 0ULL;
+
+		data->seg6.encap.num = 0ULL;
+		data->seg6.local.num = 0ULL;
 	}
 	rcu_read_unlock();
 }
@@ -227,6 +388,9 @@ static int __net_init nsim_fib_netns_init(struct net *net)
 	data->ipv6.fib.max = (u64)-1;
 	data->ipv6.rules.max = (u64)-1;
 
+	data->seg6.encap.max = (u64)-1;
+	data->seg6.local.max = (u64)-1;
+
 	return 0;
 }
 
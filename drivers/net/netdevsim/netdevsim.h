@@ -115,6 +115,8 @@ enum nsim_resource_id {
 	NSIM_RESOURCE_IPV6,
 	NSIM_RESOURCE_IPV6_FIB,
 	NSIM_RESOURCE_IPV6_FIB_RULES,
+	NSIM_RESOURCE_IPV6_SEG6_ENCAP,
+	NSIM_RESOURCE_IPV6_SEG6_LOCAL,
 };
 
 int nsim_devlink_setup(struct netdevsim *ns);
@@ -50,6 +50,14 @@ module_param(napi_tx, bool, 0644);
 /* Amount of XDP headroom to prepend to packets for use by xdp_adjust_head */
 #define VIRTIO_XDP_HEADROOM 256
 
+/* Largest page order multi-buffer frames are linearized into for XDP */
+#define VIRTIO_XDP_MAX_ORDER 2
+
+/* Overhead of a linearized XDP frame on top of the MTU */
+#define VIRTIO_XDP_OVERHEAD (VIRTIO_XDP_HEADROOM + VLAN_ETH_HLEN + \
+			     sizeof(struct padded_vnet_hdr) + \
+			     SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+
 /* RX packet size EWMA. The average packet size is used to determine the packet
  * buffer size when refilling RX rings. As the entire RX ring may be refilled
  * at once, the weight is chosen so that the EWMA will be insensitive to short-
@@ -480,28 +488,42 @@ static unsigned int virtnet_get_headroom(struct virtnet_info *vi)
 	return vi->xdp_queue_pairs ? VIRTIO_XDP_HEADROOM : 0;
 }
 
+/* Order of the page a frame spanning several mergeable buffers is
+ * linearized into, so that it fits the MTU plus XDP overhead.
+ */
+static unsigned int virtnet_xdp_page_order(struct virtnet_info *vi)
+{
+	unsigned int size = vi->dev->mtu + VIRTIO_XDP_OVERHEAD;
+
+	return min_t(unsigned int, get_order(size), VIRTIO_XDP_MAX_ORDER);
+}
+
 /* We copy the packet for XDP in the following cases:
  *
  * 1) Packet is scattered across multiple rx buffers.
  * 2) Headroom space is insufficient.
  *
- * This is inefficient but it's a temporary condition that
- * we hit right after XDP is enabled and until queue is refilled
- * with large buffers with sufficient headroom - so it should affect
- * at most queue size packets.
- * Afterwards, the conditions to enable
- * XDP should preclude the underlying device from sending packets
- * across multiple buffers (num_buf > 1), and we make sure buffers
- * have enough headroom.
+ * Insufficient headroom is a temporary condition that we hit right
+ * after XDP is enabled and until queue is refilled with buffers with
+ * sufficient headroom - so it should affect at most queue size packets.
+ *
+ * Scattered packets are also transient when the MTU fits a single
+ * buffer. With a larger MTU (jumbo frames with mergeable buffers), each
+ * frame spanning several buffers is copied into a compound page of
+ * @order, so that XDP programs see the whole frame linearly and can
+ * access and adjust its headers with the usual helpers.
  */
 static struct page *xdp_linearize_page(struct receive_queue *rq,
 				       u16 *num_buf,
 				       struct page *p,
 				       int offset,
 				       int page_off,
-				       unsigned int *len)
+				       unsigned int *len,
+				       unsigned int order)
 {
-	struct page *page = alloc_page(GFP_ATOMIC);
+	gfp_t gfp = GFP_ATOMIC | __GFP_NOWARN | (order ? __GFP_COMP : 0);
+	unsigned int size = PAGE_SIZE << order;
+	struct page *page = alloc_pages(gfp, order);
 
 	if (!page)
 		return NULL;
@@ -525,7 +547,7 @@ static struct page *xdp_linearize_page(struct receive_queue *rq,
 		/* guard against a misconfigured or uncooperative backend that
 		 * is sending packet larger than the MTU.
 		 */
-		if ((page_off + buflen + tailroom) > PAGE_SIZE) {
+		if ((page_off + buflen + tailroom) > size) {
 			put_page(p);
 			goto err_buf;
 		}
@@ -540,7 +562,7 @@ static struct page *xdp_linearize_page(struct receive_queue *rq,
 	*len = page_off - VIRTIO_XDP_HEADROOM;
 	return page;
 err_buf:
-	__free_pages(page, 0);
+	__free_pages(page, order);
 	return NULL;
 }
 
@@ -589,7 +611,7 @@ static struct sk_buff *receive_small(struct net_device *dev,
 				 SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
 			xdp_page = xdp_linearize_page(rq, &num_buf, page,
 						      offset, header_offset,
-						      &tlen);
+						      &tlen, 0);
 			if (!xdp_page)
 				goto err_xdp;
 
@@ -707,6 +729,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 	rcu_read_lock();
 	xdp_prog = rcu_dereference(rq->xdp_prog);
 	if (xdp_prog) {
+		unsigned int xdp_order = 0;
 		struct xdp_frame *xdpf;
 		struct page *xdp_page;
 		struct xdp_buff xdp;
@@ -715,17 +738,19 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 
 		/* This happens when rx buffer size is underestimated
 		 * or headroom is not enough because of the buffer
-		 * was refilled before XDP is set. This should only
-		 * happen for the first several packets, so we don't
-		 * care much about its performance.
+		 * was refilled before XDP is set, and for every frame
+		 * larger than a buffer when the MTU allows it.
 		 */
 		if (unlikely(num_buf > 1 ||
 			     headroom < virtnet_get_headroom(vi))) {
+			if (num_buf > 1)
+				xdp_order = virtnet_xdp_page_order(vi);
+
 			/* linearize data for XDP */
 			xdp_page = xdp_linearize_page(rq, &num_buf,
 						      page, offset,
 						      VIRTIO_XDP_HEADROOM,
-						      &len);
+						      &len, xdp_order);
 			if (!xdp_page)
 				goto err_xdp;
 			offset = VIRTIO_XDP_HEADROOM;
@@ -771,7 +796,8 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 				rcu_read_unlock();
 				put_page(page);
 				head_skb = page_to_skb(vi, rq, xdp_page,
-						       offset, len, PAGE_SIZE);
+						       offset, len,
+						       PAGE_SIZE << xdp_order);
 				return head_skb;
 			}
 			break;
@@ -809,7 +835,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			trace_xdp_exception(vi->dev, xdp_prog, act);
 		case XDP_DROP:
 			if (unlikely(xdp_page != page))
-				__free_pages(xdp_page, 0);
+				__free_pages(xdp_page, xdp_order);
 			goto err_xdp;
 		}
 	}
@@ -2218,6 +2244,10 @@ static int virtnet_xdp_set(struct net_device *dev, struct bpf_prog *prog,
 		return -EINVAL;
 	}
 
+	/* frames spanning several mergeable buffers get linearized */
+	if (vi->mergeable_rx_bufs)
+		max_sz = (PAGE_SIZE << VIRTIO_XDP_MAX_ORDER) - VIRTIO_XDP_OVERHEAD;
+
 	if (dev->mtu > max_sz) {
 		NL_SET_ERR_MSG_MOD(extack, "MTU too large to enable XDP");
 		netdev_warn(dev, "XDP requires MTU less than %lu\n", max_sz);
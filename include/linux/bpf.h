@@ -73,7 +73,9 @@ struct bpf_map {
 	u32 btf_value_id;
 	struct btf *btf;
 	bool unpriv_array;
-	/* 55 bytes hole */
+	/* bumped by every update or delete done from user space */
+	atomic_t gen;
+	/* 51 bytes hole */
 
 	/* The 3rd and 4th cacheline with misc members to avoid false sharing
 	 * particularly with refcounting.
@@ -598,6 +600,15 @@ static inline struct bpf_prog *bpf_prog_get_type_path(const char *name,
 {
 	return ERR_PTR(-EOPNOTSUPP);
 }
+
+static inline struct bpf_map *bpf_map_get_with_uref(u32 ufd)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+
+static inline void bpf_map_put_with_uref(struct bpf_map *map)
+{
+}
 #endif /* CONFIG_BPF_SYSCALL */
 
 static inline struct bpf_prog *bpf_prog_get_type(u32 ufd,
@@ -137,6 +137,7 @@ struct bpf_verifier_state {
 struct bpf_verifier_state_list {
 	struct bpf_verifier_state state;
 	struct bpf_verifier_state_list *next;
+	int miss_cnt, hit_cnt;
 };
 
 struct bpf_insn_aux_data {
@@ -198,6 +199,16 @@ struct bpf_verifier_env {
 	struct bpf_verifier_log log;
 	struct bpf_subprog_info subprog_info[BPF_MAX_SUBPROGS + 1];
 	u32 subprog_cnt;
+	/* states dropped from explored_states, freed when verification ends */
+	struct bpf_verifier_state_list *free_list;
+	u32 insn_processed;
+	/* insn_processed when the last state was added to explored_states */
+	u32 prev_insn_processed;
+	/* the following are used by the complexity summary */
+	u32 total_states;
+	u32 peak_states;
+	u32 explored_cnt;
+	u32 max_states_per_insn;
 };
 
 __printf(2, 0) void bpf_verifier_vlog(struct bpf_verifier_log *log,
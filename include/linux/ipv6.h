@@ -70,6 +70,7 @@ struct ipv6_devconf {
 #ifdef CONFIG_IPV6_SEG6_HMAC
 	__s32		seg6_require_hmac;
 #endif
+	__s32		seg6_xdp_meta;
 	__u32		enhanced_dad;
 	__u32		addr_gen_mode;
 	__s32		disable_policy;
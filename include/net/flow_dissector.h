@@ -184,6 +184,22 @@ struct flow_dissector_key_ip {
 	__u8	ttl;
 };
 
+/**
+ * struct flow_dissector_key_srh:
+ * @active_seg: segment pointed to by segments_left
+ * @last_seg: last segment of the path (segments[0])
+ * @tag: tag
+ * @segments_left: segments left
+ * @flags: flags
+ */
+struct flow_dissector_key_srh {
+	struct in6_addr active_seg;
+	struct in6_addr last_seg;
+	__be16	tag;
+	__u8	segments_left;
+	__u8	flags;
+};
+
 enum flow_dissector_key_id {
 	FLOW_DISSECTOR_KEY_CONTROL, /* struct flow_dissector_key_control */
 	FLOW_DISSECTOR_KEY_BASIC, /* struct flow_dissector_key_basic */
@@ -206,6 +222,7 @@ enum flow_dissector_key_id {
 	FLOW_DISSECTOR_KEY_MPLS, /* struct flow_dissector_key_mpls */
 	FLOW_DISSECTOR_KEY_TCP, /* struct flow_dissector_key_tcp */
 	FLOW_DISSECTOR_KEY_IP, /* struct flow_dissector_key_ip */
+	FLOW_DISSECTOR_KEY_SRH, /* struct flow_dissector_key_srh */
 
 	FLOW_DISSECTOR_KEY_MAX,
 };
@@ -87,6 +87,7 @@ struct fib6_node {
 struct fib6_gc_args {
 	int			timeout;
 	int			more;
+	unsigned int		budget;
 };
 
 #ifndef CONFIG_IPV6_SUBTREES
@@ -146,6 +147,9 @@ struct fib6_info {
 	struct list_head		fib6_siblings;
 	unsigned int			fib6_nsiblings;
 
+	/* on fib6_table->tb6_gc_list if the route expires or has exceptions */
+	struct list_head		fib6_gc_link;
+
 	atomic_t			fib6_ref;
 	unsigned long			expires;
 	struct dst_metrics		*fib6_metrics;
@@ -337,6 +341,9 @@ struct fib6_table {
 	struct inet_peer_base	tb6_peers;
 	unsigned int		flags;
 	unsigned int		fib_seq;
+	struct list_head	tb6_gc_list;
+	unsigned int		tb6_gc_nr;
+	unsigned int		tb6_gc_todo;	/* left in the current GC pass */
 #define RT6_TABLE_HAS_DFLT_ROUTER	BIT(0)
 };
 
@@ -361,9 +368,20 @@ typedef struct rt6_info *(*pol_lookup_t)(struct net *,
 					 struct flowi6 *,
 					 const struct sk_buff *, int);
 
+struct seg6_offload_info;
+
 struct fib6_entry_notifier_info {
 	struct fib_notifier_info info; /* must be first */
 	struct fib6_info *rt;
+	/* route being replaced, along with its siblings, on
+	 * FIB_EVENT_ENTRY_REPLACE; they are purged without a DEL
+	 */
+	struct fib6_info *old_rt;
+	/* set for seg6 and seg6local nexthops, see
+	 * include/net/seg6.h; drivers which offload the route
+	 * report it through RTNH_F_OFFLOAD or RTNH_F_TRAP
+	 */
+	const struct seg6_offload_info *seg6;
 };
 
 /*
@@ -416,6 +434,9 @@ void inet6_rt_notify(int event, struct fib6_info *rt, struct nl_info *info,
 		     unsigned int flags);
 
 void fib6_run_gc(unsigned long expires, struct net *net, bool force);
+void fib6_gc_link(struct fib6_info *rt);
+void fib6_update_expires(struct net *net, struct fib6_info *f6i,
+			 unsigned long expires);
 
 void fib6_gc_cleanup(void);
 
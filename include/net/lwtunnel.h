@@ -33,6 +33,29 @@ struct lwtunnel_state {
 	__u8            data[0];
 };
 
+/* outer header fields copied from the inner packet at transmit time */
+#define LWTUNNEL_TMPL_INHERIT_DSFIELD	BIT(0)
+#define LWTUNNEL_TMPL_INHERIT_FLOWLABEL	BIT(1)
+#define LWTUNNEL_TMPL_INHERIT_HOPLIMIT	BIT(2)
+/* outer flowlabel taken from the flow hash of the packet at transmit time */
+#define LWTUNNEL_TMPL_HASH_FLOWLABEL	BIT(3)
+
+/* Precomputed encapsulation of one flow, for fast paths that push the
+ * outer headers themselves instead of going through ->output(). Only
+ * IPv6 outer headers are supported: data holds the outer IPv6 header
+ * and its extension headers, payload_len being set by the user. dst is
+ * the route of the outer packet and mtu the largest inner packet that
+ * fits in it once encapsulated.
+ */
+struct lwtunnel_encap_tmpl {
+	struct dst_entry	*dst;
+	u16			mtu;
+	u16			len;
+	u16			flags;
+	__be16			protocol;
+	u8			data[0];
+};
+
 struct lwtunnel_encap_ops {
 	int (*build_state)(struct nlattr *encap,
 			   unsigned int family, const void *cfg,
@@ -46,6 +69,8 @@ struct lwtunnel_encap_ops {
 	int (*get_encap_size)(struct lwtunnel_state *lwtstate);
 	int (*cmp_encap)(struct lwtunnel_state *a, struct lwtunnel_state *b);
 	int (*xmit)(struct sk_buff *skb);
+	struct lwtunnel_encap_tmpl *(*get_encap_tmpl)(struct dst_entry *dst,
+						      u8 family);
 
 	struct module *owner;
 };
@@ -126,6 +151,9 @@ int lwtunnel_cmp_encap(struct lwtunnel_state *a, struct lwtunnel_state *b);
 int lwtunnel_output(struct net *net, struct sock *sk, struct sk_buff *skb);
 int lwtunnel_input(struct sk_buff *skb);
 int lwtunnel_xmit(struct sk_buff *skb);
+struct lwtunnel_encap_tmpl *lwtunnel_get_encap_tmpl(struct dst_entry *dst,
+						    u8 family);
+void lwtunnel_encap_tmpl_free(struct lwtunnel_encap_tmpl *tmpl);
 
 static inline void lwtunnel_set_redirect(struct dst_entry *dst)
 {
@@ -253,8 +281,27 @@ static inline int lwtunnel_xmit(struct sk_buff *skb)
 	return -EOPNOTSUPP;
 }
 
+static inline struct lwtunnel_encap_tmpl *
+lwtunnel_get_encap_tmpl(struct dst_entry *dst, u8 family)
+{
+	return NULL;
+}
+
+static inline void lwtunnel_encap_tmpl_free(struct lwtunnel_encap_tmpl *tmpl)
+{
+}
+
 #endif /* CONFIG_LWTUNNEL */
 
+#ifdef CONFIG_LWTUNNEL_BPF
+int bpf_lwt_reroute6(struct sk_buff *skb);
+#else
+static inline int bpf_lwt_reroute6(struct sk_buff *skb)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 #define MODULE_ALIAS_RTNL_LWT(encap_type) MODULE_ALIAS("rtnl-lwt-" __stringify(encap_type))
 
 #endif /* __NET_LWTUNNEL_H */
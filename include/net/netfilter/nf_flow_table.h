@@ -10,6 +10,7 @@
 #include <net/dst.h>
 
 struct nf_flowtable;
+struct lwtunnel_encap_tmpl;
 
 struct nf_flowtable_type {
 	struct list_head		list;
@@ -58,6 +59,9 @@ struct flow_offload_tuple {
 	u16				mtu;
 
 	struct dst_entry		*dst_cache;
+
+	/* outer headers of flows routed through a lwtunnel encap */
+	struct lwtunnel_encap_tmpl	*encap;
 };
 
 struct flow_offload_tuple_rhash {
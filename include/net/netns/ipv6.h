@@ -32,6 +32,12 @@ struct netns_sysctl_ipv6 {
 	int flowlabel_consistency;
 	int auto_flowlabels;
 	int icmpv6_time;
+	int icmpv6_errors_per_cpu_rate;
+	int icmpv6_errors_per_cpu_burst;
+	/* destination unreachable, time exceeded and parameter problem;
+	 * packet too big is never limited
+	 */
+	int icmpv6_errors_per_cpu_type_rate[3];
 	int anycast_src_echo_reply;
 	int ip_nonlocal_bind;
 	int fwmark_reflect;
@@ -73,6 +79,8 @@ struct netns_ipv6 {
 	spinlock_t		fib6_gc_lock;
 	unsigned int		 ip6_rt_gc_expire;
 	unsigned long		 ip6_rt_last_gc;
+	int			fib6_gc_more;
+	bool			fib6_gc_resume;
 #ifdef CONFIG_IPV6_MULTIPLE_TABLES
 	unsigned int		fib6_rules_require_fldissect;
 	bool			fib6_has_custom_rules;
@@ -82,6 +90,7 @@ struct netns_ipv6 {
 	struct fib_rules_ops    *fib6_rules_ops;
 #endif
 	struct sock		**icmp_sk;
+	struct icmpv6_err_ratelimit __percpu *icmpv6_err_rl;
 	struct sock             *ndisc_sk;
 	struct sock             *tcp_sk;
 	struct sock             *igmp_sk;
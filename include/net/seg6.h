@@ -18,6 +18,7 @@
 #include <linux/ipv6.h>
 #include <net/lwtunnel.h>
 #include <linux/seg6.h>
+#include <linux/seg6_genl.h>
 #include <linux/rhashtable.h>
 
 static inline void update_csum_diff4(struct sk_buff *skb, __be32 from,
@@ -39,12 +40,62 @@ static inline void update_csum_diff16(struct sk_buff *skb, __be32 *from,
 	skb->csum = ~csum_partial((char *)diff, sizeof(diff), ~skb->csum);
 }
 
+#define SEG6_OAM_QLEN_MAX	256
+
+/* Single-producer ring filled from the receive path of its CPU and
+ * drained by SEG6_CMD_DUMP_OAM under seg6_pernet_data->lock.
+ */
+struct seg6_oam_ring {
+	u32 head;
+	u32 tail;
+	u64 drops;
+	struct seg6_oam_sample samples[0];
+};
+
+struct seg6_oam_queue {
+	u32 qlen;
+	struct seg6_oam_ring __percpu *rings;
+};
+
 struct seg6_pernet_data {
 	struct mutex lock;
 	struct in6_addr __rcu *tun_src;
 #ifdef CONFIG_IPV6_SEG6_HMAC
 	struct rhashtable hmac_infos;
 #endif
+	struct seg6_oam_queue __rcu *oam_queue;
+};
+
+/* Hardware-friendly description of a seg6 or seg6local nexthop, handed
+ * to FIB notifier listeners along with the route. Pointers are only
+ * valid for the duration of the notifier call. The outer source of an
+ * encap policy is resolved once, at notification time: a later change
+ * of the seg6 tunnel source is not notified.
+ */
+struct seg6_encap_offload {
+	int mode;			/* SEG6_IPTUN_MODE_* */
+	struct ipv6_sr_hdr *srh;	/* NULL for per-class policies */
+	struct in6_addr saddr;		/* outer source in encap mode */
+	u32 mtu;			/* 0 unless configured */
+};
+
+struct seg6_local_offload {
+	int action;			/* SEG6_LOCAL_ACTION_* */
+	struct ipv6_sr_hdr *srh;	/* End.B6 and End.B6.Encap */
+	int table;
+	struct in_addr nh4;
+	struct in6_addr nh6;
+	int iif;
+	int oif;
+	bool sw_only;			/* programs, policers, OAM, ... */
+};
+
+struct seg6_offload_info {
+	u16 type;			/* LWTUNNEL_ENCAP_SEG6{,_LOCAL} */
+	union {
+		struct seg6_encap_offload encap;
+		struct seg6_local_offload local;
+	};
 };
 
 static inline struct seg6_pernet_data *seg6_pernet(struct net *net)
@@ -67,6 +118,38 @@ extern bool seg6_validate_srh(struct ipv6_sr_hdr *srh, int len);
 extern int seg6_do_srh_encap(struct sk_buff *skb, struct ipv6_sr_hdr *osrh,
 			     int proto);
 extern int seg6_do_srh_inline(struct sk_buff *skb, struct ipv6_sr_hdr *osrh);
+extern struct ipv6_sr_hdr *seg6_lwt_policy(struct lwtunnel_state *lwt,
+					   struct net_device *dev, int *mode,
+					   struct in6_addr *saddr);
 extern int seg6_lookup_nexthop(struct sk_buff *skb, struct in6_addr *nhaddr,
 			       u32 tbl_id);
+extern void seg6_lwt_offload_fill(struct lwtunnel_state *lwt,
+				  struct net_device *dev,
+				  struct seg6_encap_offload *encap);
+extern void seg6_local_offload_fill(struct lwtunnel_state *lwt,
+				    struct seg6_local_offload *local);
+extern bool seg6_offload_fill(struct lwtunnel_state *lwt,
+			      struct net_device *dev,
+			      struct seg6_offload_info *info);
+extern void __seg6_oam_sample(struct sk_buff *skb, struct ipv6_sr_hdr *srh);
+extern bool __seg6_xdp_meta_get(struct sk_buff *skb,
+				struct sr6_xdp_meta *meta);
+
+/* fetch and consume the SRH parse results left by XDP, if any */
+static inline bool seg6_xdp_meta_get(struct sk_buff *skb,
+				     struct sr6_xdp_meta *meta)
+{
+	if (likely(skb_metadata_len(skb) < sizeof(*meta)))
+		return false;
+
+	return __seg6_xdp_meta_get(skb, meta);
+}
+
+/* record a timestamped summary of O-flagged packets */
+static inline void seg6_oam_sample(struct sk_buff *skb,
+				   struct ipv6_sr_hdr *srh)
+{
+	if (unlikely(srh->flags & SR6_FLAG1_OAM))
+		__seg6_oam_sample(skb, srh);
+}
 #endif
@@ -22,12 +22,62 @@
 extern int seg6_lookup_nexthop(struct sk_buff *skb, struct in6_addr *nhaddr,
 			       u32 tbl_id);
 
+#define SEG6_BPF_REC_SCRIPT_LEN	32
+
+#define SEG6_BPF_REC_MARK	(1 << 0)
+#define SEG6_BPF_REC_PRIORITY	(1 << 1)
+
+/* Side effects of one End.BPF run, recorded for the per-SID flow cache.
+ * SRH writes are kept as a script of (offset from the SRH, length, bytes)
+ * tuples. Anything that cannot be replayed marks the run uncacheable.
+ */
+struct seg6_bpf_cache_rec {
+	bool uncacheable;
+	bool flush;
+	u8 action;		/* 0, SEG6_LOCAL_ACTION_END_X or _END_T */
+	u8 flags;		/* SEG6_BPF_REC_* */
+	int table;
+	struct in6_addr nh6;
+	u32 action_mark;	/* skb->mark the nexthop was looked up with */
+	u32 mark;
+	u32 priority;
+	u8 script_len;
+	u8 script[SEG6_BPF_REC_SCRIPT_LEN];
+};
+
 struct seg6_bpf_srh_state {
 	bool valid;
 	bool none;
 	u16 hdrlen;
+	struct seg6_bpf_cache_rec *rec;	/* only set while recording */
 };
 
 DECLARE_PER_CPU(struct seg6_bpf_srh_state, seg6_bpf_srh_states);
 
+static inline void seg6_bpf_rec_uncacheable(struct seg6_bpf_srh_state *state)
+{
+	if (state->rec)
+		state->rec->uncacheable = true;
+}
+
+static inline void seg6_bpf_rec_write(struct seg6_bpf_srh_state *state,
+				      int off, const void *from, u32 len)
+{
+	struct seg6_bpf_cache_rec *rec = state->rec;
+
+	if (!rec)
+		return;
+
+	if (off < 0 || off > U8_MAX ||
+	    rec->script_len + 2 + len > SEG6_BPF_REC_SCRIPT_LEN) {
+		rec->uncacheable = true;
+		return;
+	}
+
+	rec->script[rec->script_len++] = off;
+	rec->script[rec->script_len++] = len;
+	memcpy(&rec->script[rec->script_len], from, len);
+	rec->script_len += len;
+}
+
 #endif
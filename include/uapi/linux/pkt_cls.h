@@ -469,6 +469,17 @@ enum {
 	TCA_FLOWER_KEY_IP_TTL,		/* u8 */
 	TCA_FLOWER_KEY_IP_TTL_MASK,	/* u8 */
 
+	TCA_FLOWER_KEY_SRH_SEGMENTS_LEFT,	/* u8 */
+	TCA_FLOWER_KEY_SRH_SEGMENTS_LEFT_MASK,	/* u8 */
+	TCA_FLOWER_KEY_SRH_FLAGS,	/* u8 */
+	TCA_FLOWER_KEY_SRH_FLAGS_MASK,	/* u8 */
+	TCA_FLOWER_KEY_SRH_TAG,		/* be16 */
+	TCA_FLOWER_KEY_SRH_TAG_MASK,	/* be16 */
+	TCA_FLOWER_KEY_SRH_ACTIVE_SEG,	/* struct in6_addr */
+	TCA_FLOWER_KEY_SRH_ACTIVE_SEG_MASK,/* struct in6_addr */
+	TCA_FLOWER_KEY_SRH_LAST_SEG,	/* struct in6_addr */
+	TCA_FLOWER_KEY_SRH_LAST_SEG_MASK,/* struct in6_addr */
+
 	__TCA_FLOWER_MAX,
 };
 
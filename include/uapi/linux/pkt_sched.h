@@ -372,6 +372,7 @@ enum {
 	TCA_HTB_RATE64,
 	TCA_HTB_CEIL64,
 	TCA_HTB_PAD,
+	TCA_HTB_SHARED,		/* u32, cross-queue token pool id, 0 for none */
 	__TCA_HTB_MAX,
 };
 
@@ -43,6 +43,7 @@ struct ipv6_sr_hdr {
 #define SR6_TLV_OPAQUE		3
 #define SR6_TLV_PADDING		4
 #define SR6_TLV_HMAC		5
+#define SR6_TLV_TIMESTAMP	124
 
 #define sr_has_hmac(srh) ((srh)->flags & SR6_FLAG1_HMAC)
 
@@ -52,4 +53,33 @@ struct sr6_tlv {
 	__u8 data[0];
 };
 
+/* Carried by OAM echo replies: receive and transmit time of the probe at
+ * the responding SID, in nanoseconds since the epoch.
+ */
+struct sr6_tlv_tstamp {
+	__u8	type;
+	__u8	len;
+	__u16	reserved;
+	__be32	ifindex;
+	__be64	rx_tstamp;
+	__be64	tx_tstamp;
+};
+
+/* SRH parse results handed from XDP to the stack. An XDP program stores
+ * this structure at the end of the packet metadata area (i.e. right
+ * before the packet data), in host byte order, before returning XDP_PASS.
+ * It is only used on devices where the seg6_xdp_meta sysctl is set.
+ */
+struct sr6_xdp_meta {
+	__u32	magic;
+	__u16	srh_off;	/* from the start of the IPv6 header */
+	__u8	segments_left;
+	__u8	flags;
+};
+
+#define SR6_XDP_META_MAGIC	0x53524836
+
+#define SR6_XDP_META_VALID	(1 << 0)	/* SRH is well-formed */
+#define SR6_XDP_META_HMAC	(1 << 1)	/* HMAC policy already enforced */
+
 #endif
@@ -2,6 +2,9 @@
 #ifndef _UAPI_LINUX_SEG6_GENL_H
 #define _UAPI_LINUX_SEG6_GENL_H
 
+#include <linux/types.h>
+#include <linux/in6.h>
+
 #define SEG6_GENL_NAME		"SEG6"
 #define SEG6_GENL_VERSION	0x1
 
@@ -14,6 +17,9 @@ enum {
 	SEG6_ATTR_SECRETLEN,
 	SEG6_ATTR_ALGID,
 	SEG6_ATTR_HMACINFO,
+	SEG6_ATTR_OAM_QLEN,
+	SEG6_ATTR_OAM_DROPS,
+	SEG6_ATTR_OAM_SAMPLE,
 	__SEG6_ATTR_MAX,
 };
 
@@ -25,9 +31,25 @@ enum {
 	SEG6_CMD_DUMPHMAC,
 	SEG6_CMD_SET_TUNSRC,
 	SEG6_CMD_GET_TUNSRC,
+	SEG6_CMD_SET_OAM,
+	SEG6_CMD_GET_OAM,
+	SEG6_CMD_DUMP_OAM,
 	__SEG6_CMD_MAX,
 };
 
 #define SEG6_CMD_MAX (__SEG6_CMD_MAX - 1)
 
+/* One entry of the O-flag sample queue (SEG6_ATTR_OAM_SAMPLE) */
+struct seg6_oam_sample {
+	__u64		rx_tstamp;	/* CLOCK_REALTIME, in ns */
+	struct in6_addr	saddr;
+	struct in6_addr	daddr;		/* active segment on receive */
+	__u32		ifindex;
+	__u16		tag;
+	__u8		segments_left;
+	__u8		first_segment;
+	__u8		flags;
+	__u8		reserved[7];
+};
+
 #endif
@@ -20,10 +20,38 @@
 enum {
 	SEG6_IPTUNNEL_UNSPEC,
 	SEG6_IPTUNNEL_SRH,
+	SEG6_IPTUNNEL_CLASS_KEY,	/* u32, SEG6_IPTUN_CLASS_* */
+	SEG6_IPTUNNEL_CLASSES,		/* nested list of SEG6_IPTUNNEL_CLASS */
+	SEG6_IPTUNNEL_MTU,		/* u32, path MTU of the policy */
+	SEG6_IPTUNNEL_MSS_CLAMP,	/* flag, clamp MSS of forwarded SYNs */
 	__SEG6_IPTUNNEL_MAX,
 };
 #define SEG6_IPTUNNEL_MAX (__SEG6_IPTUNNEL_MAX - 1)
 
+enum {
+	SEG6_IPTUNNEL_CLASS_UNSPEC,
+	SEG6_IPTUNNEL_CLASS,		/* nested, one per traffic class */
+	__SEG6_IPTUNNEL_CLASS_LIST_MAX,
+};
+#define SEG6_IPTUNNEL_CLASS_LIST_MAX (__SEG6_IPTUNNEL_CLASS_LIST_MAX - 1)
+
+enum {
+	SEG6_IPTUNNEL_CLASS_ATTR_UNSPEC,
+	SEG6_IPTUNNEL_CLASS_VALUE,	/* u32, mark or DSCP to match */
+	SEG6_IPTUNNEL_CLASS_SRH,	/* struct ipv6_sr_hdr */
+	__SEG6_IPTUNNEL_CLASS_MAX,
+};
+#define SEG6_IPTUNNEL_CLASS_MAX (__SEG6_IPTUNNEL_CLASS_MAX - 1)
+
+/* how SEG6_IPTUNNEL_CLASSES entries are selected */
+enum {
+	SEG6_IPTUN_CLASS_NONE,
+	SEG6_IPTUN_CLASS_MARK,		/* skb->mark */
+	SEG6_IPTUN_CLASS_DSCP,		/* DSCP of the inner IPv4/IPv6 header */
+};
+
+#define SEG6_IPTUN_CLASSES_MAX	16
+
 struct seg6_iptunnel_encap {
 	int mode;
 	struct ipv6_sr_hdr srh[0];
@@ -26,6 +26,9 @@ enum {
 	SEG6_LOCAL_IIF,
 	SEG6_LOCAL_OIF,
 	SEG6_LOCAL_BPF,
+	SEG6_LOCAL_OAM,
+	SEG6_LOCAL_POLICER,
+	SEG6_LOCAL_LB,
 	__SEG6_LOCAL_MAX,
 };
 #define SEG6_LOCAL_MAX (__SEG6_LOCAL_MAX - 1)
@@ -62,6 +65,10 @@ enum {
 	SEG6_LOCAL_ACTION_END_AM	= 14,
 	/* custom BPF action */
 	SEG6_LOCAL_ACTION_END_BPF	= 15,
+	/* answer echo probes, forward as End otherwise */
+	SEG6_LOCAL_ACTION_END_OAM	= 16,
+	/* steer flows to a backend SID by consistent hashing */
+	SEG6_LOCAL_ACTION_END_LB	= 17,
 
 	__SEG6_LOCAL_ACTION_MAX,
 };
@@ -72,9 +79,63 @@ enum {
 	SEG6_LOCAL_BPF_PROG_UNSPEC,
 	SEG6_LOCAL_BPF_PROG,
 	SEG6_LOCAL_BPF_PROG_NAME,
+	SEG6_LOCAL_BPF_PROG_CACHE,	/* u32, flow cache entries per CPU */
+	SEG6_LOCAL_BPF_PROG_ARRAY,	/* u32, BPF_MAP_TYPE_PROG_ARRAY fd, id on dumps */
+	SEG6_LOCAL_BPF_PROG_INDEX,	/* u32, slot of the program in PROG_ARRAY */
 	__SEG6_LOCAL_BPF_PROG_MAX,
 };
 
 #define SEG6_LOCAL_BPF_PROG_MAX (__SEG6_LOCAL_BPF_PROG_MAX - 1)
 
+enum {
+	SEG6_LOCAL_POLICER_UNSPEC,
+	SEG6_LOCAL_POLICER_RATE,	/* u32, packets per second and per CPU */
+	SEG6_LOCAL_POLICER_BURST,	/* u32, packets */
+	SEG6_LOCAL_POLICER_DROPS,	/* u64, read-only */
+	SEG6_LOCAL_POLICER_PAD,
+	__SEG6_LOCAL_POLICER_MAX,
+};
+
+#define SEG6_LOCAL_POLICER_MAX (__SEG6_LOCAL_POLICER_MAX - 1)
+
+enum {
+	SEG6_LOCAL_LB_UNSPEC,
+	SEG6_LOCAL_LB_MODE,		/* u32, SEG6_LOCAL_LB_MODE_* */
+	SEG6_LOCAL_LB_TABLE_SIZE,	/* u32, prime number of lookup slots */
+	SEG6_LOCAL_LB_BACKENDS,		/* nested list of SEG6_LOCAL_LB_BACKEND */
+	__SEG6_LOCAL_LB_MAX,
+};
+
+#define SEG6_LOCAL_LB_MAX (__SEG6_LOCAL_LB_MAX - 1)
+
+enum {
+	SEG6_LOCAL_LB_BACKEND_LIST_UNSPEC,
+	SEG6_LOCAL_LB_BACKEND,		/* nested, one per backend */
+	__SEG6_LOCAL_LB_BACKEND_LIST_MAX,
+};
+
+#define SEG6_LOCAL_LB_BACKEND_LIST_MAX (__SEG6_LOCAL_LB_BACKEND_LIST_MAX - 1)
+
+enum {
+	SEG6_LOCAL_LB_BACKEND_UNSPEC,
+	SEG6_LOCAL_LB_BACKEND_SID,	/* struct in6_addr */
+	SEG6_LOCAL_LB_BACKEND_WEIGHT,	/* u32, 1 to 256, defaults to 1 */
+	__SEG6_LOCAL_LB_BACKEND_MAX,
+};
+
+#define SEG6_LOCAL_LB_BACKEND_MAX (__SEG6_LOCAL_LB_BACKEND_MAX - 1)
+
+/* where End.LB writes the chosen backend SID */
+enum {
+	SEG6_LOCAL_LB_MODE_DA,		/* replace the active segment */
+	SEG6_LOCAL_LB_MODE_SRH,		/* insert it, keeping the service SID */
+};
+
+/* about 32 bytes of route dump per backend, keeps the route in a dump skb */
+#define SEG6_LOCAL_LB_BACKENDS_MAX	256
+#define SEG6_LOCAL_LB_TABLE_DEFAULT	65537
+
+/* SEG6_LOCAL_OAM flags */
+#define SEG6_LOCAL_OAM_TSTAMP	(1 << 0)	/* add a timestamp TLV to replies */
+
 #endif
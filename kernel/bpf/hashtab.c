@@ -14,6 +14,7 @@
 #include <linux/jhash.h>
 #include <linux/filter.h>
 #include <linux/rculist_nulls.h>
+#include <linux/workqueue.h>
 #include "percpu_freelist.h"
 #include "bpf_lru_list.h"
 #include "map_in_map.h"
@@ -22,6 +23,9 @@
 	(BPF_F_NO_PREALLOC | BPF_F_NO_COMMON_LRU | BPF_F_NUMA_NODE |	\
 	 BPF_F_RDONLY | BPF_F_WRONLY)
 
+/* number of buckets the expiry worker scans per run */
+#define HTAB_GC_BATCH	1024
+
 struct bucket {
 	struct hlist_nulls_head head;
 	raw_spinlock_t lock;
@@ -39,6 +43,10 @@ struct bpf_htab {
 	atomic_t count;	/* number of elements in this hashtable */
 	u32 n_buckets;	/* number of hash buckets */
 	u32 elem_size;	/* size of each element in bytes */
+	u32 ttl;	/* idle timeout of elements in jiffies, 0 if none */
+	u32 gc_next;	/* next bucket to be scanned by gc_work */
+	unsigned long gc_interval;
+	struct delayed_work gc_work;
 };
 
 /* each htab element is struct htab_elem + key + value */
@@ -58,10 +66,12 @@ struct htab_elem {
 		struct bpf_lru_node lru_node;
 	};
 	u32 hash;
+	u32 atime;	/* last access in jiffies, maps with ttl only */
 	char key[0] __aligned(8);
 };
 
 static bool htab_lru_map_delete_node(void *arg, struct bpf_lru_node *node);
+static void htab_gc_work(struct work_struct *work);
 
 static bool htab_is_lru(const struct bpf_htab *htab)
 {
@@ -80,6 +90,28 @@ static bool htab_is_prealloc(const struct bpf_htab *htab)
 	return !(htab->map.map_flags & BPF_F_NO_PREALLOC);
 }
 
+static inline u32 htab_now(void)
+{
+	return (u32)jiffies;
+}
+
+static bool htab_elem_expired(const struct bpf_htab *htab,
+			      const struct htab_elem *l, u32 now)
+{
+	return htab->ttl && (s32)(now - READ_ONCE(l->atime)) > (s32)htab->ttl;
+}
+
+/* only write the timestamp when it changes, so that hot flows looked up
+ * from many CPUs do not keep bouncing the element's cacheline
+ */
+static inline void htab_elem_touch(struct htab_elem *l)
+{
+	u32 now = htab_now();
+
+	if (READ_ONCE(l->atime) != now)
+		WRITE_ONCE(l->atime, now);
+}
+
 static inline void htab_elem_set_ptr(struct htab_elem *l, u32 key_size,
 				     void __percpu *pptr)
 {
@@ -129,6 +161,7 @@ static struct htab_elem *prealloc_lru_pop(struct bpf_htab *htab, void *key,
 	if (node) {
 		l = container_of(node, struct htab_elem, lru_node);
 		memcpy(l->key, key, htab->map.key_size);
+		l->atime = htab_now();
 		return l;
 	}
 
@@ -257,6 +290,11 @@ static int htab_map_alloc_check(union bpf_attr *attr)
 		/* reserved bits should not be used */
 		return -EINVAL;
 
+	if (attr->map_ttl && attr->map_type != BPF_MAP_TYPE_HASH &&
+	    attr->map_type != BPF_MAP_TYPE_LRU_HASH)
+		/* expiry is only supported for plain and lru hash maps */
+		return -EINVAL;
+
 	if (!lru && percpu_lru)
 		return -EINVAL;
 
@@ -291,6 +329,17 @@ static int htab_map_alloc_check(union bpf_attr *attr)
 	return 0;
 }
 
+/* Spread a full sweep of the table over roughly one ttl period, but
+ * never run the worker more often than every jiffy nor less than once
+ * a second.
+ */
+static unsigned long htab_gc_interval(const struct bpf_htab *htab)
+{
+	u32 runs = max_t(u32, htab->n_buckets / HTAB_GC_BATCH, 1);
+
+	return clamp_t(unsigned long, htab->ttl / runs, 1, HZ);
+}
+
 static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 {
 	bool percpu = (attr->map_type == BPF_MAP_TYPE_PERCPU_HASH ||
@@ -389,6 +438,15 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 		}
 	}
 
+	if (attr->map_ttl) {
+		htab->ttl = min_t(unsigned long, msecs_to_jiffies(attr->map_ttl),
+				  S32_MAX);
+		htab->gc_interval = htab_gc_interval(htab);
+		INIT_DELAYED_WORK(&htab->gc_work, htab_gc_work);
+		queue_delayed_work(system_power_efficient_wq, &htab->gc_work,
+				   htab->gc_interval);
+	}
+
 	return &htab->map;
 
 free_prealloc:
@@ -477,10 +535,31 @@ static void *__htab_map_lookup_elem(struct bpf_map *map, void *key)
 	return l;
 }
 
-static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
+/* Same as __htab_map_lookup_elem() for maps with a ttl: expired elements
+ * waiting for the gc worker are not returned, live ones are refreshed.
+ */
+static void *__htab_map_lookup_elem_ttl(struct bpf_map *map, void *key)
 {
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
 	struct htab_elem *l = __htab_map_lookup_elem(map, key);
 
+	if (!l || htab_elem_expired(htab, l, htab_now()))
+		return NULL;
+
+	htab_elem_touch(l);
+	return l;
+}
+
+static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	struct htab_elem *l;
+
+	if (htab->ttl)
+		l = __htab_map_lookup_elem_ttl(map, key);
+	else
+		l = __htab_map_lookup_elem(map, key);
+
 	if (l)
 		return l->key + round_up(map->key_size, 8);
 
@@ -500,10 +579,14 @@ static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
  */
 static u32 htab_map_gen_lookup(struct bpf_map *map, struct bpf_insn *insn_buf)
 {
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
 	struct bpf_insn *insn = insn_buf;
 	const int ret = BPF_REG_0;
 
-	*insn++ = BPF_EMIT_CALL((u64 (*)(u64, u64, u64, u64, u64))__htab_map_lookup_elem);
+	if (htab->ttl)
+		*insn++ = BPF_EMIT_CALL((u64 (*)(u64, u64, u64, u64, u64))__htab_map_lookup_elem_ttl);
+	else
+		*insn++ = BPF_EMIT_CALL((u64 (*)(u64, u64, u64, u64, u64))__htab_map_lookup_elem);
 	*insn++ = BPF_JMP_IMM(BPF_JEQ, ret, 0, 1);
 	*insn++ = BPF_ALU64_IMM(BPF_ADD, ret,
 				offsetof(struct htab_elem, key) +
@@ -513,7 +596,13 @@ static u32 htab_map_gen_lookup(struct bpf_map *map, struct bpf_insn *insn_buf)
 
 static void *htab_lru_map_lookup_elem(struct bpf_map *map, void *key)
 {
-	struct htab_elem *l = __htab_map_lookup_elem(map, key);
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	struct htab_elem *l;
+
+	if (htab->ttl)
+		l = __htab_map_lookup_elem_ttl(map, key);
+	else
+		l = __htab_map_lookup_elem(map, key);
 
 	if (l) {
 		bpf_lru_node_set_ref(&l->lru_node);
@@ -526,11 +615,15 @@ static void *htab_lru_map_lookup_elem(struct bpf_map *map, void *key)
 static u32 htab_lru_map_gen_lookup(struct bpf_map *map,
 				   struct bpf_insn *insn_buf)
 {
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
 	struct bpf_insn *insn = insn_buf;
 	const int ret = BPF_REG_0;
 	const int ref_reg = BPF_REG_1;
 
-	*insn++ = BPF_EMIT_CALL((u64 (*)(u64, u64, u64, u64, u64))__htab_map_lookup_elem);
+	if (htab->ttl)
+		*insn++ = BPF_EMIT_CALL((u64 (*)(u64, u64, u64, u64, u64))__htab_map_lookup_elem_ttl);
+	else
+		*insn++ = BPF_EMIT_CALL((u64 (*)(u64, u64, u64, u64, u64))__htab_map_lookup_elem);
 	*insn++ = BPF_JMP_IMM(BPF_JEQ, ret, 0, 4);
 	*insn++ = BPF_LDX_MEM(BPF_B, ref_reg, ret,
 			      offsetof(struct htab_elem, lru_node) +
@@ -775,12 +868,19 @@ static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab, void *key,
 	}
 
 	l_new->hash = hash;
+	l_new->atime = htab_now();
 	return l_new;
 }
 
 static int check_flags(struct bpf_htab *htab, struct htab_elem *l_old,
 		       u64 map_flags)
 {
+	/* an expired element still linked is about to be reaped and is
+	 * simply replaced
+	 */
+	if (l_old && htab_elem_expired(htab, l_old, htab_now()))
+		l_old = NULL;
+
 	if (l_old && map_flags == BPF_NOEXIST)
 		/* elem already exists */
 		return -EEXIST;
@@ -1110,6 +1210,85 @@ static int htab_lru_map_delete_elem(struct bpf_map *map, void *key)
 	return ret;
 }
 
+static bool htab_bucket_has_expired(struct bpf_htab *htab, struct bucket *b,
+				    u32 now)
+{
+	struct hlist_nulls_node *n;
+	struct htab_elem *l;
+	bool ret = false;
+
+	rcu_read_lock();
+	hlist_nulls_for_each_entry_rcu(l, n, &b->head, hash_node) {
+		if (htab_elem_expired(htab, l, now)) {
+			ret = true;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+static void htab_gc_bucket(struct bpf_htab *htab, struct bucket *b, u32 now)
+{
+	struct hlist_nulls_node *n;
+	struct htab_elem *l;
+	unsigned long flags;
+
+	/* scan locklessly first, most buckets have nothing to reap and the
+	 * bucket lock is contended by the datapath
+	 */
+	if (!htab_bucket_has_expired(htab, b, now))
+		return;
+
+	/* same protection as deletions from the syscall path */
+	preempt_disable();
+	__this_cpu_inc(bpf_prog_active);
+again:
+	raw_spin_lock_irqsave(&b->lock, flags);
+
+	hlist_nulls_for_each_entry_safe(l, n, &b->head, hash_node) {
+		if (!htab_elem_expired(htab, l, now))
+			continue;
+
+		hlist_nulls_del_rcu(&l->hash_node);
+
+		if (!htab_is_lru(htab)) {
+			free_htab_elem(htab, l);
+			continue;
+		}
+
+		/* lru nodes are given back without the bucket lock held */
+		raw_spin_unlock_irqrestore(&b->lock, flags);
+		bpf_lru_push_free(&htab->lru, &l->lru_node);
+		goto again;
+	}
+
+	raw_spin_unlock_irqrestore(&b->lock, flags);
+	__this_cpu_dec(bpf_prog_active);
+	preempt_enable();
+}
+
+/* Incremental reaper of expired elements: each run scans at most
+ * HTAB_GC_BATCH buckets, starting where the previous run stopped.
+ */
+static void htab_gc_work(struct work_struct *work)
+{
+	struct bpf_htab *htab = container_of(to_delayed_work(work),
+					     struct bpf_htab, gc_work);
+	u32 i, batch, now = htab_now();
+
+	batch = min_t(u32, htab->n_buckets, HTAB_GC_BATCH);
+
+	for (i = 0; i < batch; i++) {
+		htab_gc_bucket(htab, __select_bucket(htab, htab->gc_next), now);
+		htab->gc_next = (htab->gc_next + 1) & (htab->n_buckets - 1);
+	}
+
+	queue_delayed_work(system_power_efficient_wq, &htab->gc_work,
+			   htab->gc_interval);
+}
+
 static void delete_all_elements(struct bpf_htab *htab)
 {
 	int i;
@@ -1131,6 +1310,9 @@ static void htab_map_free(struct bpf_map *map)
 {
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
 
+	if (htab->ttl)
+		cancel_delayed_work_sync(&htab->gc_work);
+
 	/* at this point bpf_prog->aux->refcnt == 0 and this map->refcnt == 0,
 	 * so the programs (can be more than one that used this map) were
 	 * disconnected from events. Wait for outstanding critical sections in
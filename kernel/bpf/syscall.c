@@ -292,6 +292,7 @@ void bpf_map_put_with_uref(struct bpf_map *map)
 	bpf_map_put_uref(map);
 	bpf_map_put(map);
 }
+EXPORT_SYMBOL_GPL(bpf_map_put_with_uref);
 
 static int bpf_map_release(struct inode *inode, struct file *filp)
 {
@@ -422,7 +423,7 @@ static int bpf_obj_name_cpy(char *dst, const char *src)
 	return 0;
 }
 
-#define BPF_MAP_CREATE_LAST_FIELD btf_value_id
+#define BPF_MAP_CREATE_LAST_FIELD map_ttl
 /* called via syscall */
 static int map_create(union bpf_attr *attr)
 {
@@ -563,6 +564,7 @@ struct bpf_map *bpf_map_get_with_uref(u32 ufd)
 
 	return map;
 }
+EXPORT_SYMBOL_GPL(bpf_map_get_with_uref);
 
 /* map_idr_lock should have been held */
 static struct bpf_map *bpf_map_inc_not_zero(struct bpf_map *map,
@@ -763,6 +765,8 @@ static int map_update_elem(union bpf_attr *attr)
 	__this_cpu_dec(bpf_prog_active);
 	preempt_enable();
 out:
+	if (!err)
+		atomic_inc(&map->gen);
 free_value:
 	kfree(value);
 free_key:
@@ -815,6 +819,8 @@ static int map_delete_elem(union bpf_attr *attr)
 	__this_cpu_dec(bpf_prog_active);
 	preempt_enable();
 out:
+	if (!err)
+		atomic_inc(&map->gen);
 	kfree(key);
 err_put:
 	fdput(f);
@@ -1705,7 +1711,7 @@ static int bpf_prog_query(const union bpf_attr *attr,
 }
 #endif /* CONFIG_CGROUP_BPF */
 
-#define BPF_PROG_TEST_RUN_LAST_FIELD test.duration
+#define BPF_PROG_TEST_RUN_LAST_FIELD test.ifindex
 
 static int bpf_prog_test_run(const union bpf_attr *attr,
 			     union bpf_attr __user *uattr)
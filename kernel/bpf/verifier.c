@@ -156,6 +156,7 @@ struct bpf_verifier_stack_elem {
 
 #define BPF_COMPLEXITY_LIMIT_INSNS	131072
 #define BPF_COMPLEXITY_LIMIT_STACK	1024
+#define BPF_CHECKPOINT_MIN_INSNS	8
 
 #define BPF_MAP_PTR_POISON ((void *)0xeB9F + POISON_POINTER_DELTA)
 
@@ -1496,9 +1497,14 @@ static int update_stack_depth(struct bpf_verifier_env *env,
  * and recursively walk all callees that given function can call.
  * Ignore jump and exit insns.
  * Since recursion is prevented by check_cfg() this algorithm
- * only needs a local stack of MAX_CALL_FRAMES to remember callsites
+ * only needs a local stack of MAX_CALL_FRAMES to remember callsites.
+ * The call at 'skip_call' is not followed, which lets call inlining
+ * ask whether the program still fits once that call is gone and its
+ * callee's frame has been added to the caller's one. Only the real
+ * check (skip_call < 0) reports an overflow in the log.
  */
-static int check_max_stack_depth(struct bpf_verifier_env *env)
+static int __check_max_stack_depth(struct bpf_verifier_env *env,
+				   int skip_call)
 {
 	int depth = 0, frame = 0, idx = 0, i = 0, subprog_end;
 	struct bpf_subprog_info *subprog = env->subprog_info;
@@ -1512,8 +1518,9 @@ static int check_max_stack_depth(struct bpf_verifier_env *env)
 	 */
 	depth += round_up(max_t(u32, subprog[idx].stack_depth, 1), 32);
 	if (depth > MAX_BPF_STACK) {
-		verbose(env, "combined stack size of %d calls is %d. Too large\n",
-			frame + 1, depth);
+		if (skip_call < 0)
+			verbose(env, "combined stack size of %d calls is %d. Too large\n",
+				frame + 1, depth);
 		return -EACCES;
 	}
 continue_func:
@@ -1523,6 +1530,8 @@ static int check_max_stack_depth(struct bpf_verifier_env *env)
 			continue;
 		if (insn[i].src_reg != BPF_PSEUDO_CALL)
 			continue;
+		if (i == skip_call)
+			continue;
 		/* remember insn and function to return to */
 		ret_insn[frame] = i + 1;
 		ret_prog[frame] = idx;
@@ -1554,6 +1563,11 @@ static int check_max_stack_depth(struct bpf_verifier_env *env)
 	goto continue_func;
 }
 
+static int check_max_stack_depth(struct bpf_verifier_env *env)
+{
+	return __check_max_stack_depth(env, -1);
+}
+
 #ifndef CONFIG_BPF_JIT_ALWAYS_ON
 static int get_callee_stack_depth(struct bpf_verifier_env *env,
 				  const struct bpf_insn *insn, int idx)
@@ -4360,12 +4374,6 @@ static bool stacksafe(struct bpf_func_state *old,
 {
 	int i, spi;
 
-	/* if explored stack has more populated slots than current stack
-	 * such stacks are not equivalent
-	 */
-	if (old->allocated_stack > cur->allocated_stack)
-		return false;
-
 	/* walk slots of the explored stack and ignore any additional
 	 * slots in the current stack, since explored(safe) state
 	 * didn't use them
@@ -4373,12 +4381,20 @@ static bool stacksafe(struct bpf_func_state *old,
 	for (i = 0; i < old->allocated_stack; i++) {
 		spi = i / BPF_REG_SIZE;
 
-		if (!(old->stack[spi].spilled_ptr.live & REG_LIVE_READ))
-			/* explored state didn't use this */
+		if (!(old->stack[spi].spilled_ptr.live & REG_LIVE_READ)) {
+			/* explored state didn't use this slot at all */
+			i += BPF_REG_SIZE - 1;
 			continue;
+		}
 
 		if (old->stack[spi].slot_type[i % BPF_REG_SIZE] == STACK_INVALID)
 			continue;
+
+		/* explored stack has more populated slots than current stack
+		 * and these slots were used, such stacks are not equivalent
+		 */
+		if (i >= cur->allocated_stack)
+			return false;
 		/* if old state was safe with misc data in the stack
 		 * it will be safe with zero-initialized stack.
 		 * The opposite is not true
@@ -4538,11 +4554,12 @@ static int propagate_liveness(struct bpf_verifier_env *env,
 static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 {
 	struct bpf_verifier_state_list *new_sl;
-	struct bpf_verifier_state_list *sl;
+	struct bpf_verifier_state_list *sl, **pprev;
 	struct bpf_verifier_state *cur = env->cur_state;
-	int i, j, err;
+	int i, j, err, states_cnt = 0;
 
-	sl = env->explored_states[insn_idx];
+	pprev = &env->explored_states[insn_idx];
+	sl = *pprev;
 	if (!sl)
 		/* this 'insn_idx' instruction wasn't marked, so we will not
 		 * be doing state search here
@@ -4550,7 +4567,9 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 		return 0;
 
 	while (sl != STATE_LIST_MARK) {
+		states_cnt++;
 		if (states_equal(env, &sl->state, cur)) {
+			sl->hit_cnt++;
 			/* reached equivalent register/stack state,
 			 * prune the search.
 			 * Registers read by the continuation are read by us.
@@ -4566,9 +4585,39 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 				return err;
 			return 1;
 		}
-		sl = sl->next;
+		sl->miss_cnt++;
+		/* A state that keeps failing to match is only making every
+		 * later search at this insn slower. Unlink it so the list
+		 * stays short, but keep it around until verification ends:
+		 * states explored from it still point to it via ->parent
+		 * for liveness propagation.
+		 */
+		if (sl->miss_cnt > sl->hit_cnt * 3 + 3) {
+			*pprev = sl->next;
+			sl->next = env->free_list;
+			env->free_list = sl;
+			env->explored_cnt--;
+			sl = *pprev;
+			continue;
+		}
+		pprev = &sl->next;
+		sl = *pprev;
 	}
 
+	if (states_cnt > env->max_states_per_insn)
+		env->max_states_per_insn = states_cnt;
+
+	/* Remembering a state at every prune point makes the explored
+	 * lists, and the time spent searching them, grow with the number
+	 * of paths through the program. Only checkpoint once a few insns
+	 * were processed since the last one; states that are not
+	 * remembered are still compared against the existing ones above.
+	 */
+	if (env->insn_processed - env->prev_insn_processed <
+	    BPF_CHECKPOINT_MIN_INSNS)
+		return 0;
+	env->prev_insn_processed = env->insn_processed;
+
 	/* there were no equivalent states, remember current one.
 	 * technically the current state is not proven to be safe yet,
 	 * but it will either reach outer most bpf_exit (which means it's safe)
@@ -4589,6 +4638,9 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 	}
 	new_sl->next = env->explored_states[insn_idx];
 	env->explored_states[insn_idx] = new_sl;
+	env->total_states++;
+	if (++env->explored_cnt > env->peak_states)
+		env->peak_states = env->explored_cnt;
 	/* connect new state to parentage chain */
 	cur->parent = &new_sl->state;
 	/* clear write marks in current state: the writes we did are not writes
@@ -4617,7 +4669,6 @@ static int do_check(struct bpf_verifier_env *env)
 	struct bpf_reg_state *regs;
 	int insn_cnt = env->prog->len, i;
 	int insn_idx, prev_insn_idx = 0;
-	int insn_processed = 0;
 	bool do_print_state = false;
 
 	state = kzalloc(sizeof(struct bpf_verifier_state), GFP_KERNEL);
@@ -4650,10 +4701,10 @@ static int do_check(struct bpf_verifier_env *env)
 		insn = &insns[insn_idx];
 		class = BPF_CLASS(insn->code);
 
-		if (++insn_processed > BPF_COMPLEXITY_LIMIT_INSNS) {
+		if (++env->insn_processed > BPF_COMPLEXITY_LIMIT_INSNS) {
 			verbose(env,
 				"BPF program is too large. Processed %d insn\n",
-				insn_processed);
+				env->insn_processed);
 			return -E2BIG;
 		}
 
@@ -4932,8 +4983,10 @@ static int do_check(struct bpf_verifier_env *env)
 		insn_idx++;
 	}
 
-	verbose(env, "processed %d insns (limit %d), stack depth ",
-		insn_processed, BPF_COMPLEXITY_LIMIT_INSNS);
+	verbose(env, "processed %d insns (limit %d), total_states %d peak_states %d max_states_per_insn %d, stack depth ",
+		env->insn_processed, BPF_COMPLEXITY_LIMIT_INSNS,
+		env->total_states, env->peak_states,
+		env->max_states_per_insn);
 	for (i = 0; i < env->subprog_cnt; i++) {
 		u32 depth = env->subprog_info[i].stack_depth;
 
@@ -5148,9 +5201,11 @@ static void adjust_subprog_starts(struct bpf_verifier_env *env, u32 off, u32 len
 
 	if (len == 1)
 		return;
-	/* NOTE: fake 'exit' subprog should be updated as well. */
+	/* NOTE: fake 'exit' subprog should be updated as well.
+	 * A subprog whose first insn is patched keeps starting at 'off'.
+	 */
 	for (i = 0; i <= env->subprog_cnt; i++) {
-		if (env->subprog_info[i].start < off)
+		if (env->subprog_info[i].start <= off)
 			continue;
 		env->subprog_info[i].start += len - 1;
 	}
@@ -5196,6 +5251,242 @@ static void sanitize_dead_code(struct bpf_verifier_env *env)
 	}
 }
 
+/* max size of a subprog inlined at its call sites */
+#define BPF_INLINE_MAX_INSNS	64
+
+static bool is_callee_saved_reg(u8 regno)
+{
+	return regno >= BPF_REG_6 && regno <= BPF_REG_9;
+}
+
+/* 'rX = r10' is rewritten as 'rX = r10; rX += -shift' once inlined */
+static bool is_fp_mov(const struct bpf_insn *insn)
+{
+	return insn->code == (BPF_ALU64 | BPF_MOV | BPF_X) &&
+	       insn->src_reg == BPF_REG_FP;
+}
+
+/* A subprog can be inlined when it is small, does not call other
+ * subprogs and does not touch the caller's callee-saved registers.
+ * The frame pointer may only be used as base of stack accesses or be
+ * copied into another register, so that its frame can be relocated
+ * below the caller's one.
+ */
+static bool subprog_can_inline(struct bpf_verifier_env *env, int subprog)
+{
+	int start = env->subprog_info[subprog].start;
+	int end = env->subprog_info[subprog + 1].start;
+	struct bpf_insn *insn = env->prog->insnsi;
+	int i;
+
+	if (end - start > BPF_INLINE_MAX_INSNS)
+		return false;
+
+	for (i = start; i < end; i++) {
+		u8 code = insn[i].code;
+
+		switch (BPF_CLASS(code)) {
+		case BPF_LD:
+			if (is_callee_saved_reg(insn[i].dst_reg))
+				return false;
+			if (BPF_MODE(code) == BPF_IMM)
+				i++;
+			break;
+		case BPF_LDX:
+			if (is_callee_saved_reg(insn[i].dst_reg))
+				return false;
+			break;
+		case BPF_ALU:
+		case BPF_ALU64:
+			if (is_callee_saved_reg(insn[i].dst_reg))
+				return false;
+			if (BPF_SRC(code) == BPF_X &&
+			    insn[i].src_reg == BPF_REG_FP && !is_fp_mov(&insn[i]))
+				return false;
+			break;
+		case BPF_STX:
+			if (insn[i].src_reg == BPF_REG_FP)
+				return false;
+			break;
+		case BPF_JMP:
+			if (BPF_OP(code) == BPF_CALL) {
+				if (insn[i].src_reg == BPF_PSEUDO_CALL)
+					return false;
+				break;
+			}
+			if (BPF_OP(code) == BPF_EXIT || BPF_OP(code) == BPF_JA)
+				break;
+			if (insn[i].dst_reg == BPF_REG_FP ||
+			    (BPF_SRC(code) == BPF_X &&
+			     insn[i].src_reg == BPF_REG_FP))
+				return false;
+			break;
+		}
+	}
+
+	return true;
+}
+
+/* Build the body of 'subprog' as it is spliced at a call site: exits
+ * become jumps past the body, jumps are re-targeted and stack accesses
+ * are moved down by 'shift' bytes, below the caller's frame. Per-insn
+ * aux data follows the insns. Returns the number of insns in 'patch'.
+ */
+static int build_inline_patch(struct bpf_verifier_env *env, int subprog,
+			      int shift, struct bpf_insn *patch,
+			      struct bpf_insn_aux_data *aux, int *pos)
+{
+	int start = env->subprog_info[subprog].start;
+	int end = env->subprog_info[subprog + 1].start;
+	struct bpf_insn *insn = env->prog->insnsi;
+	int i, cnt = 0, total;
+
+	for (i = start; i < end; i++) {
+		pos[i - start] = cnt;
+		cnt += (shift && is_fp_mov(&insn[i])) ? 2 : 1;
+	}
+
+	/* a trailing exit simply falls through to the call's successor */
+	total = cnt;
+	if (insn[end - 1].code == (BPF_JMP | BPF_EXIT))
+		total--;
+
+	for (i = start; i < end; i++) {
+		int idx = pos[i - start];
+		struct bpf_insn *p = &patch[idx];
+		u8 code = insn[i].code;
+
+		*p = insn[i];
+		aux[idx] = env->insn_aux_data[i];
+
+		if (code == (BPF_JMP | BPF_EXIT)) {
+			*p = BPF_JMP_IMM(BPF_JA, 0, 0, total - idx - 1);
+		} else if (BPF_CLASS(code) == BPF_JMP &&
+			   BPF_OP(code) != BPF_CALL) {
+			p->off = pos[i + insn[i].off + 1 - start] - idx - 1;
+		} else if (BPF_CLASS(code) == BPF_LDX) {
+			if (insn[i].src_reg == BPF_REG_FP)
+				p->off -= shift;
+		} else if (BPF_CLASS(code) == BPF_ST ||
+			   BPF_CLASS(code) == BPF_STX) {
+			if (insn[i].dst_reg == BPF_REG_FP)
+				p->off -= shift;
+		} else if (shift && is_fp_mov(&insn[i])) {
+			patch[idx + 1] = BPF_ALU64_IMM(BPF_ADD, insn[i].dst_reg,
+						       -shift);
+			aux[idx + 1] = env->insn_aux_data[i];
+		}
+	}
+
+	return total;
+}
+
+static int find_containing_subprog(struct bpf_verifier_env *env, int off)
+{
+	int i;
+
+	for (i = env->subprog_cnt - 1; i > 0; i--)
+		if (env->subprog_info[i].start <= off)
+			break;
+	return i;
+}
+
+/* Replace calls to small leaf subprogs with a copy of their body, which
+ * saves the call, the frame setup and the spills of the JITed code.
+ * The callee frame lives right below the caller's original frame and
+ * becomes part of the caller's own frame. That grows the caller's
+ * stack for all the other calls it makes too, so a call is only
+ * inlined when every call chain still fits in MAX_BPF_STACK after it.
+ */
+static int inline_bpf_calls(struct bpf_verifier_env *env)
+{
+	struct bpf_insn_aux_data *aux = NULL;
+	struct bpf_insn *patch = NULL;
+	struct bpf_prog *new_prog;
+	u16 *orig_depth = NULL;
+	int *pos = NULL;
+	int i, ret = 0;
+
+	if (env->subprog_cnt < 2)
+		return 0;
+
+	orig_depth = kcalloc(env->subprog_cnt, sizeof(*orig_depth),
+			     GFP_KERNEL);
+	patch = kcalloc(2 * BPF_INLINE_MAX_INSNS, sizeof(*patch), GFP_KERNEL);
+	aux = kcalloc(2 * BPF_INLINE_MAX_INSNS, sizeof(*aux), GFP_KERNEL);
+	pos = kcalloc(BPF_INLINE_MAX_INSNS, sizeof(*pos), GFP_KERNEL);
+	if (!orig_depth || !patch || !aux || !pos) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < env->subprog_cnt; i++)
+		orig_depth[i] = env->subprog_info[i].stack_depth;
+
+	for (i = 0; i < env->prog->len; i++) {
+		struct bpf_insn *insn = &env->prog->insnsi[i];
+		int caller, callee, cnt, shift, depth, old_depth;
+
+		if (insn->code != (BPF_JMP | BPF_CALL) ||
+		    insn->src_reg != BPF_PSEUDO_CALL)
+			continue;
+
+		callee = find_subprog(env, i + insn->imm + 1);
+		if (callee < 0) {
+			WARN_ONCE(1, "verifier bug. No program starts at insn %d\n",
+				  i + insn->imm + 1);
+			ret = -EFAULT;
+			goto out;
+		}
+
+		if (!subprog_can_inline(env, callee))
+			continue;
+
+		caller = find_containing_subprog(env, i);
+		shift = round_up(orig_depth[caller], 8);
+
+		cnt = build_inline_patch(env, callee, shift, patch, aux, pos);
+		if (env->prog->len + cnt - 1 > BPF_MAXINSNS)
+			continue;
+
+		old_depth = env->subprog_info[caller].stack_depth;
+		depth = shift + env->subprog_info[callee].stack_depth;
+		if (depth > old_depth) {
+			env->subprog_info[caller].stack_depth = depth;
+			if (__check_max_stack_depth(env, i)) {
+				env->subprog_info[caller].stack_depth = old_depth;
+				if (env->log.level > 1)
+					verbose(env, "func#%d at insn %d not inlined, stack too large\n",
+						callee, i);
+				continue;
+			}
+		}
+
+		new_prog = bpf_patch_insn_data(env, i, patch, cnt);
+		if (!new_prog) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		env->prog = new_prog;
+
+		/* the patched range got blank aux data, restore the callee's */
+		memcpy(env->insn_aux_data + i, aux, sizeof(*aux) * cnt);
+
+		if (env->log.level > 1)
+			verbose(env, "inlined func#%d at insn %d\n", callee, i);
+
+		i += cnt - 1;
+	}
+
+	env->prog->aux->stack_depth = env->subprog_info[0].stack_depth;
+out:
+	kfree(pos);
+	kfree(aux);
+	kfree(patch);
+	kfree(orig_depth);
+	return ret;
+}
+
 /* convert load instructions that access fields of 'struct __sk_buff'
  * into sequence of instructions that access fields of 'struct sk_buff'
  */
@@ -5701,6 +5992,14 @@ static void free_states(struct bpf_verifier_env *env)
 			}
 	}
 
+	sl = env->free_list;
+	while (sl) {
+		sln = sl->next;
+		free_verifier_state(&sl->state, false);
+		kfree(sl);
+		sl = sln;
+	}
+
 	kfree(env->explored_states);
 }
 
@@ -5791,6 +6090,9 @@ int bpf_check(struct bpf_prog **prog, union bpf_attr *attr)
 	if (ret == 0)
 		ret = check_max_stack_depth(env);
 
+	if (ret == 0)
+		ret = inline_bpf_calls(env);
+
 	if (ret == 0)
 		/* program is valid, convert *(u32*)(ctx + off) accesses */
 		ret = convert_ctx_accesses(env);
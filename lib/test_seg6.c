@@ -0,0 +1,471 @@
+/*
+ * Microbenchmarks for the SRv6 datapath primitives
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * Every primitive is run on synthetic packets of several shapes (linear,
+ * paged, cloned), SRH sizes and with or without an HMAC TLV. Results are
+ * reported as the average cost of one call and the number of calls, per
+ * thousand, that had to reallocate the skb head.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/ipv6.h>
+#include <linux/udp.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <net/ipv6.h>
+#include <net/ip6_route.h>
+#include <net/seg6.h>
+#include <linux/seg6.h>
+#ifdef CONFIG_IPV6_SEG6_HMAC
+#include <net/seg6_hmac.h>
+#endif
+
+#define TEST_BATCH	32
+#define TEST_PAYLOAD	256
+
+static int runs = 10000;
+module_param(runs, int, 0);
+MODULE_PARM_DESC(runs, "Number of calls per test");
+
+static uint hmac_keyid = 0x7e57;
+module_param(hmac_keyid, uint, 0);
+MODULE_PARM_DESC(hmac_keyid, "HMAC key id registered in init_net while testing");
+
+enum {
+	SHAPE_LINEAR,
+	SHAPE_PAGED,
+	SHAPE_CLONED,
+	__SHAPE_MAX,
+};
+
+static const char * const shape_names[__SHAPE_MAX] = {
+	[SHAPE_LINEAR]	= "linear",
+	[SHAPE_PAGED]	= "paged",
+	[SHAPE_CLONED]	= "cloned",
+};
+
+static const int test_nsegs[] = { 1, 2, 4, 8, 16 };
+
+static const struct in6_addr test_saddr = {
+	.s6_addr = { 0x20, 0x01, 0x0d, 0xb8, [15] = 0x01 }
+};
+
+static struct dst_entry *test_dst;
+static bool test_hmac;
+
+struct seg6_bench {
+	const char *name;
+	/* SRH carried by the input packet, or none */
+	bool srh_in_packet;
+	int (*run)(struct sk_buff *skb, struct ipv6_sr_hdr *srh);
+};
+
+static int srh_len(const struct ipv6_sr_hdr *srh)
+{
+	return (srh->hdrlen + 1) << 3;
+}
+
+static struct ipv6_sr_hdr *build_srh(int nsegs, bool hmac)
+{
+	struct ipv6_sr_hdr *srh;
+	int i, len;
+
+	len = sizeof(*srh) + nsegs * sizeof(struct in6_addr);
+#ifdef CONFIG_IPV6_SEG6_HMAC
+	if (hmac)
+		len += sizeof(struct sr6_tlv_hmac);
+#endif
+
+	srh = kzalloc(len, GFP_KERNEL);
+	if (!srh)
+		return NULL;
+
+	srh->nexthdr = IPPROTO_UDP;
+	srh->hdrlen = (len >> 3) - 1;
+	srh->type = IPV6_SRCRT_TYPE_4;
+	srh->segments_left = nsegs - 1;
+	srh->first_segment = nsegs - 1;
+
+	for (i = 0; i < nsegs; i++) {
+		srh->segments[i].s6_addr[0] = 0xfc;
+		srh->segments[i].s6_addr[15] = i + 1;
+	}
+
+#ifdef CONFIG_IPV6_SEG6_HMAC
+	if (hmac) {
+		struct sr6_tlv_hmac *tlv;
+
+		tlv = (struct sr6_tlv_hmac *)(srh->segments + nsegs);
+		tlv->tlvhdr.type = SR6_TLV_HMAC;
+		tlv->tlvhdr.len = sizeof(*tlv) - sizeof(struct sr6_tlv);
+		tlv->hmackeyid = cpu_to_be32(hmac_keyid);
+		srh->flags |= SR6_FLAG1_HMAC;
+	}
+#endif
+
+	return srh;
+}
+
+/* IPv6 + optional SRH + UDP + payload, with the given shape. For cloned
+ * packets, *orig holds the other reference to the data.
+ */
+static struct sk_buff *build_skb_shaped(int shape, struct ipv6_sr_hdr *srh,
+					struct sk_buff **orig)
+{
+	int srhlen = srh ? srh_len(srh) : 0;
+	int hlen = sizeof(struct ipv6hdr) + srhlen + sizeof(struct udphdr);
+	int len = hlen + TEST_PAYLOAD;
+	int linear = shape == SHAPE_PAGED ? sizeof(struct ipv6hdr) : len;
+	struct ipv6hdr *hdr;
+	struct sk_buff *skb;
+	struct udphdr *uh;
+	u8 *buf;
+
+	*orig = NULL;
+
+	buf = kzalloc(len, GFP_KERNEL);
+	if (!buf)
+		return NULL;
+
+	hdr = (struct ipv6hdr *)buf;
+	ip6_flow_hdr(hdr, 0, 0);
+	hdr->payload_len = htons(len - sizeof(*hdr));
+	hdr->nexthdr = srh ? NEXTHDR_ROUTING : IPPROTO_UDP;
+	hdr->hop_limit = 64;
+	hdr->saddr = test_saddr;
+	if (srh) {
+		hdr->daddr = srh->segments[srh->segments_left];
+	} else {
+		hdr->daddr = test_saddr;
+		hdr->daddr.s6_addr[15]++;
+	}
+
+	if (srh)
+		memcpy(buf + sizeof(*hdr), srh, srhlen);
+
+	uh = (struct udphdr *)(buf + sizeof(*hdr) + srhlen);
+	uh->source = htons(4242);
+	uh->dest = htons(4343);
+	uh->len = htons(sizeof(*uh) + TEST_PAYLOAD);
+
+	/* same headroom as a packet received by most drivers */
+	skb = alloc_skb(NET_SKB_PAD + linear, GFP_KERNEL);
+	if (!skb)
+		goto out;
+
+	skb_reserve(skb, NET_SKB_PAD);
+	skb_put_data(skb, buf, linear);
+
+	if (linear < len) {
+		struct page *page = alloc_page(GFP_KERNEL);
+
+		if (!page) {
+			kfree_skb(skb);
+			skb = NULL;
+			goto out;
+		}
+
+		memcpy(page_address(page), buf + linear, len - linear);
+		skb_fill_page_desc(skb, 0, page, 0, len - linear);
+		skb->len += len - linear;
+		skb->data_len += len - linear;
+		skb->truesize += PAGE_SIZE;
+	}
+
+	skb_reset_network_header(skb);
+	skb_set_transport_header(skb, sizeof(*hdr));
+	skb->protocol = htons(ETH_P_IPV6);
+	skb_dst_set(skb, dst_clone(test_dst));
+
+	if (shape == SHAPE_CLONED) {
+		struct sk_buff *clone = skb_clone(skb, GFP_KERNEL);
+
+		if (!clone) {
+			kfree_skb(skb);
+			skb = NULL;
+			goto out;
+		}
+
+		*orig = skb;
+		skb = clone;
+	}
+
+out:
+	kfree(buf);
+	return skb;
+}
+
+/* what get_srh() in seg6_local.c does on every End* packet */
+static int bench_get_srh(struct sk_buff *skb, struct ipv6_sr_hdr *unused)
+{
+	struct ipv6_sr_hdr *srh;
+	int srhoff = 0, len;
+
+	if (ipv6_find_hdr(skb, &srhoff, IPPROTO_ROUTING, NULL, NULL) < 0)
+		return -EINVAL;
+
+	if (!pskb_may_pull(skb, srhoff + sizeof(*srh)))
+		return -EINVAL;
+
+	srh = (struct ipv6_sr_hdr *)(skb->data + srhoff);
+	len = srh_len(srh);
+
+	if (!pskb_may_pull(skb, srhoff + len))
+		return -EINVAL;
+
+	srh = (struct ipv6_sr_hdr *)(skb->data + srhoff);
+
+	return seg6_validate_srh(srh, len) ? 0 : -EINVAL;
+}
+
+static int bench_encap(struct sk_buff *skb, struct ipv6_sr_hdr *srh)
+{
+	return seg6_do_srh_encap(skb, srh, IPPROTO_IPV6);
+}
+
+static int bench_inline(struct sk_buff *skb, struct ipv6_sr_hdr *srh)
+{
+	return seg6_do_srh_inline(skb, srh);
+}
+
+static const struct seg6_bench skb_benches[] = {
+	{ .name = "get_srh",	.srh_in_packet = true,	.run = bench_get_srh },
+	{ .name = "srh_encap",	.run = bench_encap },
+	{ .name = "srh_inline",	.run = bench_inline },
+};
+
+static void free_batch(struct sk_buff **skbs, struct sk_buff **origs, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		kfree_skb(skbs[i]);
+		kfree_skb(origs[i]);
+	}
+}
+
+static int run_skb_bench(const struct seg6_bench *b, int shape,
+			 struct ipv6_sr_hdr *srh, bool hmac)
+{
+	struct sk_buff *skbs[TEST_BATCH], *origs[TEST_BATCH];
+	unsigned char *heads[TEST_BATCH];
+	u64 start, elapsed = 0, reallocs = 0, ops = 0;
+	int i, err = 0;
+
+	while (ops < runs) {
+		for (i = 0; i < TEST_BATCH; i++) {
+			skbs[i] = build_skb_shaped(shape,
+						   b->srh_in_packet ? srh : NULL,
+						   &origs[i]);
+			if (!skbs[i]) {
+				free_batch(skbs, origs, i);
+				return -ENOMEM;
+			}
+			heads[i] = skbs[i]->head;
+		}
+
+		start = ktime_get_ns();
+		for (i = 0; i < TEST_BATCH && !err; i++)
+			err = b->run(skbs[i], srh);
+		elapsed += ktime_get_ns() - start;
+
+		for (i = 0; i < TEST_BATCH; i++)
+			reallocs += skbs[i]->head != heads[i];
+
+		free_batch(skbs, origs, TEST_BATCH);
+		ops += TEST_BATCH;
+
+		if (err)
+			break;
+	}
+
+	if (err) {
+		pr_info("%-12s %-6s segs %2d%s: error %d\n", b->name,
+			shape_names[shape], srh->first_segment + 1,
+			hmac ? " hmac" : "", err);
+		return 0;
+	}
+
+	pr_info("%-12s %-6s segs %2d%s: %6llu ns/op %4llu reallocs/1k\n",
+		b->name, shape_names[shape], srh->first_segment + 1,
+		hmac ? " hmac" : "", div64_u64(elapsed, ops),
+		div64_u64(reallocs * 1000, ops));
+
+	return 0;
+}
+
+static void run_validate_bench(struct ipv6_sr_hdr *srh, bool hmac)
+{
+	int i, len = srh_len(srh);
+	u64 start, elapsed;
+	int ok = 0;
+
+	start = ktime_get_ns();
+	for (i = 0; i < runs; i++)
+		ok += seg6_validate_srh(srh, len);
+	elapsed = ktime_get_ns() - start;
+
+	pr_info("%-12s %-6s segs %2d%s: %6llu ns/op (%s)\n", "validate_srh",
+		"-", srh->first_segment + 1, hmac ? " hmac" : "",
+		div64_u64(elapsed, runs), ok == runs ? "valid" : "INVALID");
+}
+
+#ifdef CONFIG_IPV6_SEG6_HMAC
+static struct seg6_hmac_info *test_hinfo;
+
+static int test_hmac_setup(void)
+{
+	struct seg6_hmac_info *hinfo;
+	int err;
+
+	hinfo = kzalloc(sizeof(*hinfo), GFP_KERNEL);
+	if (!hinfo)
+		return -ENOMEM;
+
+	hinfo->hmackeyid = hmac_keyid;
+	hinfo->alg_id = SEG6_HMAC_ALGO_SHA256;
+	hinfo->slen = sizeof("test_seg6") - 1;
+	memcpy(hinfo->secret, "test_seg6", hinfo->slen);
+
+	/* seg6_do_srh_encap() looks the key up in the netns of the dst */
+	err = seg6_hmac_info_add(&init_net, hmac_keyid, hinfo);
+	if (err) {
+		pr_info("HMAC key %u already in use, skipping HMAC tests\n",
+			hmac_keyid);
+		kfree(hinfo);
+		return 0;
+	}
+
+	test_hinfo = hinfo;
+	test_hmac = true;
+	return 0;
+}
+
+static void test_hmac_teardown(void)
+{
+	/* frees test_hinfo after a grace period */
+	if (test_hmac)
+		seg6_hmac_info_del(&init_net, hmac_keyid);
+}
+
+static void run_hmac_bench(struct ipv6_sr_hdr *srh)
+{
+	u8 out[SEG6_HMAC_FIELD_LEN];
+	struct in6_addr saddr = test_saddr;
+	u64 start, elapsed;
+	int i, err = 0;
+
+	start = ktime_get_ns();
+	for (i = 0; i < runs && !err; i++)
+		err = seg6_hmac_compute(test_hinfo, srh, &saddr, out);
+	elapsed = ktime_get_ns() - start;
+
+	if (err) {
+		pr_info("%-12s %-6s segs %2d hmac: error %d\n", "hmac_compute",
+			"-", srh->first_segment + 1, err);
+		return;
+	}
+
+	pr_info("%-12s %-6s segs %2d hmac: %6llu ns/op\n", "hmac_compute",
+		"-", srh->first_segment + 1, div64_u64(elapsed, runs));
+}
+#else
+static int test_hmac_setup(void)
+{
+	return 0;
+}
+
+static void test_hmac_teardown(void)
+{
+}
+
+static void run_hmac_bench(struct ipv6_sr_hdr *srh)
+{
+}
+#endif
+
+static int test_seg6(void)
+{
+	int i, j, shape, hmac, err = 0;
+
+	for (hmac = 0; hmac <= test_hmac; hmac++) {
+		for (i = 0; i < ARRAY_SIZE(test_nsegs); i++) {
+			struct ipv6_sr_hdr *srh;
+
+			srh = build_srh(test_nsegs[i], hmac);
+			if (!srh)
+				return -ENOMEM;
+
+			run_validate_bench(srh, hmac);
+			if (hmac)
+				run_hmac_bench(srh);
+
+			for (j = 0; j < ARRAY_SIZE(skb_benches) && !err; j++) {
+				for (shape = 0; shape < __SHAPE_MAX; shape++) {
+					err = run_skb_bench(&skb_benches[j],
+							    shape, srh, hmac);
+					if (err)
+						break;
+				}
+			}
+
+			kfree(srh);
+			if (err)
+				return err;
+
+			cond_resched();
+		}
+	}
+
+	return 0;
+}
+
+static int __init test_seg6_init(void)
+{
+	struct flowi6 fl6 = {
+		.daddr = in6addr_loopback,
+	};
+	int err;
+
+	if (runs <= 0)
+		return -EINVAL;
+
+	test_dst = ip6_route_output(&init_net, NULL, &fl6);
+	if (test_dst->error) {
+		err = test_dst->error;
+		dst_release(test_dst);
+		return err;
+	}
+
+	err = test_hmac_setup();
+	if (!err)
+		err = test_seg6();
+
+	test_hmac_teardown();
+	dst_release(test_dst);
+
+	return err;
+}
+
+static void __exit test_seg6_exit(void)
+{
+}
+
+module_init(test_seg6_init);
+module_exit(test_seg6_exit);
+
+MODULE_LICENSE("GPL");
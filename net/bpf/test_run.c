@@ -10,6 +10,8 @@
 #include <linux/etherdevice.h>
 #include <linux/filter.h>
 #include <linux/sched/signal.h>
+#include <net/page_pool.h>
+#include <net/xdp.h>
 
 static __always_inline u32 bpf_test_run_one(struct bpf_prog *prog, void *ctx)
 {
@@ -100,6 +102,9 @@ int bpf_prog_test_run_skb(struct bpf_prog *prog, const union bpf_attr *kattr,
 	void *data;
 	int ret;
 
+	if (kattr->test.flags || kattr->test.ifindex)
+		return -EINVAL;
+
 	data = bpf_test_init(kattr, size, NET_SKB_PAD + NET_IP_ALIGN,
 			     SKB_DATA_ALIGN(sizeof(struct skb_shared_info)));
 	if (IS_ERR(data))
@@ -146,6 +151,187 @@ int bpf_prog_test_run_skb(struct bpf_prog *prog, const union bpf_attr *kattr,
 	return ret;
 }
 
+#define XDP_TEST_BATCH_SIZE	64
+#define XDP_TEST_POOL_SIZE	1024
+#define XDP_TEST_HEADROOM	(XDP_PACKET_HEADROOM + NET_IP_ALIGN)
+
+/* Run the program over one batch of frames built from the template,
+ * acting on the verdicts as a driver would from its NAPI poll.
+ */
+static u32 bpf_test_run_xdp_batch(struct bpf_prog *prog,
+				  struct xdp_rxq_info *rxq,
+				  struct page_pool *pp, const void *tmpl,
+				  u32 size, u32 count, int *err)
+{
+	struct net_device *dev = rxq->dev;
+	struct xdp_frame *xdpf;
+	bool xmit = false;
+	struct xdp_buff xdp;
+	struct page *page;
+	u32 ret = 0, i;
+
+	local_bh_disable();
+	rcu_read_lock();
+	for (i = 0; i < count; i++) {
+		page = page_pool_dev_alloc_pages(pp);
+		if (unlikely(!page)) {
+			*err = -ENOMEM;
+			break;
+		}
+
+		xdp.data_hard_start = page_address(page);
+		xdp.data = xdp.data_hard_start + XDP_TEST_HEADROOM;
+		xdp.data_meta = xdp.data;
+		xdp.data_end = xdp.data + size;
+		xdp.rxq = rxq;
+		memcpy(xdp.data, tmpl, size);
+
+		ret = BPF_PROG_RUN(prog, &xdp);
+		switch (ret) {
+		case XDP_TX:
+			xdpf = convert_to_xdp_frame(&xdp);
+			if (unlikely(!xdpf || !dev->netdev_ops->ndo_xdp_xmit ||
+				     dev->netdev_ops->ndo_xdp_xmit(dev, xdpf)))
+				break;
+			xmit = true;
+			continue;
+		case XDP_REDIRECT:
+			if (unlikely(xdp_do_redirect(dev, &xdp, prog)))
+				break;
+			continue;
+		default:
+			/* XDP_PASS frames are not handed to the stack */
+			break;
+		}
+
+		page_pool_put_page(pp, page);
+	}
+
+	xdp_do_flush_map();
+	if (xmit)
+		dev->netdev_ops->ndo_xdp_flush(dev);
+	rcu_read_unlock();
+	local_bh_enable();
+
+	return ret;
+}
+
+static u32 bpf_test_run_xdp_live(struct bpf_prog *prog,
+				 struct xdp_rxq_info *rxq,
+				 struct page_pool *pp, const void *tmpl,
+				 u32 size, u32 repeat, u32 *time, int *err)
+{
+	u64 time_start, time_spent = 0;
+	u32 ret = 0, i, batch;
+
+	if (!repeat)
+		repeat = 1;
+	time_start = ktime_get_ns();
+	for (i = 0; i < repeat; i += batch) {
+		batch = min_t(u32, repeat - i, XDP_TEST_BATCH_SIZE);
+		ret = bpf_test_run_xdp_batch(prog, rxq, pp, tmpl, size, batch,
+					     err);
+		if (*err)
+			break;
+		if (need_resched()) {
+			if (signal_pending(current))
+				break;
+			time_spent += ktime_get_ns() - time_start;
+			cond_resched();
+			time_start = ktime_get_ns();
+		}
+	}
+	time_spent += ktime_get_ns() - time_start;
+	do_div(time_spent, repeat);
+	*time = time_spent > U32_MAX ? U32_MAX : (u32)time_spent;
+
+	return ret;
+}
+
+/* BPF_F_TEST_XDP_LIVE_FRAMES: rather than reporting what the program
+ * did to a single buffer, feed it repeat frames received on queue 0 of
+ * the given device and carry out XDP_TX and XDP_REDIRECT for real. Frames
+ * come from a page_pool that transmitted frames are recycled into.
+ */
+static int bpf_prog_test_run_xdp_live(struct bpf_prog *prog,
+				      const union bpf_attr *kattr,
+				      union bpf_attr __user *uattr)
+{
+	struct page_pool_params pp_params = {
+		.order		= 0,
+		.pool_size	= XDP_TEST_POOL_SIZE,
+		.nid		= NUMA_NO_NODE,
+		.dma_dir	= DMA_BIDIRECTIONAL,
+	};
+	u32 size = kattr->test.data_size_in;
+	u32 repeat = kattr->test.repeat;
+	struct xdp_rxq_info *rxq;
+	u32 retval, duration;
+	struct net_device *dev;
+	struct page_pool *pp;
+	void *data;
+	int ret;
+
+	if (kattr->test.data_out)
+		return -EINVAL;
+
+	/* frames redirected to a cpumap get their skb_shared_info
+	 * built right after the data, keep room for it in the page
+	 */
+	data = bpf_test_init(kattr, size, XDP_TEST_HEADROOM,
+			     SKB_DATA_ALIGN(sizeof(struct skb_shared_info)));
+	if (IS_ERR(data))
+		return PTR_ERR(data);
+
+	dev = dev_get_by_index(current->nsproxy->net_ns, kattr->test.ifindex);
+	if (!dev) {
+		ret = -ENODEV;
+		goto out_data;
+	}
+
+	rxq = kzalloc(sizeof(*rxq), GFP_KERNEL);
+	if (!rxq) {
+		ret = -ENOMEM;
+		goto out_dev;
+	}
+
+	ret = xdp_rxq_info_reg(rxq, dev, 0);
+	if (ret)
+		goto out_rxq;
+
+	pp = page_pool_create(&pp_params);
+	if (IS_ERR(pp)) {
+		ret = PTR_ERR(pp);
+		goto out_unreg;
+	}
+
+	ret = xdp_rxq_info_reg_mem_model(rxq, MEM_TYPE_PAGE_POOL, pp);
+	if (ret)
+		goto out_pool;
+
+	retval = bpf_test_run_xdp_live(prog, rxq, pp, data + XDP_TEST_HEADROOM,
+				       size, repeat, &duration, &ret);
+	if (!ret)
+		ret = bpf_test_finish(kattr, uattr, NULL, 0, retval, duration);
+
+out_pool:
+	/* Unregister first, frames still queued on devices are then given
+	 * back to the page allocator instead of the pool.
+	 */
+	xdp_rxq_info_unreg(rxq);
+	page_pool_destroy(pp);
+	goto out_rxq;
+out_unreg:
+	xdp_rxq_info_unreg(rxq);
+out_rxq:
+	kfree(rxq);
+out_dev:
+	dev_put(dev);
+out_data:
+	kfree(data);
+	return ret;
+}
+
 int bpf_prog_test_run_xdp(struct bpf_prog *prog, const union bpf_attr *kattr,
 			  union bpf_attr __user *uattr)
 {
@@ -157,6 +343,13 @@ int bpf_prog_test_run_xdp(struct bpf_prog *prog, const union bpf_attr *kattr,
 	void *data;
 	int ret;
 
+	if (kattr->test.flags & ~BPF_F_TEST_XDP_LIVE_FRAMES)
+		return -EINVAL;
+	if (kattr->test.flags & BPF_F_TEST_XDP_LIVE_FRAMES)
+		return bpf_prog_test_run_xdp_live(prog, kattr, uattr);
+	if (kattr->test.ifindex)
+		return -EINVAL;
+
 	data = bpf_test_init(kattr, size, XDP_PACKET_HEADROOM + NET_IP_ALIGN, 0);
 	if (IS_ERR(data))
 		return PTR_ERR(data);
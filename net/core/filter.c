@@ -65,8 +65,10 @@
 #include <net/flow.h>
 #include <net/arp.h>
 #include <net/ipv6.h>
+#include <linux/seg6_iptunnel.h>
 #include <linux/seg6_local.h>
 #include <net/seg6.h>
+#include <net/seg6_hmac.h>
 #include <net/seg6_local.h>
 
 /**
@@ -4158,8 +4160,13 @@ static int bpf_ipv4_fib_lookup(struct net *net, struct bpf_fib_lookup *params,
 #endif
 
 #if IS_ENABLED(CONFIG_IPV6)
+#if IS_ENABLED(CONFIG_IPV6_SEG6_BPF)
+static int bpf_fib_seg6_lookup(struct net *net, struct bpf_fib_lookup *params,
+			       int plen, u32 flags, struct fib6_info *f6i);
+#endif
+
 static int bpf_ipv6_fib_lookup(struct net *net, struct bpf_fib_lookup *params,
-			       u32 flags)
+			       int plen, u32 flags)
 {
 	struct in6_addr *src = (struct in6_addr *) params->ipv6_src;
 	struct in6_addr *dst = (struct in6_addr *) params->ipv6_dst;
@@ -4171,6 +4178,12 @@ static int bpf_ipv6_fib_lookup(struct net *net, struct bpf_fib_lookup *params,
 	int strict = 0;
 	int oif;
 
+	if (flags & BPF_FIB_LOOKUP_SEG6) {
+		if (plen < sizeof(*params) + sizeof(struct bpf_fib_seg6))
+			return -EINVAL;
+		memset(params + 1, 0, sizeof(struct bpf_fib_seg6));
+	}
+
 	/* link local addresses are never forwarded */
 	if (rt6_need_strict(dst) || rt6_need_strict(src))
 		return 0;
@@ -4232,8 +4245,15 @@ static int bpf_ipv6_fib_lookup(struct net *net, struct bpf_fib_lookup *params,
 						       fl6.flowi6_oif, NULL,
 						       strict);
 
-	if (f6i->fib6_nh.nh_lwtstate)
+	if (f6i->fib6_nh.nh_lwtstate) {
+#if IS_ENABLED(CONFIG_IPV6_SEG6_BPF)
+		if (flags & BPF_FIB_LOOKUP_SEG6 &&
+		    f6i->fib6_nh.nh_lwtstate->type == LWTUNNEL_ENCAP_SEG6)
+			return bpf_fib_seg6_lookup(net, params, plen, flags,
+						   f6i);
+#endif
 		return 0;
+	}
 
 	if (f6i->fib6_flags & RTF_GATEWAY)
 		*dst = f6i->fib6_nh.nh_gw;
@@ -4252,6 +4272,66 @@ static int bpf_ipv6_fib_lookup(struct net *net, struct bpf_fib_lookup *params,
 
 	return 0;
 }
+
+#if IS_ENABLED(CONFIG_IPV6_SEG6_BPF)
+/* f6i steers the destination into an SR policy: describe the SRH to push
+ * and forward towards the first segment, as seg6_input() would.
+ */
+static int bpf_fib_seg6_lookup(struct net *net, struct bpf_fib_lookup *params,
+			       int plen, u32 flags, struct fib6_info *f6i)
+{
+	struct bpf_fib_seg6 *seg6 = (struct bpf_fib_seg6 *)(params + 1);
+	struct in6_addr *src = (struct in6_addr *)seg6->ipv6_src;
+	struct bpf_fib_lookup fwd;
+	struct ipv6_sr_hdr *srh;
+	int srh_len, mode, ret;
+
+	srh = seg6_lwt_policy(f6i->fib6_nh.nh_lwtstate, f6i->fib6_nh.nh_dev,
+			      &mode, src);
+	if (!srh || mode == SEG6_IPTUN_MODE_L2ENCAP)
+		return 0;
+
+	/* inline mode signs the original destination, not known here */
+	if (mode == SEG6_IPTUN_MODE_INLINE && sr_has_hmac(srh))
+		return 0;
+
+	if (mode == SEG6_IPTUN_MODE_INLINE)
+		memcpy(src, params->ipv6_src, sizeof(*src));
+
+	srh_len = (srh->hdrlen + 1) << 3;
+
+	seg6->mode = mode;
+	seg6->srh_len = srh_len;
+	memcpy(seg6->segment, &srh->segments[srh->first_segment],
+	       sizeof(struct in6_addr));
+
+	if (plen - sizeof(*params) - sizeof(*seg6) < srh_len)
+		return -ENOSPC;
+
+	memcpy(seg6->srh, srh, srh_len);
+
+#ifdef CONFIG_IPV6_SEG6_HMAC
+	if (sr_has_hmac(srh) &&
+	    seg6_push_hmac(net, src, (struct ipv6_sr_hdr *)seg6->srh))
+		return 0;
+#endif
+
+	/* params are only updated once the active segment is reachable */
+	fwd = *params;
+	memcpy(fwd.ipv6_src, src, sizeof(fwd.ipv6_src));
+	memcpy(fwd.ipv6_dst, seg6->segment, sizeof(fwd.ipv6_dst));
+	fwd.l4_protocol = NEXTHDR_ROUTING;
+	fwd.sport = 0;
+	fwd.dport = 0;
+
+	ret = bpf_ipv6_fib_lookup(net, &fwd, sizeof(fwd),
+				  flags & ~BPF_FIB_LOOKUP_SEG6);
+	if (ret > 0)
+		*params = fwd;
+
+	return ret;
+}
+#endif
 #endif
 
 BPF_CALL_4(bpf_xdp_fib_lookup, struct xdp_buff *, ctx,
@@ -4269,7 +4349,7 @@ BPF_CALL_4(bpf_xdp_fib_lookup, struct xdp_buff *, ctx,
 #if IS_ENABLED(CONFIG_IPV6)
 	case AF_INET6:
 		return bpf_ipv6_fib_lookup(dev_net(ctx->rxq->dev), params,
-					   flags);
+					   plen, flags);
 #endif
 	}
 	return 0;
@@ -4298,7 +4378,8 @@ BPF_CALL_4(bpf_skb_fib_lookup, struct sk_buff *, skb,
 #endif
 #if IS_ENABLED(CONFIG_IPV6)
 	case AF_INET6:
-		return bpf_ipv6_fib_lookup(dev_net(skb->dev), params, flags);
+		return bpf_ipv6_fib_lookup(dev_net(skb->dev), params, plen,
+					   flags);
 #endif
 	}
 	return -ENOTSUPP;
@@ -4315,7 +4396,8 @@ static const struct bpf_func_proto bpf_skb_fib_lookup_proto = {
 };
 
 #if IS_ENABLED(CONFIG_IPV6_SEG6_BPF)
-static int bpf_push_seg6_encap(struct sk_buff *skb, u32 type, void *hdr, u32 len)
+static int bpf_push_seg6_encap(struct sk_buff *skb, u32 type, void *hdr, u32 len,
+			       bool ingress)
 {
 	int err;
 	struct ipv6_sr_hdr *srh = (struct ipv6_sr_hdr *)hdr;
@@ -4346,26 +4428,55 @@ static int bpf_push_seg6_encap(struct sk_buff *skb, u32 type, void *hdr, u32 len
 	ipv6_hdr(skb)->payload_len = htons(skb->len - sizeof(struct ipv6hdr));
 	skb_set_transport_header(skb, sizeof(struct ipv6hdr));
 
+	/* Packets leaving the host are routed towards their new outer
+	 * destination the way locally generated ones would be.
+	 */
+	if (!ingress)
+		return bpf_lwt_reroute6(skb);
+
 	return seg6_lookup_nexthop(skb, NULL, 0);
 }
 #endif /* CONFIG_IPV6_SEG6_BPF */
 
-BPF_CALL_4(bpf_lwt_push_encap, struct sk_buff *, skb, u32, type, void *, hdr,
-	   u32, len)
+static int bpf_lwt_push_encap(struct sk_buff *skb, u32 type, void *hdr,
+			      u32 len, bool ingress)
 {
 	switch (type) {
 #if IS_ENABLED(CONFIG_IPV6_SEG6_BPF)
 	case BPF_LWT_ENCAP_SEG6:
 	case BPF_LWT_ENCAP_SEG6_INLINE:
-		return bpf_push_seg6_encap(skb, type, hdr, len);
+		seg6_bpf_rec_uncacheable(this_cpu_ptr(&seg6_bpf_srh_states));
+		return bpf_push_seg6_encap(skb, type, hdr, len, ingress);
 #endif
 	default:
 		return -EINVAL;
 	}
 }
 
-static const struct bpf_func_proto bpf_lwt_push_encap_proto = {
-	.func		= bpf_lwt_push_encap,
+BPF_CALL_4(bpf_lwt_in_push_encap, struct sk_buff *, skb, u32, type,
+	   void *, hdr, u32, len)
+{
+	return bpf_lwt_push_encap(skb, type, hdr, len, true);
+}
+
+BPF_CALL_4(bpf_lwt_out_push_encap, struct sk_buff *, skb, u32, type,
+	   void *, hdr, u32, len)
+{
+	return bpf_lwt_push_encap(skb, type, hdr, len, false);
+}
+
+static const struct bpf_func_proto bpf_lwt_in_push_encap_proto = {
+	.func		= bpf_lwt_in_push_encap,
+	.gpl_only	= false,
+	.ret_type	= RET_INTEGER,
+	.arg1_type	= ARG_PTR_TO_CTX,
+	.arg2_type	= ARG_ANYTHING,
+	.arg3_type	= ARG_PTR_TO_MEM,
+	.arg4_type	= ARG_CONST_SIZE
+};
+
+static const struct bpf_func_proto bpf_lwt_out_push_encap_proto = {
+	.func		= bpf_lwt_out_push_encap,
 	.gpl_only	= false,
 	.ret_type	= RET_INTEGER,
 	.arg1_type	= ARG_PTR_TO_CTX,
@@ -4402,6 +4513,7 @@ BPF_CALL_4(bpf_lwt_seg6_store_bytes, struct sk_buff *, skb, u32, offset,
 		return -EFAULT;
 
 	memcpy(skb->data + offset, from, len);
+	seg6_bpf_rec_write(srh_state, offset - srhoff, from, len);
 	return 0;
 #else /* CONFIG_IPV6_SEG6_BPF */
 	return -EOPNOTSUPP;
@@ -4450,21 +4562,33 @@ BPF_CALL_4(bpf_lwt_seg6_action, struct sk_buff *, skb,
 	case SEG6_LOCAL_ACTION_END_X:
 		if (param_len != sizeof(struct in6_addr))
 			return -EINVAL;
+		if (srh_state->rec) {
+			srh_state->rec->action = action;
+			srh_state->rec->action_mark = skb->mark;
+			srh_state->rec->nh6 = *(struct in6_addr *)param;
+		}
 		return seg6_lookup_nexthop(skb, (struct in6_addr *)param, 0);
 	case SEG6_LOCAL_ACTION_END_T:
 		if (param_len != sizeof(int))
 			return -EINVAL;
+		if (srh_state->rec) {
+			srh_state->rec->action = action;
+			srh_state->rec->action_mark = skb->mark;
+			srh_state->rec->table = *(int *)param;
+		}
 		return seg6_lookup_nexthop(skb, NULL, *(int *)param);
 	case SEG6_LOCAL_ACTION_END_B6:
+		seg6_bpf_rec_uncacheable(srh_state);
 		err = bpf_push_seg6_encap(skb, BPF_LWT_ENCAP_SEG6_INLINE,
-					  param, param_len);
+					  param, param_len, true);
 		if (!err)
 			srh_state->hdrlen =
 				((struct ipv6_sr_hdr *)param)->hdrlen << 3;
 		return err;
 	case SEG6_LOCAL_ACTION_END_B6_ENCAP:
+		seg6_bpf_rec_uncacheable(srh_state);
 		err = bpf_push_seg6_encap(skb, BPF_LWT_ENCAP_SEG6,
-					  param, param_len);
+					  param, param_len, true);
 		if (!err)
 			srh_state->hdrlen =
 				((struct ipv6_sr_hdr *)param)->hdrlen << 3;
@@ -4473,6 +4597,7 @@ BPF_CALL_4(bpf_lwt_seg6_action, struct sk_buff *, skb,
 		if (param_len != sizeof(int))
 			return -EINVAL;
 
+		seg6_bpf_rec_uncacheable(srh_state);
 		if (ipv6_find_hdr(skb, &hdroff, IPPROTO_IPV6, NULL, NULL) < 0)
 			return -EBADMSG;
 
@@ -4542,6 +4667,7 @@ BPF_CALL_3(bpf_lwt_seg6_adjust_srh, struct sk_buff *, skb, u32, offset,
 	if (unlikely(len < 0 && (void *)((char *)ptr - len) > srh_end))
 		return -EFAULT;
 
+	seg6_bpf_rec_uncacheable(srh_state);
 	if (len > 0) {
 		ret = skb_cow_head(skb, len);
 		if (unlikely(ret < 0))
@@ -4576,6 +4702,28 @@ static const struct bpf_func_proto bpf_lwt_seg6_adjust_srh_proto = {
 	.arg3_type	= ARG_ANYTHING,
 };
 
+BPF_CALL_1(bpf_lwt_seg6_cache_flush, struct sk_buff *, skb)
+{
+#if IS_ENABLED(CONFIG_IPV6_SEG6_BPF)
+	struct seg6_bpf_srh_state *srh_state =
+		this_cpu_ptr(&seg6_bpf_srh_states);
+
+	/* the flush itself is done by End.BPF once the program returns */
+	if (srh_state->rec)
+		srh_state->rec->flush = true;
+	return 0;
+#else /* CONFIG_IPV6_SEG6_BPF */
+	return -EOPNOTSUPP;
+#endif
+}
+
+static const struct bpf_func_proto bpf_lwt_seg6_cache_flush_proto = {
+	.func		= bpf_lwt_seg6_cache_flush,
+	.gpl_only	= false,
+	.ret_type	= RET_INTEGER,
+	.arg1_type	= ARG_PTR_TO_CTX,
+};
+
 BPF_CALL_5(bpf_ipv6_fib_multipath_nh, struct sk_buff *, skb, struct in6_addr *,
 	   dst, int, dst_len, void *, buf, int, buf_len)
 {
@@ -4691,7 +4839,8 @@ bool bpf_helper_changes_pkt_data(void *func)
 	    func == bpf_xdp_adjust_meta ||
 	    func == bpf_msg_pull_data ||
 	    func == bpf_xdp_adjust_tail ||
-	    func == bpf_lwt_push_encap ||
+	    func == bpf_lwt_in_push_encap ||
+	    func == bpf_lwt_out_push_encap ||
 	    func == bpf_lwt_seg6_store_bytes ||
 	    func == bpf_lwt_seg6_adjust_srh ||
 	    func == bpf_lwt_seg6_action
@@ -4977,7 +5126,7 @@ lwt_out_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
 	case BPF_FUNC_skb_under_cgroup:
 		return &bpf_skb_under_cgroup_proto;
 	case BPF_FUNC_lwt_push_encap:
-		return &bpf_lwt_push_encap_proto;
+		return &bpf_lwt_out_push_encap_proto;
 
 	default:
 		return bpf_base_func_proto(func_id);
@@ -4989,7 +5138,7 @@ lwt_in_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
 {
 	switch (func_id) {
 	case BPF_FUNC_lwt_push_encap:
-		return &bpf_lwt_push_encap_proto;
+		return &bpf_lwt_in_push_encap_proto;
 	default:
 		return lwt_out_func_proto(func_id, prog);
 	}
@@ -5025,6 +5174,8 @@ lwt_xmit_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
 		return &bpf_l4_csum_replace_proto;
 	case BPF_FUNC_set_hash_invalid:
 		return &bpf_set_hash_invalid_proto;
+	case BPF_FUNC_lwt_push_encap:
+		return &bpf_lwt_out_push_encap_proto;
 	default:
 		return lwt_in_func_proto(func_id, prog);
 	}
@@ -5040,8 +5191,12 @@ lwt_seg6local_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
 		return &bpf_lwt_seg6_action_proto;
 	case BPF_FUNC_lwt_seg6_adjust_srh:
 		return &bpf_lwt_seg6_adjust_srh_proto;
+	case BPF_FUNC_lwt_seg6_cache_flush:
+		return &bpf_lwt_seg6_cache_flush_proto;
 	case BPF_FUNC_ipv6_fib_multipath_nh:
 		return &bpf_ipv6_fib_multipath_nh_proto;
+	case BPF_FUNC_lwt_push_encap:
+		return &bpf_lwt_in_push_encap_proto;
 	default:
 		return lwt_out_func_proto(func_id, prog);
 	}
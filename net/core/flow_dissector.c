@@ -22,6 +22,7 @@
 #include <linux/if_ether.h>
 #include <linux/mpls.h>
 #include <linux/tcp.h>
+#include <linux/seg6.h>
 #include <net/flow_dissector.h>
 #include <scsi/fc/fc_fcoe.h>
 #include <uapi/linux/batadv_packet.h>
@@ -547,6 +548,48 @@ __skb_flow_dissect_ipv6(const struct sk_buff *skb,
 	key_ip->ttl = iph->hop_limit;
 }
 
+static void
+__skb_flow_dissect_srh(const struct sk_buff *skb,
+		       struct flow_dissector *flow_dissector,
+		       void *target_container, void *data, int nhoff, int hlen)
+{
+	struct flow_dissector_key_srh *key_srh;
+	struct ipv6_sr_hdr *srh, _srh;
+	struct in6_addr *seg, _seg;
+
+	if (!dissector_uses_key(flow_dissector, FLOW_DISSECTOR_KEY_SRH))
+		return;
+
+	srh = __skb_header_pointer(skb, nhoff, sizeof(_srh), data, hlen, &_srh);
+	if (!srh || srh->type != IPV6_SRCRT_TYPE_4)
+		return;
+
+	/* the segment list must fit in the header and contain the
+	 * active segment
+	 */
+	if (srh->segments_left > srh->first_segment ||
+	    ((srh->first_segment + 1) << 1) > srh->hdrlen)
+		return;
+
+	key_srh = skb_flow_dissector_target(flow_dissector,
+					    FLOW_DISSECTOR_KEY_SRH,
+					    target_container);
+	key_srh->segments_left = srh->segments_left;
+	key_srh->flags = srh->flags;
+	key_srh->tag = srh->tag;
+
+	seg = __skb_header_pointer(skb, nhoff + sizeof(*srh) +
+				   srh->segments_left * sizeof(_seg),
+				   sizeof(_seg), data, hlen, &_seg);
+	if (seg)
+		key_srh->active_seg = *seg;
+
+	seg = __skb_header_pointer(skb, nhoff + sizeof(*srh), sizeof(_seg),
+				   data, hlen, &_seg);
+	if (seg)
+		key_srh->last_seg = *seg;
+}
+
 /* Maximum number of protocol headers that can be parsed in
  * __skb_flow_dissect
  */
@@ -918,6 +961,11 @@ bool __skb_flow_dissect(const struct sk_buff *skb,
 			break;
 		}
 
+		if (ip_proto == NEXTHDR_ROUTING)
+			__skb_flow_dissect_srh(skb, flow_dissector,
+					       target_container, data,
+					       nhoff, hlen);
+
 		ip_proto = opthdr[0];
 		nhoff += (opthdr[1] + 1) << 3;
 
@@ -16,6 +16,9 @@
 #include <linux/types.h>
 #include <linux/bpf.h>
 #include <net/lwtunnel.h>
+#include <net/dst_cache.h>
+#include <net/ip6_route.h>
+#include <net/seg6.h>
 
 struct bpf_lwt_prog {
 	struct bpf_prog *prog;
@@ -27,6 +30,13 @@ struct bpf_lwt {
 	struct bpf_lwt_prog out;
 	struct bpf_lwt_prog xmit;
 	int family;
+#if IS_ENABLED(CONFIG_IPV6_SEG6_BPF)
+	/* outer routes of packets encapsulated by the out and xmit programs,
+	 * each valid for the destination it was looked up for only
+	 */
+	struct dst_cache cache;
+	struct in6_addr __percpu *cache_daddr;
+#endif
 };
 
 #define MAX_PROG_NAME 256
@@ -88,6 +98,38 @@ static int run_lwt_bpf(struct sk_buff *skb, struct bpf_lwt_prog *lwt,
 	return ret;
 }
 
+static int xmit_check_hhlen(struct sk_buff *skb)
+{
+	int hh_len = skb_dst(skb)->dev->hard_header_len;
+
+	if (skb_headroom(skb) < hh_len) {
+		int nhead = HH_DATA_ALIGN(hh_len - skb_headroom(skb));
+
+		if (pskb_expand_head(skb, nhead, 0, GFP_ATOMIC))
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/* lwt_push_encap moved the packet to the route of its new outer header */
+static int bpf_lwt_output_rerouted(struct net *net, struct sock *sk,
+				   struct sk_buff *skb, int family)
+{
+	int err;
+
+	err = xmit_check_hhlen(skb);
+	if (unlikely(err)) {
+		kfree_skb(skb);
+		return err;
+	}
+
+	if (family != AF_INET6)
+		memset(IP6CB(skb), 0, sizeof(*IP6CB(skb)));
+
+	return dst_output(net, sk, skb);
+}
+
 static int bpf_input(struct sk_buff *skb)
 {
 	struct dst_entry *dst = skb_dst(skb);
@@ -119,9 +161,15 @@ static int bpf_output(struct net *net, struct sock *sk, struct sk_buff *skb)
 
 	bpf = bpf_lwt_lwtunnel(dst->lwtstate);
 	if (bpf->out.prog) {
+		/* bpf lives in the lwtstate of dst, gone once rerouted */
+		int family = bpf->family;
+
 		ret = run_lwt_bpf(skb, &bpf->out, dst, NO_REDIRECT);
 		if (ret < 0)
 			return ret;
+
+		if (skb_dst(skb) != dst)
+			return bpf_lwt_output_rerouted(net, sk, skb, family);
 	}
 
 	if (unlikely(!dst->lwtstate->orig_output)) {
@@ -134,32 +182,31 @@ static int bpf_output(struct net *net, struct sock *sk, struct sk_buff *skb)
 	return dst->lwtstate->orig_output(net, sk, skb);
 }
 
-static int xmit_check_hhlen(struct sk_buff *skb)
-{
-	int hh_len = skb_dst(skb)->dev->hard_header_len;
-
-	if (skb_headroom(skb) < hh_len) {
-		int nhead = HH_DATA_ALIGN(hh_len - skb_headroom(skb));
-
-		if (pskb_expand_head(skb, nhead, 0, GFP_ATOMIC))
-			return -ENOMEM;
-	}
-
-	return 0;
-}
-
 static int bpf_xmit(struct sk_buff *skb)
 {
 	struct dst_entry *dst = skb_dst(skb);
+	struct net *net = dev_net(dst->dev);
 	struct bpf_lwt *bpf;
 
 	bpf = bpf_lwt_lwtunnel(dst->lwtstate);
 	if (bpf->xmit.prog) {
+		int family = bpf->family;
 		int ret;
 
 		ret = run_lwt_bpf(skb, &bpf->xmit, dst, CAN_REDIRECT);
 		switch (ret) {
 		case BPF_OK:
+			/* The neighbour of the original route no longer
+			 * applies, go through the output path of the new one.
+			 * The reference on the original dst, and thus bpf, is
+			 * gone by now.
+			 */
+			if (skb_dst(skb) != dst) {
+				ret = bpf_lwt_output_rerouted(net, skb->sk, skb,
+							      family);
+				return ret < 0 ? ret : LWTUNNEL_XMIT_DONE;
+			}
+
 			/* If the header was expanded, headroom might be too
 			 * small for L2 header to come, expand as needed.
 			 */
@@ -193,7 +240,83 @@ static void bpf_destroy_state(struct lwtunnel_state *lwt)
 	bpf_lwt_prog_destroy(&bpf->in);
 	bpf_lwt_prog_destroy(&bpf->out);
 	bpf_lwt_prog_destroy(&bpf->xmit);
+#if IS_ENABLED(CONFIG_IPV6_SEG6_BPF)
+	dst_cache_destroy(&bpf->cache);
+	free_percpu(bpf->cache_daddr);
+#endif
+}
+
+#if IS_ENABLED(CONFIG_IPV6_SEG6_BPF)
+/* Route a packet to which an out or xmit program pushed an SRv6 header
+ * towards its new outer destination, through the output FIB as
+ * seg6_output() does. Programs may push a different segment list to each
+ * packet, so the per-CPU cached route is only reused when it was looked
+ * up for the same destination and source. Marked packets may match policy
+ * routing rules of their own and always go through the FIB. Packets without a route, such as those of
+ * BPF_PROG_TEST_RUN, are routed like the seg6local actions route them.
+ * Called with preemption disabled.
+ */
+int bpf_lwt_reroute6(struct sk_buff *skb)
+{
+	struct dst_entry *orig_dst = skb_dst(skb);
+	struct ipv6hdr *hdr = ipv6_hdr(skb);
+	struct in6_addr *cache_daddr = NULL;
+	struct dst_entry *dst = NULL;
+	struct bpf_lwt *bpf = NULL;
+	struct in6_addr saddr;
+	struct flowi6 fl6;
+
+	if (unlikely(!orig_dst))
+		return seg6_lookup_nexthop(skb, NULL, 0);
+
+	if (!skb->mark && orig_dst->lwtstate &&
+	    orig_dst->lwtstate->type == LWTUNNEL_ENCAP_BPF &&
+	    bpf_lwt_lwtunnel(orig_dst->lwtstate)->cache_daddr) {
+		bpf = bpf_lwt_lwtunnel(orig_dst->lwtstate);
+		cache_daddr = this_cpu_ptr(bpf->cache_daddr);
+		if (ipv6_addr_equal(cache_daddr, &hdr->daddr)) {
+			dst = dst_cache_get_ip6(&bpf->cache, &saddr);
+			if (dst && !ipv6_addr_equal(&saddr, &hdr->saddr)) {
+				dst_release(dst);
+				dst = NULL;
+			}
+		}
+	}
+
+	if (unlikely(!dst)) {
+		memset(&fl6, 0, sizeof(fl6));
+		fl6.daddr = hdr->daddr;
+		fl6.saddr = hdr->saddr;
+		fl6.flowlabel = ip6_flowinfo(hdr);
+		fl6.flowi6_mark = skb->mark;
+		fl6.flowi6_proto = hdr->nexthdr;
+
+		dst = ip6_route_output(dev_net(orig_dst->dev), NULL, &fl6);
+		if (dst->error) {
+			int err = dst->error;
+
+			dst_release(dst);
+			return err;
+		}
+
+		/* the new outer destination leads back into this program */
+		if (unlikely(dst->lwtstate == orig_dst->lwtstate)) {
+			dst_release(dst);
+			return -ELOOP;
+		}
+
+		if (bpf) {
+			dst_cache_set_ip6(&bpf->cache, dst, &fl6.saddr);
+			*cache_daddr = hdr->daddr;
+		}
+	}
+
+	skb_dst_drop(skb);
+	skb_dst_set(skb, dst);
+
+	return 0;
 }
+#endif
 
 static const struct nla_policy bpf_prog_policy[LWT_BPF_PROG_MAX + 1] = {
 	[LWT_BPF_PROG_FD]   = { .type = NLA_U32, },
@@ -300,6 +423,22 @@ static int bpf_build_state(struct nlattr *nla,
 		newts->headroom = headroom;
 	}
 
+#if IS_ENABLED(CONFIG_IPV6_SEG6_BPF)
+	/* only IPv6 out and xmit programs may push SRv6 and get rerouted */
+	if (family == AF_INET6 && (bpf->out.prog || bpf->xmit.prog)) {
+		ret = dst_cache_init(&bpf->cache, GFP_ATOMIC);
+		if (ret)
+			goto errout;
+
+		bpf->cache_daddr = alloc_percpu_gfp(struct in6_addr,
+						    GFP_ATOMIC);
+		if (!bpf->cache_daddr) {
+			ret = -ENOMEM;
+			goto errout;
+		}
+	}
+#endif
+
 	bpf->family = family;
 	*ts = newts;
 
@@ -313,6 +313,43 @@ int lwtunnel_cmp_encap(struct lwtunnel_state *a, struct lwtunnel_state *b)
 }
 EXPORT_SYMBOL_GPL(lwtunnel_cmp_encap);
 
+/* Returns NULL when the encap of dst cannot be expressed as a template,
+ * in which case packets routed through it must use dst_output().
+ */
+struct lwtunnel_encap_tmpl *lwtunnel_get_encap_tmpl(struct dst_entry *dst,
+						    u8 family)
+{
+	struct lwtunnel_state *lwtstate = dst->lwtstate;
+	const struct lwtunnel_encap_ops *ops;
+	struct lwtunnel_encap_tmpl *tmpl = NULL;
+
+	if (!lwtstate)
+		return NULL;
+
+	if (lwtstate->type == LWTUNNEL_ENCAP_NONE ||
+	    lwtstate->type > LWTUNNEL_ENCAP_MAX)
+		return NULL;
+
+	rcu_read_lock();
+	ops = rcu_dereference(lwtun_encaps[lwtstate->type]);
+	if (likely(ops && ops->get_encap_tmpl))
+		tmpl = ops->get_encap_tmpl(dst, family);
+	rcu_read_unlock();
+
+	return tmpl;
+}
+EXPORT_SYMBOL_GPL(lwtunnel_get_encap_tmpl);
+
+void lwtunnel_encap_tmpl_free(struct lwtunnel_encap_tmpl *tmpl)
+{
+	if (!tmpl)
+		return;
+
+	dst_release(tmpl->dst);
+	kfree(tmpl);
+}
+EXPORT_SYMBOL_GPL(lwtunnel_encap_tmpl_free);
+
 int lwtunnel_output(struct net *net, struct sock *sk, struct sk_buff *skb)
 {
 	struct dst_entry *dst = skb_dst(skb);
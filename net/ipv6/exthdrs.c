@@ -361,6 +361,10 @@ static int ipv6_srh_rcv(struct sk_buff *skb)
 	struct inet6_dev *idev;
 	struct in6_addr *addr;
 	int accept_seg6;
+#ifdef CONFIG_IPV6_SEG6_HMAC
+	struct sr6_xdp_meta meta;
+	bool hmac_ok = false;
+#endif
 
 	hdr = (struct ipv6_sr_hdr *)skb_transport_header(skb);
 
@@ -376,12 +380,20 @@ static int ipv6_srh_rcv(struct sk_buff *skb)
 	}
 
 #ifdef CONFIG_IPV6_SEG6_HMAC
-	if (!seg6_hmac_validate_skb(skb)) {
+	/* XDP may have checked the HMAC of this very header already */
+	if (seg6_xdp_meta_get(skb, &meta) &&
+	    skb_network_header(skb) + meta.srh_off == (u8 *)hdr &&
+	    meta.segments_left == hdr->segments_left)
+		hmac_ok = meta.flags & SR6_XDP_META_HMAC;
+
+	if (!hmac_ok && !seg6_hmac_validate_skb(skb)) {
 		kfree_skb(skb);
 		return -1;
 	}
 #endif
 
+	seg6_oam_sample(skb, hdr);
+
 looped_back:
 	if (hdr->segments_left == 0) {
 		if (hdr->nexthdr == NEXTHDR_IPV6) {
@@ -179,6 +179,83 @@ static bool icmpv6_mask_allow(int type)
 	return false;
 }
 
+struct icmpv6_err_bucket {
+	u32	credit;
+	u32	stamp;
+};
+
+/* Token buckets of one CPU, only ever touched by that CPU with BH
+ * disabled. They are checked before anything else on the error path so
+ * that floods of packets triggering errors, e.g. SRHs spoofed to fail
+ * validation, cost a few loads each rather than contention on the
+ * global ratelimit and the inet_peer tree.
+ */
+struct icmpv6_err_ratelimit {
+	struct icmpv6_err_bucket all;
+	struct icmpv6_err_bucket type[3];
+};
+
+/* slot of an error type in icmpv6_errors_per_cpu_type_rate */
+static int icmpv6_err_type_index(int type)
+{
+	switch (type) {
+	case ICMPV6_DEST_UNREACH:
+		return 0;
+	case ICMPV6_TIME_EXCEED:
+		return 1;
+	case ICMPV6_PARAMPROB:
+		return 2;
+	}
+
+	return -1;
+}
+
+static bool icmpv6_bucket_allow(struct icmpv6_err_bucket *b, u32 rate,
+				u32 burst, u32 now)
+{
+	u32 incr;
+
+	incr = div_u64((u64)rate * min_t(u32, now - b->stamp, HZ), HZ);
+	if (incr) {
+		b->credit = min(b->credit + incr, burst);
+		b->stamp = now;
+	}
+
+	if (!b->credit)
+		return false;
+
+	b->credit--;
+	return true;
+}
+
+static bool icmpv6_percpu_allow(struct net *net, int type)
+{
+	int *type_rate = net->ipv6.sysctl.icmpv6_errors_per_cpu_type_rate;
+	struct icmpv6_err_ratelimit *rl;
+	u32 now = (u32)jiffies;
+	int burst, rate, i;
+
+	if (icmpv6_mask_allow(type))
+		return true;
+
+	rl = this_cpu_ptr(net->ipv6.icmpv6_err_rl);
+	burst = READ_ONCE(net->ipv6.sysctl.icmpv6_errors_per_cpu_burst);
+
+	i = icmpv6_err_type_index(type);
+	if (i >= 0) {
+		rate = READ_ONCE(type_rate[i]);
+		if (rate > 0 &&
+		    !icmpv6_bucket_allow(&rl->type[i], rate, burst, now))
+			return false;
+	}
+
+	rate = READ_ONCE(net->ipv6.sysctl.icmpv6_errors_per_cpu_rate);
+	if (rate > 0 && !icmpv6_bucket_allow(&rl->all, rate, burst, now))
+		return false;
+
+	return true;
+}
+
 static bool icmpv6_global_allow(int type)
 {
 	if (icmpv6_mask_allow(type))
@@ -504,8 +581,9 @@ static void icmp6_send(struct sk_buff *skb, u8 type, u8 code, __u32 info,
 	/* Needed by both icmp_global_allow and icmpv6_xmit_lock */
 	local_bh_disable();
 
-	/* Check global sysctl_icmp_msgs_per_sec ratelimit */
-	if (!(skb->dev->flags&IFF_LOOPBACK) && !icmpv6_global_allow(type))
+	/* Check the per-CPU, then global sysctl_icmp_msgs_per_sec ratelimit */
+	if (!(skb->dev->flags&IFF_LOOPBACK) &&
+	    (!icmpv6_percpu_allow(net, type) || !icmpv6_global_allow(type)))
 		goto out_bh_enable;
 
 	mip6_addr_swap(skb);
@@ -960,6 +1038,12 @@ static int __net_init icmpv6_sk_init(struct net *net)
 	if (!net->ipv6.icmp_sk)
 		return -ENOMEM;
 
+	net->ipv6.icmpv6_err_rl = alloc_percpu(struct icmpv6_err_ratelimit);
+	if (!net->ipv6.icmpv6_err_rl) {
+		kfree(net->ipv6.icmp_sk);
+		return -ENOMEM;
+	}
+
 	for_each_possible_cpu(i) {
 		err = inet_ctl_sock_create(&sk, PF_INET6,
 					   SOCK_RAW, IPPROTO_ICMPV6, net);
@@ -981,6 +1065,7 @@ static int __net_init icmpv6_sk_init(struct net *net)
  fail:
 	for (j = 0; j < i; j++)
 		inet_ctl_sock_destroy(net->ipv6.icmp_sk[j]);
+	free_percpu(net->ipv6.icmpv6_err_rl);
 	kfree(net->ipv6.icmp_sk);
 	return err;
 }
@@ -992,6 +1077,7 @@ static void __net_exit icmpv6_sk_exit(struct net *net)
 	for_each_possible_cpu(i) {
 		inet_ctl_sock_destroy(net->ipv6.icmp_sk[i]);
 	}
+	free_percpu(net->ipv6.icmpv6_err_rl);
 	kfree(net->ipv6.icmp_sk);
 }
 
@@ -1101,6 +1187,9 @@ int icmpv6_err_convert(u8 type, u8 code, int *err)
 EXPORT_SYMBOL(icmpv6_err_convert);
 
 #ifdef CONFIG_SYSCTL
+static int zero;
+static int one = 1;
+
 static struct ctl_table ipv6_icmp_table_template[] = {
 	{
 		.procname	= "ratelimit",
@@ -1109,6 +1198,30 @@ static struct ctl_table ipv6_icmp_table_template[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec_ms_jiffies,
 	},
+	{
+		.procname	= "errors_per_cpu_rate",
+		.data		= &init_net.ipv6.sysctl.icmpv6_errors_per_cpu_rate,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "errors_per_cpu_burst",
+		.data		= &init_net.ipv6.sysctl.icmpv6_errors_per_cpu_burst,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+	},
+	{
+		.procname	= "errors_per_cpu_type_rate",
+		.data		= &init_net.ipv6.sysctl.icmpv6_errors_per_cpu_type_rate,
+		.maxlen		= sizeof(init_net.ipv6.sysctl.icmpv6_errors_per_cpu_type_rate),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 	{ },
 };
 
@@ -1120,8 +1233,12 @@ struct ctl_table * __net_init ipv6_icmp_sysctl_init(struct net *net)
 			sizeof(ipv6_icmp_table_template),
 			GFP_KERNEL);
 
-	if (table)
+	if (table) {
 		table[0].data = &net->ipv6.sysctl.icmpv6_time;
+		table[1].data = &net->ipv6.sysctl.icmpv6_errors_per_cpu_rate;
+		table[2].data = &net->ipv6.sysctl.icmpv6_errors_per_cpu_burst;
+		table[3].data = &net->ipv6.sysctl.icmpv6_errors_per_cpu_type_rate;
+	}
 
 	return table;
 }
@@ -34,6 +34,7 @@
 #include <net/addrconf.h>
 #include <net/lwtunnel.h>
 #include <net/fib_notifier.h>
+#include <net/seg6.h>
 
 #include <net/ip6_fib.h>
 #include <net/ip6_route.h>
@@ -71,6 +72,7 @@ static int fib6_walk_continue(struct fib6_walker *w);
  */
 
 static void fib6_gc_timer_cb(struct timer_list *t);
+static void fib6_start_gc(struct net *net, struct fib6_info *rt);
 
 #define FOR_WALKERS(net, w) \
 	list_for_each_entry(w, &(net)->ipv6.fib6_walkers, lh)
@@ -160,6 +162,7 @@ struct fib6_info *fib6_info_alloc(gfp_t gfp_flags)
 	}
 
 	INIT_LIST_HEAD(&f6i->fib6_siblings);
+	INIT_LIST_HEAD(&f6i->fib6_gc_link);
 	f6i->fib6_metrics = (struct dst_metrics *)&dst_default_metrics;
 
 	atomic_inc(&f6i->fib6_ref);
@@ -275,6 +278,7 @@ static struct fib6_table *fib6_alloc_table(struct net *net, u32 id)
 				   net->ipv6.fib6_null_entry);
 		table->tb6_root.fn_flags = RTN_ROOT | RTN_TL_ROOT | RTN_RTINFO;
 		inet_peer_base_init(&table->tb6_peers);
+		INIT_LIST_HEAD(&table->tb6_gc_list);
 	}
 
 	return table;
@@ -392,6 +396,11 @@ static int call_fib6_entry_notifier(struct notifier_block *nb, struct net *net,
 	struct fib6_entry_notifier_info info = {
 		.rt = rt,
 	};
+	struct seg6_offload_info seg6;
+
+	if (seg6_offload_fill(rt->fib6_nh.nh_lwtstate, rt->fib6_nh.nh_dev,
+			      &seg6))
+		info.seg6 = &seg6;
 
 	return call_fib6_notifier(nb, net, event_type, &info.info);
 }
@@ -399,12 +408,19 @@ static int call_fib6_entry_notifier(struct notifier_block *nb, struct net *net,
 static int call_fib6_entry_notifiers(struct net *net,
 				     enum fib_event_type event_type,
 				     struct fib6_info *rt,
+				     struct fib6_info *old_rt,
 				     struct netlink_ext_ack *extack)
 {
 	struct fib6_entry_notifier_info info = {
 		.info.extack = extack,
 		.rt = rt,
+		.old_rt = old_rt,
 	};
+	struct seg6_offload_info seg6;
+
+	if (seg6_offload_fill(rt->fib6_nh.nh_lwtstate, rt->fib6_nh.nh_dev,
+			      &seg6))
+		info.seg6 = &seg6;
 
 	rt->fib6_table->fib_seq++;
 	return call_fib6_notifiers(net, event_type, &info.info);
@@ -897,6 +913,11 @@ static void fib6_purge_rt(struct fib6_info *rt, struct fib6_node *fn,
 {
 	struct fib6_table *table = rt->fib6_table;
 
+	if (!list_empty(&rt->fib6_gc_link)) {
+		list_del_init(&rt->fib6_gc_link);
+		table->tb6_gc_nr--;
+	}
+
 	if (atomic_read(&rt->fib6_ref) != 1) {
 		/* This route is used as dummy address holder in some split
 		 * nodes. It is not leaked, but it still holds other resources,
@@ -982,10 +1003,12 @@ static int fib6_add_rt2node(struct fib6_node *fn, struct fib6_info *rt,
 					rt->fib6_nsiblings = 0;
 				if (!(iter->fib6_flags & RTF_EXPIRES))
 					return -EEXIST;
-				if (!(rt->fib6_flags & RTF_EXPIRES))
+				if (!(rt->fib6_flags & RTF_EXPIRES)) {
 					fib6_clean_expires(iter);
-				else
+				} else {
 					fib6_set_expires(iter, rt->expires);
+					fib6_start_gc(info->nl_net, iter);
+				}
 				fib6_metric_set(iter, RTAX_MTU, rt->fib6_pmtu);
 				return -EEXIST;
 			}
@@ -1068,7 +1091,7 @@ static int fib6_add_rt2node(struct fib6_node *fn, struct fib6_info *rt,
 
 		err = call_fib6_entry_notifiers(info->nl_net,
 						FIB_EVENT_ENTRY_ADD,
-						rt, extack);
+						rt, NULL, extack);
 		if (err)
 			return err;
 
@@ -1097,7 +1120,7 @@ static int fib6_add_rt2node(struct fib6_node *fn, struct fib6_info *rt,
 
 		err = call_fib6_entry_notifiers(info->nl_net,
 						FIB_EVENT_ENTRY_REPLACE,
-						rt, extack);
+						rt, iter, extack);
 		if (err)
 			return err;
 
@@ -1148,14 +1171,46 @@ static int fib6_add_rt2node(struct fib6_node *fn, struct fib6_info *rt,
 	return 0;
 }
 
+/* Link a route that expires or holds exceptions on the GC list of its
+ * table, so that GC does not have to walk the whole tree to find it.
+ * Routes leave the list in fib6_purge_rt(), or when GC finds they no
+ * longer need it. Need to own table->tb6_lock.
+ */
+void fib6_gc_link(struct fib6_info *rt)
+{
+	struct fib6_table *table = rt->fib6_table;
+
+	if (!list_empty(&rt->fib6_gc_link) ||
+	    !rcu_access_pointer(rt->fib6_node))
+		return;
+
+	list_add_tail(&rt->fib6_gc_link, &table->tb6_gc_list);
+	table->tb6_gc_nr++;
+}
+
 static void fib6_start_gc(struct net *net, struct fib6_info *rt)
 {
-	if (!timer_pending(&net->ipv6.ip6_fib_timer) &&
-	    (rt->fib6_flags & RTF_EXPIRES))
+	if (!(rt->fib6_flags & RTF_EXPIRES))
+		return;
+
+	fib6_gc_link(rt);
+	if (!timer_pending(&net->ipv6.ip6_fib_timer))
 		mod_timer(&net->ipv6.ip6_fib_timer,
 			  jiffies + net->ipv6.sysctl.ip6_rt_gc_interval);
 }
 
+/* set the expiry of a route that may already be in its table */
+void fib6_update_expires(struct net *net, struct fib6_info *f6i,
+			 unsigned long expires)
+{
+	struct fib6_table *table = f6i->fib6_table;
+
+	spin_lock_bh(&table->tb6_lock);
+	fib6_set_expires(f6i, expires);
+	fib6_start_gc(net, f6i);
+	spin_unlock_bh(&table->tb6_lock);
+}
+
 void fib6_force_start_gc(struct net *net)
 {
 	if (!timer_pending(&net->ipv6.ip6_fib_timer))
@@ -1772,7 +1827,7 @@ static void fib6_del_route(struct fib6_table *table, struct fib6_node *fn,
 
 	fib6_purge_rt(rt, fn, net);
 
-	call_fib6_entry_notifiers(net, FIB_EVENT_ENTRY_DEL, rt, NULL);
+	call_fib6_entry_notifiers(net, FIB_EVENT_ENTRY_DEL, rt, NULL, NULL);
 	if (!info->skip_notify)
 		inet6_rt_notify(RTM_DELROUTE, rt, info, 0);
 	fib6_info_release(rt);
@@ -2078,10 +2133,86 @@ static int fib6_age(struct fib6_info *rt, void *arg)
 	return 0;
 }
 
+/* Age the routes on the GC list of a table, rotating the ones that still
+ * need GC to the tail, until tb6_gc_todo or the budget runs out.
+ */
+static void fib6_gc_table(struct net *net, struct fib6_table *table,
+			  struct fib6_gc_args *gc_args)
+{
+	struct nl_info info = {
+		.nl_net = net,
+	};
+	struct fib6_info *rt;
+	int more;
+
+	while (table->tb6_gc_todo && gc_args->budget) {
+		if (list_empty(&table->tb6_gc_list)) {
+			table->tb6_gc_todo = 0;
+			break;
+		}
+
+		rt = list_first_entry(&table->tb6_gc_list, struct fib6_info,
+				      fib6_gc_link);
+		table->tb6_gc_todo--;
+		gc_args->budget--;
+
+		more = gc_args->more;
+		if (fib6_age(rt, gc_args) == -1) {
+			if (!fib6_del(rt, &info))
+				continue;
+			gc_args->more++;
+		}
+
+		if (gc_args->more != more) {
+			list_move_tail(&rt->fib6_gc_link, &table->tb6_gc_list);
+		} else {
+			list_del_init(&rt->fib6_gc_link);
+			table->tb6_gc_nr--;
+		}
+	}
+}
+
+/* Run GC on the tables of net, within the budget of gc_args. A new pass
+ * covers the routes on the GC lists at the time it starts.
+ */
+static void fib6_gc_all(struct net *net, struct fib6_gc_args *gc_args,
+			bool new_pass)
+{
+	struct fib6_table *table;
+	struct hlist_head *head;
+	unsigned int h;
+
+	rcu_read_lock();
+	for (h = 0; h < FIB6_TABLE_HASHSZ; h++) {
+		head = &net->ipv6.fib_table_hash[h];
+		hlist_for_each_entry_rcu(table, head, tb6_hlist) {
+			spin_lock_bh(&table->tb6_lock);
+			if (new_pass)
+				table->tb6_gc_todo = table->tb6_gc_nr;
+			fib6_gc_table(net, table, gc_args);
+			spin_unlock_bh(&table->tb6_lock);
+		}
+	}
+	rcu_read_unlock();
+}
+
+static void fib6_gc_rearm(struct net *net, int more)
+{
+	unsigned long now = jiffies;
+
+	net->ipv6.ip6_rt_last_gc = now;
+
+	if (more)
+		mod_timer(&net->ipv6.ip6_fib_timer,
+			  round_jiffies(now
+					+ net->ipv6.sysctl.ip6_rt_gc_interval));
+	else
+		del_timer(&net->ipv6.ip6_fib_timer);
+}
+
 void fib6_run_gc(unsigned long expires, struct net *net, bool force)
 {
 	struct fib6_gc_args gc_args;
-	unsigned long now;
 
 	if (force) {
 		spin_lock_bh(&net->ipv6.fib6_gc_lock);
@@ -2092,25 +2223,47 @@ void fib6_run_gc(unsigned long expires, struct net *net, bool force)
 	gc_args.timeout = expires ? (int)expires :
 			  net->ipv6.sysctl.ip6_rt_gc_interval;
 	gc_args.more = 0;
+	gc_args.budget = UINT_MAX;
 
-	fib6_clean_all(net, fib6_age, &gc_args);
-	now = jiffies;
-	net->ipv6.ip6_rt_last_gc = now;
+	/* a full pass supersedes the one the timer may be slicing */
+	fib6_gc_all(net, &gc_args, true);
+	net->ipv6.fib6_gc_resume = false;
 
-	if (gc_args.more)
-		mod_timer(&net->ipv6.ip6_fib_timer,
-			  round_jiffies(now
-					+ net->ipv6.sysctl.ip6_rt_gc_interval));
-	else
-		del_timer(&net->ipv6.ip6_fib_timer);
+	fib6_gc_rearm(net, gc_args.more);
 	spin_unlock_bh(&net->ipv6.fib6_gc_lock);
 }
 
+/* The periodic GC pass is cut in slices of FIB6_GC_BUDGET routes, one per
+ * tick, so that large tables do not hold tb6_lock for long.
+ */
+#define FIB6_GC_BUDGET	256
+
 static void fib6_gc_timer_cb(struct timer_list *t)
 {
-	struct net *arg = from_timer(arg, t, ipv6.ip6_fib_timer);
+	struct net *net = from_timer(net, t, ipv6.ip6_fib_timer);
+	struct fib6_gc_args gc_args;
+	bool new_pass;
+
+	spin_lock_bh(&net->ipv6.fib6_gc_lock);
+	gc_args.timeout = net->ipv6.sysctl.ip6_rt_gc_interval;
+	gc_args.more = 0;
+	gc_args.budget = FIB6_GC_BUDGET;
 
-	fib6_run_gc(0, arg, true);
+	new_pass = !net->ipv6.fib6_gc_resume;
+	if (new_pass)
+		net->ipv6.fib6_gc_more = 0;
+
+	fib6_gc_all(net, &gc_args, new_pass);
+	net->ipv6.fib6_gc_more += gc_args.more;
+
+	if (!gc_args.budget) {
+		net->ipv6.fib6_gc_resume = true;
+		mod_timer(&net->ipv6.ip6_fib_timer, jiffies + 1);
+	} else {
+		net->ipv6.fib6_gc_resume = false;
+		fib6_gc_rearm(net, net->ipv6.fib6_gc_more);
+	}
+	spin_unlock_bh(&net->ipv6.fib6_gc_lock);
 }
 
 static int __net_init fib6_net_init(struct net *net)
@@ -2149,6 +2302,7 @@ static int __net_init fib6_net_init(struct net *net)
 	net->ipv6.fib6_main_tbl->tb6_root.fn_flags =
 		RTN_ROOT | RTN_TL_ROOT | RTN_RTINFO;
 	inet_peer_base_init(&net->ipv6.fib6_main_tbl->tb6_peers);
+	INIT_LIST_HEAD(&net->ipv6.fib6_main_tbl->tb6_gc_list);
 
 #ifdef CONFIG_IPV6_MULTIPLE_TABLES
 	net->ipv6.fib6_local_tbl = kzalloc(sizeof(*net->ipv6.fib6_local_tbl),
@@ -2161,6 +2315,7 @@ static int __net_init fib6_net_init(struct net *net)
 	net->ipv6.fib6_local_tbl->tb6_root.fn_flags =
 		RTN_ROOT | RTN_TL_ROOT | RTN_RTINFO;
 	inet_peer_base_init(&net->ipv6.fib6_local_tbl->tb6_peers);
+	INIT_LIST_HEAD(&net->ipv6.fib6_local_tbl->tb6_gc_list);
 #endif
 	fib6_tables_init(net);
 
@@ -45,6 +45,7 @@
 #include <linux/nsproxy.h>
 #include <linux/slab.h>
 #include <linux/jhash.h>
+#include <linux/seg6.h>
 #include <net/net_namespace.h>
 #include <net/snmp.h>
 #include <net/ipv6.h>
@@ -847,7 +848,7 @@ int rt6_route_rcv(struct net_device *dev, u8 *opt, int len,
 		if (!addrconf_finite_timeout(lifetime))
 			fib6_clean_expires(rt);
 		else
-			fib6_set_expires(rt, jiffies + HZ * lifetime);
+			fib6_update_expires(net, rt, jiffies + HZ * lifetime);
 
 		fib6_info_release(rt);
 	}
@@ -1472,6 +1473,7 @@ static int rt6_insert_exception(struct rt6_info *nrt,
 	if (!err) {
 		spin_lock_bh(&ort->fib6_table->tb6_lock);
 		fib6_update_sernum(net, ort);
+		fib6_gc_link(ort);
 		spin_unlock_bh(&ort->fib6_table->tb6_lock);
 		fib6_force_start_gc(net);
 	}
@@ -1980,6 +1982,45 @@ static void ip6_multipath_l3_keys(const struct sk_buff *skb,
 	}
 }
 
+/* SRv6 packets between two head-ends differ only past the SRH */
+static bool ip6_multipath_has_srh(const struct sk_buff *skb)
+{
+	const struct ipv6_sr_hdr *srh;
+	struct ipv6_sr_hdr _srh;
+
+	if (ipv6_hdr(skb)->nexthdr != NEXTHDR_ROUTING)
+		return false;
+
+	srh = skb_header_pointer(skb,
+				 skb_network_offset(skb) + sizeof(struct ipv6hdr),
+				 sizeof(_srh), &_srh);
+
+	return srh && srh->type == IPV6_SRCRT_TYPE_4;
+}
+
+/* hash the packet carried by the SRH in encap mode, or the upper-layer
+ * header that follows it in inline mode
+ */
+static void ip6_multipath_srh_keys(const struct sk_buff *skb,
+				   struct flow_keys *hash_keys)
+{
+	struct flow_keys keys;
+
+	skb_flow_dissect_flow_keys(skb, &keys, 0);
+
+	hash_keys->control.addr_type = keys.control.addr_type;
+	if (keys.control.addr_type == FLOW_DISSECTOR_KEY_IPV4_ADDRS) {
+		hash_keys->addrs.v4addrs.src = keys.addrs.v4addrs.src;
+		hash_keys->addrs.v4addrs.dst = keys.addrs.v4addrs.dst;
+	} else {
+		hash_keys->addrs.v6addrs.src = keys.addrs.v6addrs.src;
+		hash_keys->addrs.v6addrs.dst = keys.addrs.v6addrs.dst;
+	}
+	hash_keys->ports.src = keys.ports.src;
+	hash_keys->ports.dst = keys.ports.dst;
+	hash_keys->basic.ip_proto = keys.basic.ip_proto;
+}
+
 /* if skb is set it will be used and fl6 can be NULL */
 u32 rt6_multipath_hash(const struct net *net, const struct flowi6 *fl6,
 		       const struct sk_buff *skb, struct flow_keys *flkeys)
@@ -2000,6 +2041,13 @@ u32 rt6_multipath_hash(const struct net *net, const struct flowi6 *fl6,
 			hash_keys.basic.ip_proto = fl6->flowi6_proto;
 		}
 		break;
+	case 2:
+		if (skb && ip6_multipath_has_srh(skb)) {
+			memset(&hash_keys, 0, sizeof(hash_keys));
+			ip6_multipath_srh_keys(skb, &hash_keys);
+			break;
+		}
+		/* fall through */
 	case 1:
 		if (skb) {
 			unsigned int flag = FLOW_DISSECTOR_F_STOP_AT_ENCAP;
@@ -4539,6 +4587,8 @@ static int rt6_nexthop_info(struct sk_buff *skb, struct fib6_info *rt,
 	*flags |= (rt->fib6_nh.nh_flags & RTNH_F_ONLINK);
 	if (rt->fib6_nh.nh_flags & RTNH_F_OFFLOAD)
 		*flags |= RTNH_F_OFFLOAD;
+	if (rt->fib6_nh.nh_flags & RTNH_F_TRAP)
+		*flags |= RTNH_F_TRAP;
 
 	/* not needed for multipath encoding b/c it has a rtnexthop struct */
 	if (!skip_oif && rt->fib6_nh.nh_dev &&
@@ -5111,6 +5161,7 @@ static int __net_init ip6_route_net_init(struct net *net)
 					    GFP_KERNEL);
 	if (!net->ipv6.fib6_null_entry)
 		goto out_ip6_dst_entries;
+	INIT_LIST_HEAD(&net->ipv6.fib6_null_entry->fib6_gc_link);
 
 	net->ipv6.ip6_null_entry = kmemdup(&ip6_null_entry_template,
 					   sizeof(*net->ipv6.ip6_null_entry),
@@ -17,6 +17,8 @@
 #include <linux/net.h>
 #include <linux/in6.h>
 #include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/log2.h>
 
 #include <net/ipv6.h>
 #include <net/protocol.h>
@@ -68,6 +70,7 @@ bool seg6_validate_srh(struct ipv6_sr_hdr *srh, int len)
 
 	return true;
 }
+EXPORT_SYMBOL_GPL(seg6_validate_srh);
 
 static struct genl_family seg6_genl_family;
 
@@ -80,6 +83,7 @@ static const struct nla_policy seg6_genl_policy[SEG6_ATTR_MAX + 1] = {
 	[SEG6_ATTR_SECRETLEN]		= { .type = NLA_U8, },
 	[SEG6_ATTR_ALGID]			= { .type = NLA_U8, },
 	[SEG6_ATTR_HMACINFO]		= { .type = NLA_NESTED, },
+	[SEG6_ATTR_OAM_QLEN]		= { .type = NLA_U32, },
 };
 
 #ifdef CONFIG_IPV6_SEG6_HMAC
@@ -355,6 +359,278 @@ static int seg6_genl_dumphmac(struct sk_buff *skb, struct netlink_callback *cb)
 
 #endif
 
+void __seg6_oam_sample(struct sk_buff *skb, struct ipv6_sr_hdr *srh)
+{
+	struct net *net = dev_net(skb->dev);
+	struct seg6_oam_sample *sample;
+	struct seg6_oam_queue *q;
+	struct seg6_oam_ring *ring;
+	u32 head, tail;
+
+	rcu_read_lock();
+	q = rcu_dereference(seg6_pernet(net)->oam_queue);
+	if (!q)
+		goto out;
+
+	ring = this_cpu_ptr(q->rings);
+	head = ring->head;
+	tail = smp_load_acquire(&ring->tail);
+	if (head - tail >= q->qlen) {
+		ring->drops++;
+		goto out;
+	}
+
+	sample = &ring->samples[head & (q->qlen - 1)];
+	sample->rx_tstamp = ktime_to_ns(skb->tstamp ? : ktime_get_real());
+	sample->saddr = ipv6_hdr(skb)->saddr;
+	sample->daddr = ipv6_hdr(skb)->daddr;
+	sample->ifindex = skb->dev->ifindex;
+	sample->tag = ntohs(srh->tag);
+	sample->segments_left = srh->segments_left;
+	sample->first_segment = srh->first_segment;
+	sample->flags = srh->flags;
+
+	/* publish the entry to the consumer */
+	smp_store_release(&ring->head, head + 1);
+out:
+	rcu_read_unlock();
+}
+
+/* Describe the seg6 or seg6local nexthop of a route for FIB notifier
+ * listeners. Returns false for any other kind of nexthop.
+ */
+bool seg6_offload_fill(struct lwtunnel_state *lwt, struct net_device *dev,
+		       struct seg6_offload_info *info)
+{
+#ifdef CONFIG_IPV6_SEG6_LWTUNNEL
+	if (!lwt)
+		return false;
+
+	switch (lwt->type) {
+	case LWTUNNEL_ENCAP_SEG6:
+		info->type = lwt->type;
+		seg6_lwt_offload_fill(lwt, dev, &info->encap);
+		return true;
+	case LWTUNNEL_ENCAP_SEG6_LOCAL:
+		info->type = lwt->type;
+		seg6_local_offload_fill(lwt, &info->local);
+		return true;
+	}
+#endif
+	return false;
+}
+
+bool __seg6_xdp_meta_get(struct sk_buff *skb, struct sr6_xdp_meta *meta)
+{
+	struct net *net = dev_net(skb->dev);
+	struct inet6_dev *idev;
+	int trust;
+
+	memcpy(meta, skb_metadata_end(skb) - sizeof(*meta), sizeof(*meta));
+
+	/* the metadata describes the packet as XDP saw it, make sure it is
+	 * not looked at again once the SRH has been processed
+	 */
+	skb_metadata_clear(skb);
+
+	idev = __in6_dev_get(skb->dev);
+	if (!idev)
+		return false;
+
+	trust = net->ipv6.devconf_all->seg6_xdp_meta;
+	if (trust > idev->cnf.seg6_xdp_meta)
+		trust = idev->cnf.seg6_xdp_meta;
+
+	if (!trust)
+		return false;
+
+	return meta->magic == SR6_XDP_META_MAGIC &&
+	       (meta->flags & SR6_XDP_META_VALID);
+}
+
+static struct seg6_oam_queue *seg6_oam_queue_alloc(u32 qlen)
+{
+	struct seg6_oam_queue *q;
+
+	q = kzalloc(sizeof(*q), GFP_KERNEL);
+	if (!q)
+		return NULL;
+
+	q->qlen = qlen;
+	q->rings = __alloc_percpu(sizeof(struct seg6_oam_ring) +
+				  qlen * sizeof(struct seg6_oam_sample),
+				  __alignof__(struct seg6_oam_ring));
+	if (!q->rings) {
+		kfree(q);
+		return NULL;
+	}
+
+	return q;
+}
+
+static void seg6_oam_queue_free(struct seg6_oam_queue *q)
+{
+	if (!q)
+		return;
+
+	free_percpu(q->rings);
+	kfree(q);
+}
+
+static int seg6_genl_set_oam(struct sk_buff *skb, struct genl_info *info)
+{
+	struct net *net = genl_info_net(info);
+	struct seg6_oam_queue *q_old, *q_new = NULL;
+	struct seg6_pernet_data *sdata;
+	u32 qlen;
+
+	sdata = seg6_pernet(net);
+
+	if (!info->attrs[SEG6_ATTR_OAM_QLEN])
+		return -EINVAL;
+
+	qlen = nla_get_u32(info->attrs[SEG6_ATTR_OAM_QLEN]);
+	if (qlen > SEG6_OAM_QLEN_MAX)
+		return -EINVAL;
+
+	if (qlen) {
+		q_new = seg6_oam_queue_alloc(roundup_pow_of_two(qlen));
+		if (!q_new)
+			return -ENOMEM;
+	}
+
+	mutex_lock(&sdata->lock);
+
+	q_old = rcu_dereference_protected(sdata->oam_queue,
+					  lockdep_is_held(&sdata->lock));
+	rcu_assign_pointer(sdata->oam_queue, q_new);
+
+	mutex_unlock(&sdata->lock);
+
+	synchronize_net();
+	seg6_oam_queue_free(q_old);
+
+	return 0;
+}
+
+static int seg6_genl_get_oam(struct sk_buff *skb, struct genl_info *info)
+{
+	struct net *net = genl_info_net(info);
+	struct seg6_oam_queue *q;
+	struct sk_buff *msg;
+	u64 drops = 0;
+	u32 qlen = 0;
+	void *hdr;
+	int cpu;
+
+	msg = genlmsg_new(NLMSG_DEFAULT_SIZE, GFP_KERNEL);
+	if (!msg)
+		return -ENOMEM;
+
+	hdr = genlmsg_put(msg, info->snd_portid, info->snd_seq,
+			  &seg6_genl_family, 0, SEG6_CMD_GET_OAM);
+	if (!hdr)
+		goto free_msg;
+
+	rcu_read_lock();
+	q = rcu_dereference(seg6_pernet(net)->oam_queue);
+	if (q) {
+		qlen = q->qlen;
+		for_each_possible_cpu(cpu)
+			drops += READ_ONCE(per_cpu_ptr(q->rings, cpu)->drops);
+	}
+	rcu_read_unlock();
+
+	if (nla_put_u32(msg, SEG6_ATTR_OAM_QLEN, qlen) ||
+	    nla_put_u64_64bit(msg, SEG6_ATTR_OAM_DROPS, drops,
+			      SEG6_ATTR_UNSPEC))
+		goto nla_put_failure;
+
+	genlmsg_end(msg, hdr);
+	genlmsg_reply(msg, info);
+
+	return 0;
+
+nla_put_failure:
+	genlmsg_cancel(msg, hdr);
+free_msg:
+	nlmsg_free(msg);
+	return -ENOMEM;
+}
+
+static int __seg6_genl_dumpoam_element(struct seg6_oam_sample *sample,
+				       u32 portid, u32 seq, u32 flags,
+				       struct sk_buff *skb)
+{
+	void *hdr;
+
+	hdr = genlmsg_put(skb, portid, seq, &seg6_genl_family, flags,
+			  SEG6_CMD_DUMP_OAM);
+	if (!hdr)
+		return -ENOMEM;
+
+	if (nla_put(skb, SEG6_ATTR_OAM_SAMPLE, sizeof(*sample), sample))
+		goto nla_put_failure;
+
+	genlmsg_end(skb, hdr);
+	return 0;
+
+nla_put_failure:
+	genlmsg_cancel(skb, hdr);
+	return -EMSGSIZE;
+}
+
+/* Drain the per-CPU sample rings. cb->args[0] holds the next CPU to visit
+ * when the dump does not fit in a single message.
+ */
+static int seg6_genl_dumpoam(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct net *net = sock_net(cb->skb->sk);
+	struct seg6_pernet_data *sdata;
+	struct seg6_oam_queue *q;
+	int cpu = cb->args[0];
+
+	sdata = seg6_pernet(net);
+
+	mutex_lock(&sdata->lock);
+
+	q = rcu_dereference_protected(sdata->oam_queue,
+				      lockdep_is_held(&sdata->lock));
+	if (!q)
+		goto out;
+
+	for (; cpu < nr_cpu_ids; cpu++) {
+		struct seg6_oam_ring *ring;
+		u32 head, tail;
+
+		if (!cpu_possible(cpu))
+			continue;
+
+		ring = per_cpu_ptr(q->rings, cpu);
+		tail = ring->tail;
+		head = smp_load_acquire(&ring->head);
+
+		for (; tail != head; tail++) {
+			if (__seg6_genl_dumpoam_element(&ring->samples[tail & (q->qlen - 1)],
+							NETLINK_CB(cb->skb).portid,
+							cb->nlh->nlmsg_seq,
+							NLM_F_MULTI, skb))
+				break;
+		}
+
+		/* hand the consumed slots back to the producer */
+		smp_store_release(&ring->tail, tail);
+		if (tail != head)
+			break;
+	}
+
+out:
+	mutex_unlock(&sdata->lock);
+	cb->args[0] = cpu;
+
+	return skb->len;
+}
+
 static int __net_init seg6_net_init(struct net *net)
 {
 	struct seg6_pernet_data *sdata;
@@ -388,6 +664,7 @@ static void __net_exit seg6_net_exit(struct net *net)
 	seg6_hmac_net_exit(net);
 #endif
 
+	seg6_oam_queue_free(rcu_dereference_protected(sdata->oam_queue, 1));
 	kfree(sdata->tun_src);
 	kfree(sdata);
 }
@@ -424,6 +701,24 @@ static const struct genl_ops seg6_genl_ops[] = {
 		.policy = seg6_genl_policy,
 		.flags	= GENL_ADMIN_PERM,
 	},
+	{
+		.cmd	= SEG6_CMD_SET_OAM,
+		.doit	= seg6_genl_set_oam,
+		.policy	= seg6_genl_policy,
+		.flags	= GENL_ADMIN_PERM,
+	},
+	{
+		.cmd	= SEG6_CMD_GET_OAM,
+		.doit	= seg6_genl_get_oam,
+		.policy	= seg6_genl_policy,
+		.flags	= GENL_ADMIN_PERM,
+	},
+	{
+		.cmd	= SEG6_CMD_DUMP_OAM,
+		.dumpit	= seg6_genl_dumpoam,
+		.policy	= seg6_genl_policy,
+		.flags	= GENL_ADMIN_PERM,
+	},
 };
 
 static struct genl_family seg6_genl_family __ro_after_init = {
@@ -28,12 +28,44 @@
 #include <net/addrconf.h>
 #include <net/ip6_route.h>
 #include <net/dst_cache.h>
+#include <net/dsfield.h>
+#include <net/icmp.h>
+#include <net/tcp.h>
+#include <linux/icmpv6.h>
 #ifdef CONFIG_IPV6_SEG6_HMAC
 #include <net/seg6_hmac.h>
 #endif
 
+struct seg6_lwt_class {
+	u32 value;
+	struct ipv6_sr_hdr *srh;
+	struct dst_cache cache;
+};
+
+/* Per traffic class SRHs, used instead of the default one when the packet
+ * matches. DSCP keys are resolved through dscp_map (class index + 1, 0
+ * meaning no match), marks through a linear scan of the few entries.
+ */
+struct seg6_lwt_classes {
+	u32 key;
+	int nr;
+	u8 dscp_map[64];
+	struct seg6_lwt_class entries[0];
+};
+
+/* pmtu is the largest packet the policy carries without the outer packet
+ * exceeding the MTU of its path, i.e. the configured MTU or the MTU of
+ * the route to the first segment, whichever is lower, less the headroom.
+ * It is 0 until the outer route is first resolved, and follows the MTU
+ * of the cached route on every packet since a link MTU change does not
+ * invalidate that route.
+ */
 struct seg6_lwt {
 	struct dst_cache cache;
+	struct seg6_lwt_classes *classes;
+	u32 mtu;
+	u32 pmtu;
+	bool mss_clamp;
 	struct seg6_iptunnel_encap tuninfo[0];
 };
 
@@ -50,6 +82,16 @@ seg6_encap_lwtunnel(struct lwtunnel_state *lwt)
 
 static const struct nla_policy seg6_iptunnel_policy[SEG6_IPTUNNEL_MAX + 1] = {
 	[SEG6_IPTUNNEL_SRH]	= { .type = NLA_BINARY },
+	[SEG6_IPTUNNEL_CLASS_KEY]	= { .type = NLA_U32 },
+	[SEG6_IPTUNNEL_CLASSES]	= { .type = NLA_NESTED },
+	[SEG6_IPTUNNEL_MTU]	= { .type = NLA_U32 },
+	[SEG6_IPTUNNEL_MSS_CLAMP]	= { .type = NLA_FLAG },
+};
+
+static const struct nla_policy
+seg6_iptunnel_class_policy[SEG6_IPTUNNEL_CLASS_MAX + 1] = {
+	[SEG6_IPTUNNEL_CLASS_VALUE]	= { .type = NLA_U32 },
+	[SEG6_IPTUNNEL_CLASS_SRH]	= { .type = NLA_BINARY },
 };
 
 static int nla_put_srh(struct sk_buff *skb, int attrtype,
@@ -224,20 +266,69 @@ int seg6_do_srh_inline(struct sk_buff *skb, struct ipv6_sr_hdr *osrh)
 }
 EXPORT_SYMBOL_GPL(seg6_do_srh_inline);
 
-static int seg6_do_srh(struct sk_buff *skb)
+/* pick the traffic class entry of this packet, NULL for the default SRH */
+static struct seg6_lwt_class *seg6_select_class(struct seg6_lwt *slwt,
+						struct sk_buff *skb)
+{
+	struct seg6_lwt_classes *classes = slwt->classes;
+	int i;
+	u8 dscp;
+
+	if (!classes)
+		return NULL;
+
+	switch (classes->key) {
+	case SEG6_IPTUN_CLASS_MARK:
+		for (i = 0; i < classes->nr; i++) {
+			if (classes->entries[i].value == skb->mark)
+				return &classes->entries[i];
+		}
+		break;
+	case SEG6_IPTUN_CLASS_DSCP:
+		if (skb->protocol == htons(ETH_P_IPV6))
+			dscp = ipv6_get_dsfield(ipv6_hdr(skb)) >> 2;
+		else if (skb->protocol == htons(ETH_P_IP))
+			dscp = ipv4_get_dsfield(ip_hdr(skb)) >> 2;
+		else
+			break;
+
+		i = classes->dscp_map[dscp];
+		if (i)
+			return &classes->entries[i - 1];
+		break;
+	}
+
+	return NULL;
+}
+
+static int seg6_do_srh(struct sk_buff *skb, struct dst_cache **cache)
 {
 	struct dst_entry *dst = skb_dst(skb);
 	struct seg6_iptunnel_encap *tinfo;
+	struct seg6_lwt_class *class;
+	struct ipv6_sr_hdr *srh;
+	struct seg6_lwt *slwt;
 	int proto, err = 0;
 
-	tinfo = seg6_encap_lwtunnel(dst->lwtstate);
+	slwt = seg6_lwt_lwtunnel(dst->lwtstate);
+	tinfo = slwt->tuninfo;
+
+	/* each class has its own first segment, hence its own dst cache */
+	class = seg6_select_class(slwt, skb);
+	if (class) {
+		srh = class->srh;
+		*cache = &class->cache;
+	} else {
+		srh = tinfo->srh;
+		*cache = &slwt->cache;
+	}
 
 	switch (tinfo->mode) {
 	case SEG6_IPTUN_MODE_INLINE:
 		if (skb->protocol != htons(ETH_P_IPV6))
 			return -EINVAL;
 
-		err = seg6_do_srh_inline(skb, tinfo->srh);
+		err = seg6_do_srh_inline(skb, srh);
 		if (err)
 			return err;
 		break;
@@ -253,7 +344,7 @@ static int seg6_do_srh(struct sk_buff *skb)
 		else
 			return -EINVAL;
 
-		err = seg6_do_srh_encap(skb, tinfo->srh, proto);
+		err = seg6_do_srh_encap(skb, srh, proto);
 		if (err)
 			return err;
 
@@ -271,7 +362,7 @@ static int seg6_do_srh(struct sk_buff *skb)
 		skb_mac_header_rebuild(skb);
 		skb_push(skb, skb->mac_len);
 
-		err = seg6_do_srh_encap(skb, tinfo->srh, NEXTHDR_NONE);
+		err = seg6_do_srh_encap(skb, srh, NEXTHDR_NONE);
 		if (err)
 			return err;
 
@@ -285,23 +376,178 @@ static int seg6_do_srh(struct sk_buff *skb)
 	return 0;
 }
 
+static void seg6_update_pmtu(struct lwtunnel_state *lwt,
+			     struct dst_entry *odst)
+{
+	struct seg6_lwt *slwt = seg6_lwt_lwtunnel(lwt);
+	unsigned int mtu = dst_mtu(odst);
+
+	if (slwt->mtu)
+		mtu = min(mtu, slwt->mtu);
+
+	mtu = mtu > lwt->headroom ? mtu - lwt->headroom : 0;
+	if (READ_ONCE(slwt->pmtu) != mtu)
+		WRITE_ONCE(slwt->pmtu, mtu);
+}
+
+static bool seg6_pkt_too_big(const struct sk_buff *skb, unsigned int mtu)
+{
+	if (skb->len <= mtu || skb->ignore_df)
+		return false;
+
+	if (skb_is_gso(skb) && skb_gso_validate_network_len(skb, mtu))
+		return false;
+
+	if (skb->protocol == htons(ETH_P_IP) &&
+	    !(ip_hdr(skb)->frag_off & htons(IP_DF)))
+		return false;
+
+	return true;
+}
+
+static void seg6_send_ptb(struct sk_buff *skb, unsigned int mtu)
+{
+	if (skb->protocol == htons(ETH_P_IPV6))
+		icmpv6_send(skb, ICMPV6_PKT_TOOBIG, 0, mtu);
+	else
+		icmp_send(skb, ICMP_DEST_UNREACH, ICMP_FRAG_NEEDED, htonl(mtu));
+}
+
+static unsigned int seg6_tcp_optlen(const u8 *opt, unsigned int offset)
+{
+	/* beware zero-length options: make finite progress */
+	if (opt[offset] <= TCPOPT_NOP || opt[offset + 1] == 0)
+		return 1;
+
+	return opt[offset + 1];
+}
+
+/* lower the MSS option of a TCP SYN so that its segments fit in mtu */
+static int seg6_clamp_mss(struct sk_buff *skb, unsigned int mtu)
+{
+	unsigned int thoff, hdrlen, i;
+	u16 newmss, oldmss;
+	struct tcphdr *th;
+	__be16 frag_off;
+	u8 nexthdr;
+	int offset;
+	u8 *opt;
+
+	if (skb->protocol == htons(ETH_P_IPV6)) {
+		nexthdr = ipv6_hdr(skb)->nexthdr;
+		offset = ipv6_skip_exthdr(skb, skb_network_offset(skb) +
+					  sizeof(struct ipv6hdr),
+					  &nexthdr, &frag_off);
+		if (offset < 0 || nexthdr != IPPROTO_TCP || frag_off)
+			return 0;
+
+		thoff = offset;
+		hdrlen = sizeof(struct ipv6hdr);
+	} else {
+		if (ip_hdr(skb)->protocol != IPPROTO_TCP ||
+		    ip_is_fragment(ip_hdr(skb)))
+			return 0;
+
+		thoff = skb_network_offset(skb) + ip_hdrlen(skb);
+		hdrlen = sizeof(struct iphdr);
+	}
+
+	if (mtu <= hdrlen + sizeof(struct tcphdr))
+		return 0;
+	newmss = min_t(unsigned int, mtu - hdrlen - sizeof(struct tcphdr),
+		       0xFFFF);
+
+	if (!pskb_may_pull(skb, thoff + sizeof(*th)))
+		return 0;
+
+	th = (struct tcphdr *)(skb->data + thoff);
+	if (!th->syn || th->doff * 4 < sizeof(*th))
+		return 0;
+
+	hdrlen = th->doff * 4;
+	if (skb_ensure_writable(skb, thoff + hdrlen))
+		return -ENOMEM;
+
+	th = (struct tcphdr *)(skb->data + thoff);
+	opt = (u8 *)th;
+
+	for (i = sizeof(*th); i + TCPOLEN_MSS <= hdrlen;
+	     i += seg6_tcp_optlen(opt, i)) {
+		if (opt[i] != TCPOPT_MSS || opt[i + 1] != TCPOLEN_MSS)
+			continue;
+
+		oldmss = (opt[i + 2] << 8) | opt[i + 3];
+		if (oldmss <= newmss)
+			return 0;
+
+		opt[i + 2] = newmss >> 8;
+		opt[i + 3] = newmss & 0xff;
+		inet_proto_csum_replace2(&th->check, skb, htons(oldmss),
+					 htons(newmss), false);
+		return 0;
+	}
+
+	return 0;
+}
+
+/* Keep forwarded packets within the MTU of the policy, so that the outer
+ * packet is neither fragmented nor dropped by ip6_forward() with a Packet
+ * Too Big sent to ourselves. Returns false if skb must be dropped.
+ */
+static bool seg6_check_mtu(struct sk_buff *skb)
+{
+	struct lwtunnel_state *lwt = skb_dst(skb)->lwtstate;
+	struct seg6_lwt *slwt = seg6_lwt_lwtunnel(lwt);
+	unsigned int mtu = READ_ONCE(slwt->pmtu);
+
+	if (!mtu || slwt->tuninfo->mode == SEG6_IPTUN_MODE_L2ENCAP)
+		return true;
+
+	if (skb->protocol != htons(ETH_P_IPV6) &&
+	    skb->protocol != htons(ETH_P_IP))
+		return true;
+
+	if (slwt->mss_clamp && seg6_clamp_mss(skb, mtu))
+		return false;
+
+	/* IPv6 senders cannot go below the minimum MTU: as ip6_tunnel does,
+	 * never advertise less, and let packets up to it through with the
+	 * outer packet fragmented rather than blackholing them
+	 */
+	if (skb->protocol == htons(ETH_P_IPV6) && mtu < IPV6_MIN_MTU) {
+		if (skb->len > mtu && skb->len <= IPV6_MIN_MTU)
+			skb->ignore_df = 1;
+		mtu = IPV6_MIN_MTU;
+	}
+
+	if (seg6_pkt_too_big(skb, mtu)) {
+		seg6_send_ptb(skb, mtu);
+		return false;
+	}
+
+	return true;
+}
+
 static int seg6_input(struct sk_buff *skb)
 {
-	struct dst_entry *orig_dst = skb_dst(skb);
+	struct lwtunnel_state *lwt = skb_dst(skb)->lwtstate;
 	struct dst_entry *dst = NULL;
-	struct seg6_lwt *slwt;
+	struct dst_cache *cache;
 	int err;
 
-	err = seg6_do_srh(skb);
+	if (unlikely(!seg6_check_mtu(skb))) {
+		kfree_skb(skb);
+		return -EMSGSIZE;
+	}
+
+	err = seg6_do_srh(skb, &cache);
 	if (unlikely(err)) {
 		kfree_skb(skb);
 		return err;
 	}
 
-	slwt = seg6_lwt_lwtunnel(orig_dst->lwtstate);
-
 	preempt_disable();
-	dst = dst_cache_get(&slwt->cache);
+	dst = dst_cache_get(cache);
 	preempt_enable();
 
 	skb_dst_drop(skb);
@@ -311,12 +557,14 @@ static int seg6_input(struct sk_buff *skb)
 		dst = skb_dst(skb);
 		if (!dst->error) {
 			preempt_disable();
-			dst_cache_set_ip6(&slwt->cache, dst,
+			dst_cache_set_ip6(cache, dst,
 					  &ipv6_hdr(skb)->saddr);
 			preempt_enable();
+			seg6_update_pmtu(lwt, dst);
 		}
 	} else {
 		skb_dst_set(skb, dst);
+		seg6_update_pmtu(lwt, dst);
 	}
 
 	err = skb_cow_head(skb, LL_RESERVED_SPACE(dst->dev));
@@ -328,19 +576,17 @@ static int seg6_input(struct sk_buff *skb)
 
 static int seg6_output(struct net *net, struct sock *sk, struct sk_buff *skb)
 {
-	struct dst_entry *orig_dst = skb_dst(skb);
+	struct lwtunnel_state *lwt = skb_dst(skb)->lwtstate;
 	struct dst_entry *dst = NULL;
-	struct seg6_lwt *slwt;
+	struct dst_cache *cache;
 	int err = -EINVAL;
 
-	err = seg6_do_srh(skb);
+	err = seg6_do_srh(skb, &cache);
 	if (unlikely(err))
 		goto drop;
 
-	slwt = seg6_lwt_lwtunnel(orig_dst->lwtstate);
-
 	preempt_disable();
-	dst = dst_cache_get(&slwt->cache);
+	dst = dst_cache_get(cache);
 	preempt_enable();
 
 	if (unlikely(!dst)) {
@@ -361,10 +607,12 @@ static int seg6_output(struct net *net, struct sock *sk, struct sk_buff *skb)
 		}
 
 		preempt_disable();
-		dst_cache_set_ip6(&slwt->cache, dst, &fl6.saddr);
+		dst_cache_set_ip6(cache, dst, &fl6.saddr);
 		preempt_enable();
 	}
 
+	seg6_update_pmtu(lwt, dst);
+
 	skb_dst_drop(skb);
 	skb_dst_set(skb, dst);
 
@@ -378,6 +626,148 @@ static int seg6_output(struct net *net, struct sock *sk, struct sk_buff *skb)
 	return err;
 }
 
+static void seg6_free_classes(struct seg6_lwt_classes *classes)
+{
+	int i;
+
+	if (!classes)
+		return;
+
+	for (i = 0; i < classes->nr; i++) {
+		dst_cache_destroy(&classes->entries[i].cache);
+		kfree(classes->entries[i].srh);
+	}
+
+	kfree(classes);
+}
+
+static int seg6_parse_class(struct seg6_lwt_classes *classes,
+			    struct nlattr *nla, struct netlink_ext_ack *extack)
+{
+	struct nlattr *tb[SEG6_IPTUNNEL_CLASS_MAX + 1];
+	struct seg6_lwt_class *class;
+	struct ipv6_sr_hdr *srh;
+	int i, len, err;
+	u32 value;
+
+	err = nla_parse_nested(tb, SEG6_IPTUNNEL_CLASS_MAX, nla,
+			       seg6_iptunnel_class_policy, extack);
+	if (err < 0)
+		return err;
+
+	if (!tb[SEG6_IPTUNNEL_CLASS_VALUE] || !tb[SEG6_IPTUNNEL_CLASS_SRH])
+		return -EINVAL;
+
+	value = nla_get_u32(tb[SEG6_IPTUNNEL_CLASS_VALUE]);
+	if (classes->key == SEG6_IPTUN_CLASS_DSCP &&
+	    value >= ARRAY_SIZE(classes->dscp_map)) {
+		NL_SET_ERR_MSG(extack, "Invalid DSCP value for SR class");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < classes->nr; i++) {
+		if (classes->entries[i].value == value) {
+			NL_SET_ERR_MSG(extack, "Duplicate SR class");
+			return -EEXIST;
+		}
+	}
+
+	srh = nla_data(tb[SEG6_IPTUNNEL_CLASS_SRH]);
+	len = nla_len(tb[SEG6_IPTUNNEL_CLASS_SRH]);
+
+	/* SRH must contain at least one segment */
+	if (len < sizeof(*srh) + sizeof(struct in6_addr))
+		return -EINVAL;
+
+	if (!seg6_validate_srh(srh, len))
+		return -EINVAL;
+
+	class = &classes->entries[classes->nr];
+
+	err = dst_cache_init(&class->cache, GFP_ATOMIC);
+	if (err)
+		return err;
+
+	class->srh = kmemdup(srh, len, GFP_KERNEL);
+	if (!class->srh) {
+		dst_cache_destroy(&class->cache);
+		return -ENOMEM;
+	}
+
+	class->value = value;
+	classes->nr++;
+
+	if (classes->key == SEG6_IPTUN_CLASS_DSCP)
+		classes->dscp_map[value] = classes->nr;
+
+	return 0;
+}
+
+static int seg6_build_classes(struct seg6_lwt *slwt, u32 key,
+			      struct nlattr *nla,
+			      struct netlink_ext_ack *extack)
+{
+	struct seg6_lwt_classes *classes;
+	struct nlattr *attr;
+	int rem, count = 0;
+	int err;
+
+	nla_for_each_nested(attr, nla, rem) {
+		if (nla_type(attr) != SEG6_IPTUNNEL_CLASS)
+			return -EINVAL;
+		count++;
+	}
+
+	if (!count || count > SEG6_IPTUN_CLASSES_MAX) {
+		NL_SET_ERR_MSG(extack, "Invalid number of SR classes");
+		return -EINVAL;
+	}
+
+	classes = kzalloc(sizeof(*classes) +
+			  count * sizeof(struct seg6_lwt_class), GFP_KERNEL);
+	if (!classes)
+		return -ENOMEM;
+
+	classes->key = key;
+
+	nla_for_each_nested(attr, nla, rem) {
+		err = seg6_parse_class(classes, attr, extack);
+		if (err) {
+			seg6_free_classes(classes);
+			return err;
+		}
+	}
+
+	slwt->classes = classes;
+
+	return 0;
+}
+
+/* the largest SRH among the default one and the classes sets the headroom,
+ * L2ENCAP classes also carry the outer IPv6 header and the L2 header
+ */
+static unsigned int seg6_classes_headroom(struct seg6_lwt *slwt)
+{
+	struct seg6_iptunnel_encap *tuninfo = slwt->tuninfo;
+	unsigned int headroom = seg6_lwt_headroom(tuninfo);
+	int srhlen, maxlen, i;
+
+	if (!slwt->classes)
+		return headroom;
+
+	srhlen = (tuninfo->srh->hdrlen + 1) << 3;
+	maxlen = srhlen;
+
+	for (i = 0; i < slwt->classes->nr; i++)
+		maxlen = max(maxlen,
+			     (slwt->classes->entries[i].srh->hdrlen + 1) << 3);
+
+	if (tuninfo->mode == SEG6_IPTUN_MODE_L2ENCAP)
+		return sizeof(struct ipv6hdr) + ETH_HLEN + maxlen;
+
+	return headroom - srhlen + maxlen;
+}
+
 static int seg6_build_state(struct nlattr *nla,
 			    unsigned int family, const void *cfg,
 			    struct lwtunnel_state **ts,
@@ -385,6 +775,7 @@ static int seg6_build_state(struct nlattr *nla,
 {
 	struct nlattr *tb[SEG6_IPTUNNEL_MAX + 1];
 	struct seg6_iptunnel_encap *tuninfo;
+	u32 class_key = SEG6_IPTUN_CLASS_NONE;
 	struct lwtunnel_state *newts;
 	int tuninfo_len, min_size;
 	struct seg6_lwt *slwt;
@@ -431,6 +822,21 @@ static int seg6_build_state(struct nlattr *nla,
 	if (!seg6_validate_srh(tuninfo->srh, tuninfo_len - sizeof(*tuninfo)))
 		return -EINVAL;
 
+	if (tb[SEG6_IPTUNNEL_CLASS_KEY])
+		class_key = nla_get_u32(tb[SEG6_IPTUNNEL_CLASS_KEY]);
+
+	switch (class_key) {
+	case SEG6_IPTUN_CLASS_NONE:
+		break;
+	case SEG6_IPTUN_CLASS_MARK:
+	case SEG6_IPTUN_CLASS_DSCP:
+		if (!tb[SEG6_IPTUNNEL_CLASSES])
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+
 	newts = lwtunnel_state_alloc(tuninfo_len + sizeof(*slwt));
 	if (!newts)
 		return -ENOMEM;
@@ -445,13 +851,37 @@ static int seg6_build_state(struct nlattr *nla,
 
 	memcpy(&slwt->tuninfo, tuninfo, tuninfo_len);
 
+	if (class_key != SEG6_IPTUN_CLASS_NONE) {
+		err = seg6_build_classes(slwt, class_key,
+					 tb[SEG6_IPTUNNEL_CLASSES], extack);
+		if (err) {
+			dst_cache_destroy(&slwt->cache);
+			kfree(newts);
+			return err;
+		}
+	}
+
 	newts->type = LWTUNNEL_ENCAP_SEG6;
 	newts->flags |= LWTUNNEL_STATE_INPUT_REDIRECT;
 
 	if (tuninfo->mode != SEG6_IPTUN_MODE_L2ENCAP)
 		newts->flags |= LWTUNNEL_STATE_OUTPUT_REDIRECT;
 
-	newts->headroom = seg6_lwt_headroom(tuninfo);
+	newts->headroom = seg6_classes_headroom(slwt);
+
+	/* the policy must carry at least IPv6 minimum sized inner packets */
+	if (tb[SEG6_IPTUNNEL_MTU]) {
+		slwt->mtu = nla_get_u32(tb[SEG6_IPTUNNEL_MTU]);
+		if (slwt->mtu <= newts->headroom + IPV6_MIN_MTU) {
+			NL_SET_ERR_MSG(extack, "SRv6 policy MTU is too small for its headers");
+			seg6_free_classes(slwt->classes);
+			dst_cache_destroy(&slwt->cache);
+			kfree(newts);
+			return -EINVAL;
+		}
+		slwt->pmtu = slwt->mtu - newts->headroom;
+	}
+	slwt->mss_clamp = nla_get_flag(tb[SEG6_IPTUNNEL_MSS_CLAMP]);
 
 	*ts = newts;
 
@@ -460,25 +890,123 @@ static int seg6_build_state(struct nlattr *nla,
 
 static void seg6_destroy_state(struct lwtunnel_state *lwt)
 {
-	dst_cache_destroy(&seg6_lwt_lwtunnel(lwt)->cache);
+	struct seg6_lwt *slwt = seg6_lwt_lwtunnel(lwt);
+
+	seg6_free_classes(slwt->classes);
+	dst_cache_destroy(&slwt->cache);
+}
+
+static int seg6_fill_classes(struct sk_buff *skb,
+			     struct seg6_lwt_classes *classes)
+{
+	struct nlattr *list, *entry;
+	int i, len;
+
+	if (nla_put_u32(skb, SEG6_IPTUNNEL_CLASS_KEY, classes->key))
+		return -EMSGSIZE;
+
+	list = nla_nest_start(skb, SEG6_IPTUNNEL_CLASSES);
+	if (!list)
+		return -EMSGSIZE;
+
+	for (i = 0; i < classes->nr; i++) {
+		struct seg6_lwt_class *class = &classes->entries[i];
+
+		entry = nla_nest_start(skb, SEG6_IPTUNNEL_CLASS);
+		if (!entry)
+			return -EMSGSIZE;
+
+		len = (class->srh->hdrlen + 1) << 3;
+		if (nla_put_u32(skb, SEG6_IPTUNNEL_CLASS_VALUE, class->value) ||
+		    nla_put(skb, SEG6_IPTUNNEL_CLASS_SRH, len, class->srh))
+			return -EMSGSIZE;
+
+		nla_nest_end(skb, entry);
+	}
+
+	nla_nest_end(skb, list);
+
+	return 0;
 }
 
 static int seg6_fill_encap_info(struct sk_buff *skb,
 				struct lwtunnel_state *lwtstate)
 {
 	struct seg6_iptunnel_encap *tuninfo = seg6_encap_lwtunnel(lwtstate);
+	struct seg6_lwt *slwt = seg6_lwt_lwtunnel(lwtstate);
 
 	if (nla_put_srh(skb, SEG6_IPTUNNEL_SRH, tuninfo))
 		return -EMSGSIZE;
 
+	if (slwt->classes && seg6_fill_classes(skb, slwt->classes))
+		return -EMSGSIZE;
+
+	if (slwt->mtu && nla_put_u32(skb, SEG6_IPTUNNEL_MTU, slwt->mtu))
+		return -EMSGSIZE;
+
+	if (slwt->mss_clamp && nla_put_flag(skb, SEG6_IPTUNNEL_MSS_CLAMP))
+		return -EMSGSIZE;
+
 	return 0;
 }
 
 static int seg6_encap_nlsize(struct lwtunnel_state *lwtstate)
 {
 	struct seg6_iptunnel_encap *tuninfo = seg6_encap_lwtunnel(lwtstate);
+	struct seg6_lwt *slwt = seg6_lwt_lwtunnel(lwtstate);
+	int nlsize, i;
+
+	nlsize = nla_total_size(SEG6_IPTUN_ENCAP_SIZE(tuninfo));
+
+	if (slwt->classes) {
+		nlsize += nla_total_size(4) +	/* SEG6_IPTUNNEL_CLASS_KEY */
+			  nla_total_size(0);	/* SEG6_IPTUNNEL_CLASSES */
+
+		for (i = 0; i < slwt->classes->nr; i++) {
+			struct ipv6_sr_hdr *srh = slwt->classes->entries[i].srh;
+
+			nlsize += nla_total_size(0) +	/* SEG6_IPTUNNEL_CLASS */
+				  nla_total_size(4) +
+				  nla_total_size((srh->hdrlen + 1) << 3);
+		}
+	}
+
+	if (slwt->mtu)
+		nlsize += nla_total_size(4);	/* SEG6_IPTUNNEL_MTU */
 
-	return nla_total_size(SEG6_IPTUN_ENCAP_SIZE(tuninfo));
+	if (slwt->mss_clamp)
+		nlsize += nla_total_size(0);	/* SEG6_IPTUNNEL_MSS_CLAMP */
+
+	return nlsize;
+}
+
+static int seg6_classes_cmp(struct seg6_lwt_classes *a,
+			    struct seg6_lwt_classes *b)
+{
+	int i, len;
+
+	if (!a && !b)
+		return 0;
+
+	if (!a || !b)
+		return 1;
+
+	if (a->key != b->key || a->nr != b->nr)
+		return 1;
+
+	for (i = 0; i < a->nr; i++) {
+		if (a->entries[i].value != b->entries[i].value)
+			return 1;
+
+		len = (a->entries[i].srh->hdrlen + 1) << 3;
+		if (len != ((b->entries[i].srh->hdrlen + 1) << 3))
+			return 1;
+
+		if (memcmp(a->entries[i].srh, b->entries[i].srh, len))
+			return 1;
+	}
+
+	return 0;
 }
 
 static int seg6_encap_cmp(struct lwtunnel_state *a, struct lwtunnel_state *b)
@@ -490,9 +1018,147 @@ static int seg6_encap_cmp(struct lwtunnel_state *a, struct lwtunnel_state *b)
 	if (len != SEG6_IPTUN_ENCAP_SIZE(b_hdr))
 		return 1;
 
+	if (seg6_classes_cmp(seg6_lwt_lwtunnel(a)->classes,
+			     seg6_lwt_lwtunnel(b)->classes))
+		return 1;
+
+	if (seg6_lwt_lwtunnel(a)->mtu != seg6_lwt_lwtunnel(b)->mtu ||
+	    seg6_lwt_lwtunnel(a)->mss_clamp != seg6_lwt_lwtunnel(b)->mss_clamp)
+		return 1;
+
 	return memcmp(a_hdr, b_hdr, len);
 }
 
+/* Build the outer headers that seg6_do_srh_encap() would push on packets
+ * of a flow of the given family routed through dst. The outer flowlabel
+ * follows seg6_make_flowlabel(): the user of the template derives it from
+ * the flow hash of each packet when seg6_flowlabel is positive.
+ */
+static struct lwtunnel_encap_tmpl *seg6_get_encap_tmpl(struct dst_entry *dst,
+						       u8 family)
+{
+	struct seg6_lwt *slwt = seg6_lwt_lwtunnel(dst->lwtstate);
+	struct seg6_iptunnel_encap *tinfo = slwt->tuninfo;
+	struct net *net = dev_net(dst->dev);
+	int do_flowlabel = net->ipv6.sysctl.seg6_flowlabel;
+	struct lwtunnel_encap_tmpl *tmpl;
+	struct ipv6_sr_hdr *isrh;
+	struct dst_entry *odst;
+	struct ipv6hdr *hdr;
+	struct flowi6 fl6;
+	int hdrlen, mtu;
+
+	/* classes pick the SRH per packet, a template cannot */
+	if (tinfo->mode != SEG6_IPTUN_MODE_ENCAP || slwt->classes)
+		return NULL;
+
+	hdrlen = (tinfo->srh->hdrlen + 1) << 3;
+
+	tmpl = kzalloc(sizeof(*tmpl) + sizeof(*hdr) + hdrlen, GFP_ATOMIC);
+	if (!tmpl)
+		return NULL;
+
+	hdr = (struct ipv6hdr *)tmpl->data;
+	isrh = (void *)hdr + sizeof(*hdr);
+	memcpy(isrh, tinfo->srh, hdrlen);
+
+	ip6_flow_hdr(hdr, 0, 0);
+	if (do_flowlabel > 0)
+		tmpl->flags = LWTUNNEL_TMPL_HASH_FLOWLABEL;
+
+	switch (family) {
+	case AF_INET6:
+		isrh->nexthdr = IPPROTO_IPV6;
+		tmpl->flags |= LWTUNNEL_TMPL_INHERIT_DSFIELD |
+			       LWTUNNEL_TMPL_INHERIT_HOPLIMIT;
+		if (!do_flowlabel)
+			tmpl->flags |= LWTUNNEL_TMPL_INHERIT_FLOWLABEL;
+		break;
+	case AF_INET:
+		isrh->nexthdr = IPPROTO_IPIP;
+		hdr->hop_limit = ip6_dst_hoplimit(dst);
+		break;
+	default:
+		goto err_free;
+	}
+
+	hdr->nexthdr = NEXTHDR_ROUTING;
+	hdr->daddr = isrh->segments[isrh->first_segment];
+	set_tun_src(net, dst->dev, &hdr->daddr, &hdr->saddr);
+
+#ifdef CONFIG_IPV6_SEG6_HMAC
+	if (sr_has_hmac(isrh) && seg6_push_hmac(net, &hdr->saddr, isrh))
+		goto err_free;
+#endif
+
+	memset(&fl6, 0, sizeof(fl6));
+	fl6.daddr = hdr->daddr;
+	fl6.saddr = hdr->saddr;
+	fl6.flowlabel = ip6_flowinfo(hdr);
+	fl6.flowi6_proto = hdr->nexthdr;
+
+	odst = ip6_route_output(net, NULL, &fl6);
+	if (odst->error)
+		goto err_release;
+
+	/* the outer packet is handed to the neighbour layer directly */
+	if (lwtunnel_output_redirect(odst->lwtstate) ||
+	    lwtunnel_xmit_redirect(odst->lwtstate))
+		goto err_release;
+
+	mtu = dst_mtu(odst) - sizeof(*hdr) - hdrlen;
+	if (mtu <= 0)
+		goto err_release;
+
+	tmpl->dst = odst;
+	tmpl->mtu = min(mtu, 0xFFFF);
+	tmpl->len = sizeof(*hdr) + hdrlen;
+	tmpl->protocol = htons(ETH_P_IPV6);
+
+	return tmpl;
+
+err_release:
+	dst_release(odst);
+err_free:
+	kfree(tmpl);
+	return NULL;
+}
+
+/* Return the SRH a seg6 route applies to every packet and its mode, for
+ * lookups that have no packet at hand such as bpf_fib_lookup(). In encap
+ * mode, saddr is set to the outer source address. Routes with traffic
+ * classes pick their SRH per packet and return NULL, with mode still set.
+ */
+struct ipv6_sr_hdr *seg6_lwt_policy(struct lwtunnel_state *lwt,
+				    struct net_device *dev, int *mode,
+				    struct in6_addr *saddr)
+{
+	struct seg6_lwt *slwt = seg6_lwt_lwtunnel(lwt);
+	struct seg6_iptunnel_encap *tinfo = slwt->tuninfo;
+	struct ipv6_sr_hdr *srh = tinfo->srh;
+
+	*mode = tinfo->mode;
+	if (slwt->classes)
+		return NULL;
+
+	if (tinfo->mode == SEG6_IPTUN_MODE_ENCAP)
+		set_tun_src(dev_net(dev), dev,
+			    &srh->segments[srh->first_segment], saddr);
+
+	return srh;
+}
+EXPORT_SYMBOL_GPL(seg6_lwt_policy);
+
+void seg6_lwt_offload_fill(struct lwtunnel_state *lwt, struct net_device *dev,
+			   struct seg6_encap_offload *encap)
+{
+	struct seg6_lwt *slwt = seg6_lwt_lwtunnel(lwt);
+
+	memset(encap, 0, sizeof(*encap));
+	encap->srh = seg6_lwt_policy(lwt, dev, &encap->mode, &encap->saddr);
+	encap->mtu = slwt->mtu;
+}
+
 static const struct lwtunnel_encap_ops seg6_iptun_ops = {
 	.build_state = seg6_build_state,
 	.destroy_state = seg6_destroy_state,
@@ -501,6 +1167,7 @@ static const struct lwtunnel_encap_ops seg6_iptun_ops = {
 	.fill_encap = seg6_fill_encap_info,
 	.get_encap_size = seg6_encap_nlsize,
 	.cmp_encap = seg6_encap_cmp,
+	.get_encap_tmpl = seg6_get_encap_tmpl,
 	.owner = THIS_MODULE,
 };
 
@@ -34,19 +34,68 @@
 #include <net/seg6_local.h>
 #include <linux/etherdevice.h>
 #include <linux/bpf.h>
+#include <linux/icmpv6.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/jhash.h>
+#include <net/ip6_checksum.h>
 
 struct seg6_local_lwt;
+struct seg6_bpf_cache;
 
 struct seg6_action_desc {
 	int action;
 	unsigned long attrs;
+	unsigned long optattrs;
 	int (*input)(struct sk_buff *skb, struct seg6_local_lwt *slwt);
 	int static_headroom;
 };
 
+/* The program is either fixed (prog) or read from slot index of a prog
+ * array at every packet, so that it can be swapped with a map update.
+ */
 struct bpf_lwt_prog {
 	struct bpf_prog *prog;
+	struct bpf_map *array;
+	u32 index;
 	char *name;
+	struct seg6_bpf_cache *cache;
+};
+
+/* Token bucket state of one CPU. Tokens are expressed in nanoseconds of
+ * credit, a packet costs NSEC_PER_SEC / rate. Buckets are only touched
+ * from the receive softirq of their CPU, hence need no locking.
+ */
+struct seg6_policer_pcpu {
+	u64 tokens;
+	u64 t_c;
+	u64 drops;
+	struct u64_stats_sync syncp;
+};
+
+struct seg6_policer {
+	u32 rate;
+	u32 burst;
+	u64 cost_ns;
+	u64 burst_ns;
+	struct seg6_policer_pcpu __percpu *pcpu;
+};
+
+struct seg6_lb_backend {
+	struct in6_addr sid;
+	u32 weight;
+};
+
+/* End.LB state. table maps every hash bucket to a backend index and is
+ * filled once by seg6_lb_populate(); a new backend set means a new route,
+ * so packets never see a table being rebuilt.
+ */
+struct seg6_lb {
+	u32 mode;
+	u32 size;
+	u16 *table;
+	int nr;
+	struct seg6_lb_backend backends[0];
 };
 
 struct seg6_local_lwt {
@@ -58,9 +107,13 @@ struct seg6_local_lwt {
 	int iif;
 	int oif;
 	struct bpf_lwt_prog bpf;
+	u32 oam_flags;
+	struct seg6_policer *policer;
+	struct seg6_lb *lb;
 
 	int headroom;
 	struct seg6_action_desc *desc;
+	unsigned long parsed_optattrs;
 };
 
 static struct seg6_local_lwt *seg6_local_lwtunnel(struct lwtunnel_state *lwt)
@@ -68,11 +121,56 @@ static struct seg6_local_lwt *seg6_local_lwtunnel(struct lwtunnel_state *lwt)
 	return (struct seg6_local_lwt *)lwt->data;
 }
 
-static struct ipv6_sr_hdr *get_srh(struct sk_buff *skb)
+/* required attributes plus the optional ones supplied by the user */
+static unsigned long seg6_local_attrs(struct seg6_local_lwt *slwt)
+{
+	return slwt->desc->attrs | slwt->parsed_optattrs;
+}
+
+/* SRH already located and validated by XDP, see struct sr6_xdp_meta */
+static struct ipv6_sr_hdr *get_srh_xdp(struct sk_buff *skb,
+				       struct sr6_xdp_meta *meta)
+{
+	struct ipv6_sr_hdr *srh;
+	int len;
+
+	if (!pskb_may_pull(skb, meta->srh_off + sizeof(*srh)))
+		return NULL;
+
+	srh = (struct ipv6_sr_hdr *)(skb->data + meta->srh_off);
+	len = (srh->hdrlen + 1) << 3;
+
+	if (!pskb_may_pull(skb, meta->srh_off + len))
+		return NULL;
+
+	srh = (struct ipv6_sr_hdr *)(skb->data + meta->srh_off);
+
+	/* cheap sanity checks against stale metadata, the XDP program is
+	 * trusted for the rest
+	 */
+	if (srh->type != IPV6_SRCRT_TYPE_4 ||
+	    srh->segments_left != meta->segments_left)
+		return NULL;
+
+	return srh;
+}
+
+static struct ipv6_sr_hdr *get_srh(struct sk_buff *skb, bool *hmac_ok)
 {
+	struct sr6_xdp_meta meta;
 	struct ipv6_sr_hdr *srh;
 	int len, srhoff = 0;
 
+	*hmac_ok = false;
+
+	if (seg6_xdp_meta_get(skb, &meta)) {
+		srh = get_srh_xdp(skb, &meta);
+		if (srh) {
+			*hmac_ok = meta.flags & SR6_XDP_META_HMAC;
+			return srh;
+		}
+	}
+
 	if (ipv6_find_hdr(skb, &srhoff, IPPROTO_ROUTING, NULL, NULL) < 0)
 		return NULL;
 
@@ -95,8 +193,9 @@ static struct ipv6_sr_hdr *get_srh(struct sk_buff *skb)
 static struct ipv6_sr_hdr *get_and_validate_srh(struct sk_buff *skb)
 {
 	struct ipv6_sr_hdr *srh;
+	bool hmac_ok;
 
-	srh = get_srh(skb);
+	srh = get_srh(skb, &hmac_ok);
 	if (!srh)
 		return NULL;
 
@@ -104,10 +203,12 @@ static struct ipv6_sr_hdr *get_and_validate_srh(struct sk_buff *skb)
 		return NULL;
 
 #ifdef CONFIG_IPV6_SEG6_HMAC
-	if (!seg6_hmac_validate_skb(skb))
+	if (!hmac_ok && !seg6_hmac_validate_skb(skb))
 		return NULL;
 #endif
 
+	seg6_oam_sample(skb, srh);
+
 	return srh;
 }
 
@@ -115,16 +216,20 @@ static bool decap_and_validate(struct sk_buff *skb, int proto)
 {
 	struct ipv6_sr_hdr *srh;
 	unsigned int off = 0;
+	bool hmac_ok;
 
-	srh = get_srh(skb);
+	srh = get_srh(skb, &hmac_ok);
 	if (srh && srh->segments_left > 0)
 		return false;
 
 #ifdef CONFIG_IPV6_SEG6_HMAC
-	if (srh && !seg6_hmac_validate_skb(skb))
+	if (srh && !hmac_ok && !seg6_hmac_validate_skb(skb))
 		return false;
 #endif
 
+	if (srh)
+		seg6_oam_sample(skb, srh);
+
 	if (ipv6_find_hdr(skb, &off, proto, NULL, NULL) < 0)
 		return false;
 
@@ -459,45 +564,304 @@ static int input_action_end_b6_encap(struct sk_buff *skb,
 
 DEFINE_PER_CPU(struct seg6_bpf_srh_state, seg6_bpf_srh_states);
 
+/* Optional per-SID cache of End.BPF verdicts, for programs whose decision
+ * only depends on the SRH and on the flow of the packet. Every CPU owns a
+ * direct-mapped table, only accessed with preemption disabled. An entry
+ * is valid while its generation matches the one of the cache, which is
+ * bumped when the program or the content of its maps changes, and when
+ * the program calls bpf_lwt_seg6_cache_flush(). Updates done by programs
+ * to their own maps, or to inner maps, are not tracked.
+ */
+#define SEG6_BPF_CACHE_MAX	16384
+#define SEG6_BPF_CACHE_SRH_MAX	128
+
+struct seg6_bpf_flow {
+	struct in6_addr saddr;
+	struct in6_addr daddr;
+	struct in6_addr inner_saddr;
+	struct in6_addr inner_daddr;
+	__be32 ports;
+	__be16 n_proto;
+	u8 ip_proto;
+	u8 srh_len;
+};
+
+struct seg6_bpf_cache_entry {
+	u32 gen;		/* 0 when the entry holds no verdict */
+	int ret;
+	struct seg6_bpf_flow flow;
+	u8 srh[SEG6_BPF_CACHE_SRH_MAX];
+	struct seg6_bpf_cache_rec rec;
+};
+
+struct seg6_bpf_cache {
+	u32 mask;
+	u32 gen;
+	u32 prog_id;
+	u64 map_gen;
+	struct seg6_bpf_cache_entry * __percpu *tables;
+};
+
+static void seg6_bpf_cache_flush(struct seg6_bpf_cache *cache)
+{
+	u32 gen = READ_ONCE(cache->gen) + 1;
+
+	WRITE_ONCE(cache->gen, gen ? : 1);
+}
+
+static u64 seg6_bpf_maps_gen(const struct bpf_prog *prog)
+{
+	u64 gen = 0;
+	u32 i;
+
+	for (i = 0; i < prog->aux->used_map_cnt; i++)
+		gen += atomic_read(&prog->aux->used_maps[i]->gen);
+
+	return gen;
+}
+
+static bool seg6_bpf_flow_get(struct sk_buff *skb, struct ipv6_sr_hdr *srh,
+			      struct seg6_bpf_flow *flow)
+{
+	struct flow_keys keys;
+	int len;
+
+	len = (srh->hdrlen + 1) << 3;
+	if (len > SEG6_BPF_CACHE_SRH_MAX)
+		return false;
+
+	/* the outer header and the SRH are skipped, keys describe the
+	 * innermost flow
+	 */
+	if (!skb_flow_dissect_flow_keys(skb, &keys, 0))
+		return false;
+
+	memset(flow, 0, sizeof(*flow));
+	flow->saddr = ipv6_hdr(skb)->saddr;
+	flow->daddr = ipv6_hdr(skb)->daddr;
+	flow->ports = keys.ports.ports;
+	flow->n_proto = keys.basic.n_proto;
+	flow->ip_proto = keys.basic.ip_proto;
+	flow->srh_len = len;
+
+	switch (keys.control.addr_type) {
+	case FLOW_DISSECTOR_KEY_IPV4_ADDRS:
+		ipv6_addr_set_v4mapped(keys.addrs.v4addrs.src,
+				       &flow->inner_saddr);
+		ipv6_addr_set_v4mapped(keys.addrs.v4addrs.dst,
+				       &flow->inner_daddr);
+		break;
+	case FLOW_DISSECTOR_KEY_IPV6_ADDRS:
+		flow->inner_saddr = keys.addrs.v6addrs.src;
+		flow->inner_daddr = keys.addrs.v6addrs.dst;
+		break;
+	}
+
+	return true;
+}
+
+/* Must be called with preemption disabled, before the SRH is modified.
+ * Returns the entry of this CPU the packet maps to, holding a verdict if
+ * its generation is not zero, or NULL if the packet cannot be cached.
+ * @gen is set to the generation a new verdict must be committed with.
+ */
+static struct seg6_bpf_cache_entry *
+seg6_bpf_cache_lookup(struct seg6_bpf_cache *cache, struct bpf_prog *prog,
+		      struct sk_buff *skb, struct ipv6_sr_hdr *srh, u32 *gen)
+{
+	struct seg6_bpf_cache_entry *e;
+	struct seg6_bpf_flow flow;
+	u64 map_gen;
+	u32 hash;
+
+	if (!seg6_bpf_flow_get(skb, srh, &flow))
+		return NULL;
+
+	map_gen = seg6_bpf_maps_gen(prog);
+	if (unlikely(READ_ONCE(cache->map_gen) != map_gen ||
+		     READ_ONCE(cache->prog_id) != prog->aux->id)) {
+		WRITE_ONCE(cache->map_gen, map_gen);
+		WRITE_ONCE(cache->prog_id, prog->aux->id);
+		seg6_bpf_cache_flush(cache);
+	}
+	*gen = READ_ONCE(cache->gen);
+
+	hash = jhash(&flow, sizeof(flow), 0);
+	hash = jhash(srh, flow.srh_len, hash);
+	e = &(*this_cpu_ptr(cache->tables))[hash & cache->mask];
+
+	if (e->gen == *gen && !memcmp(&e->flow, &flow, sizeof(flow)) &&
+	    !memcmp(e->srh, srh, flow.srh_len))
+		return e;
+
+	/* miss, the entry is recycled for the verdict of this packet */
+	e->gen = 0;
+	e->flow = flow;
+	memcpy(e->srh, srh, flow.srh_len);
+	memset(&e->rec, 0, sizeof(e->rec));
+	return e;
+}
+
+static void seg6_bpf_cache_commit(struct seg6_bpf_cache *cache,
+				  struct seg6_bpf_cache_entry *e,
+				  struct seg6_bpf_srh_state *srh_state,
+				  struct sk_buff *skb, int ret, u32 gen,
+				  u32 mark, u32 priority)
+{
+	struct seg6_bpf_cache_rec *rec = &e->rec;
+
+	if (rec->flush) {
+		seg6_bpf_cache_flush(cache);
+		return;
+	}
+
+	/* writes to the TLVs need the SRH to be validated again, keep
+	 * those on the slow path
+	 */
+	if (rec->uncacheable || !srh_state->valid || srh_state->none)
+		return;
+
+	if (ret != BPF_OK && ret != BPF_REDIRECT && ret != BPF_DROP)
+		return;
+
+	/* the replay sets the mark before looking up the nexthop, which
+	 * only matches the recorded run if the mark was not changed after
+	 * the lookup
+	 */
+	if (rec->action && skb->mark != rec->action_mark)
+		return;
+
+	if (skb->mark != mark) {
+		rec->flags |= SEG6_BPF_REC_MARK;
+		rec->mark = skb->mark;
+	}
+	if (skb->priority != priority) {
+		rec->flags |= SEG6_BPF_REC_PRIORITY;
+		rec->priority = skb->priority;
+	}
+
+	e->ret = ret;
+	e->gen = gen;
+}
+
+static int seg6_bpf_cache_replay(struct sk_buff *skb,
+				 struct seg6_bpf_cache_rec *rec)
+{
+	int srhoff = 0, off, len, i;
+
+	if (rec->script_len &&
+	    ipv6_find_hdr(skb, &srhoff, IPPROTO_ROUTING, NULL, NULL) < 0)
+		return -EINVAL;
+
+	for (i = 0; i < rec->script_len; i += 2 + len) {
+		off = srhoff + rec->script[i];
+		len = rec->script[i + 1];
+
+		if (skb_ensure_writable(skb, off + len))
+			return -ENOMEM;
+		memcpy(skb->data + off, &rec->script[i + 2], len);
+	}
+
+	if (rec->flags & SEG6_BPF_REC_MARK)
+		skb->mark = rec->mark;
+	if (rec->flags & SEG6_BPF_REC_PRIORITY)
+		skb->priority = rec->priority;
+
+	if (rec->action == SEG6_LOCAL_ACTION_END_X)
+		seg6_lookup_nexthop(skb, &rec->nh6, 0);
+	else if (rec->action == SEG6_LOCAL_ACTION_END_T)
+		seg6_lookup_nexthop(skb, NULL, rec->table);
+
+	return 0;
+}
+
+/* must be called under rcu_read_lock(), NULL if the slot is empty */
+static struct bpf_prog *seg6_bpf_prog(struct seg6_local_lwt *slwt)
+{
+	struct bpf_array *array;
+
+	if (!slwt->bpf.array)
+		return slwt->bpf.prog;
+
+	array = container_of(slwt->bpf.array, struct bpf_array, map);
+	return READ_ONCE(array->ptrs[slwt->bpf.index]);
+}
+
 static int input_action_end_bpf(struct sk_buff *skb,
 				struct seg6_local_lwt *slwt)
 {
 	struct seg6_bpf_srh_state *srh_state =
 		this_cpu_ptr(&seg6_bpf_srh_states);
 	struct seg6_bpf_srh_state local_srh_state;
+	struct seg6_bpf_cache *cache = slwt->bpf.cache;
+	struct seg6_bpf_cache_entry *entry = NULL;
+	u32 gen = 0, mark, priority;
 	struct ipv6_sr_hdr *srh;
+	struct bpf_prog *prog;
 	struct ipv6hdr *hdr;
 	int srhoff = 0;
-	int ret;
+	bool hmac_ok;
+	int ret, err;
 
-	srh = get_srh(skb);
+	srh = get_srh(skb, &hmac_ok);
 	if (!srh)
 		goto drop;
 
 #ifdef CONFIG_IPV6_SEG6_HMAC
-	if (!seg6_hmac_validate_skb(skb))
+	if (!hmac_ok && !seg6_hmac_validate_skb(skb))
 		goto drop;
 #endif
 
+	seg6_oam_sample(skb, srh);
+
+	/* preempt_disable is needed to protect the per-CPU buffer srh_state,
+	 * which is also accessed by the bpf_lwt_seg6_* helpers, and the
+	 * per-CPU tables of the flow cache
+	 */
+	preempt_disable();
+	rcu_read_lock();
+	prog = seg6_bpf_prog(slwt);
+	if (unlikely(!prog)) {
+		rcu_read_unlock();
+		preempt_enable();
+		goto drop;
+	}
+
+	if (cache)
+		entry = seg6_bpf_cache_lookup(cache, prog, skb, srh, &gen);
+
 	hdr = ipv6_hdr(skb);
 	if (srh->segments_left == 0)
 		memset(&hdr->daddr, 0, sizeof(hdr->daddr));
 	else
 		advance_nextseg(srh, &ipv6_hdr(skb)->daddr);
 
-	/* preempt_disable is needed to protect the per-CPU buffer srh_state,
-	 * which is also accessed by the bpf_lwt_seg6_* helpers
-	 */
-	preempt_disable();
+	if (entry && entry->gen) {
+		rcu_read_unlock();
+		ret = entry->ret;
+		err = seg6_bpf_cache_replay(skb, &entry->rec);
+		preempt_enable();
+
+		if (err || ret == BPF_DROP)
+			goto drop;
+		goto lookup;
+	}
+
 	srh_state->hdrlen = srh->hdrlen << 3;
 	srh_state->valid = 1;
 	srh_state->none = 0;
+	srh_state->rec = entry ? &entry->rec : NULL;
+	mark = skb->mark;
+	priority = skb->priority;
 
-	rcu_read_lock();
 	bpf_compute_data_pointers(skb);
-	ret = bpf_prog_run_save_cb(slwt->bpf.prog, skb);
+	ret = bpf_prog_run_save_cb(prog, skb);
 	rcu_read_unlock();
 
+	srh_state->rec = NULL;
+	if (entry)
+		seg6_bpf_cache_commit(cache, entry, srh_state, skb, ret, gen,
+				      mark, priority);
 	local_srh_state = *srh_state;
 	preempt_enable();
 
@@ -538,348 +902,1234 @@ static int input_action_end_bpf(struct sk_buff *skb,
 	return -EINVAL;
 }
 
-static struct seg6_action_desc seg6_action_table[] = {
-	{
-		.action		= SEG6_LOCAL_ACTION_END,
-		.attrs		= 0,
-		.input		= input_action_end,
-	},
-	{
-		.action		= SEG6_LOCAL_ACTION_END_X,
-		.attrs		= (1 << SEG6_LOCAL_NH6),
-		.input		= input_action_end_x,
-	},
-	{
-		.action		= SEG6_LOCAL_ACTION_END_T,
-		.attrs		= (1 << SEG6_LOCAL_TABLE),
-		.input		= input_action_end_t,
-	},
-	{
-		.action		= SEG6_LOCAL_ACTION_END_DX2,
-		.attrs		= (1 << SEG6_LOCAL_OIF),
-		.input		= input_action_end_dx2,
-	},
-	{
-		.action		= SEG6_LOCAL_ACTION_END_DX6,
-		.attrs		= (1 << SEG6_LOCAL_NH6),
-		.input		= input_action_end_dx6,
-	},
-	{
-		.action		= SEG6_LOCAL_ACTION_END_DX4,
-		.attrs		= (1 << SEG6_LOCAL_NH4),
-		.input		= input_action_end_dx4,
-	},
-	{
-		.action		= SEG6_LOCAL_ACTION_END_DT6,
-		.attrs		= (1 << SEG6_LOCAL_TABLE),
-		.input		= input_action_end_dt6,
-	},
-	{
-		.action		= SEG6_LOCAL_ACTION_END_B6,
-		.attrs		= (1 << SEG6_LOCAL_SRH),
-		.input		= input_action_end_b6,
-	},
-	{
-		.action		= SEG6_LOCAL_ACTION_END_B6_ENCAP,
-		.attrs		= (1 << SEG6_LOCAL_SRH),
-		.input		= input_action_end_b6_encap,
-		.static_headroom	= sizeof(struct ipv6hdr),
-	},
-	{
-		.action		= SEG6_LOCAL_ACTION_END_BPF,
-		.attrs		= (1 << SEG6_LOCAL_BPF),
-		.input		= input_action_end_bpf,
-	},
-
-};
-
-static struct seg6_action_desc *__get_action_desc(int action)
-{
-	struct seg6_action_desc *desc;
-	int i, count;
-
-	count = ARRAY_SIZE(seg6_action_table);
-	for (i = 0; i < count; i++) {
-		desc = &seg6_action_table[i];
-		if (desc->action == action)
-			return desc;
-	}
-
-	return NULL;
-}
-
-static int seg6_local_input(struct sk_buff *skb)
+/* Turn an ICMPv6 echo request addressed to this SID into the matching reply
+ * and send it from the receive path, without waking up any socket. The
+ * reply optionally carries a one-segment SRH with a timestamp TLV.
+ * On error, the skb is left to the caller.
+ */
+static int seg6_oam_echo_reply(struct sk_buff *skb,
+			       struct seg6_local_lwt *slwt)
 {
-	struct dst_entry *orig_dst = skb_dst(skb);
-	struct seg6_action_desc *desc;
-	struct seg6_local_lwt *slwt;
+	ktime_t rx_tstamp = skb->tstamp ? : ktime_get_real();
+	struct net *net = dev_net(skb->dev);
+	int iif = skb->dev->ifindex;
+	struct in6_addr saddr, daddr;
+	struct ipv6_sr_hdr *srh;
+	struct dst_entry *dst;
+	struct icmp6hdr *icmph;
+	struct ipv6hdr *hdr;
+	unsigned int off = 0;
+	struct flowi6 fl6;
+	__be32 flowinfo;
+	int srhlen = 0;
+	u8 code;
 
-	if (skb->protocol != htons(ETH_P_IPV6)) {
-		kfree_skb(skb);
+	if (ipv6_find_hdr(skb, &off, IPPROTO_ICMPV6, NULL, NULL) < 0)
 		return -EINVAL;
-	}
 
-	slwt = seg6_local_lwtunnel(orig_dst->lwtstate);
-	desc = slwt->desc;
+	hdr = ipv6_hdr(skb);
+	if (ipv6_addr_is_multicast(&hdr->saddr) ||
+	    ipv6_addr_any(&hdr->saddr))
+		return -EINVAL;
 
-	return desc->input(skb, slwt);
-}
+	saddr = hdr->saddr;
+	daddr = hdr->daddr;
+	flowinfo = ip6_flowinfo(hdr);
 
-static const struct nla_policy seg6_local_policy[SEG6_LOCAL_MAX + 1] = {
-	[SEG6_LOCAL_ACTION]	= { .type = NLA_U32 },
-	[SEG6_LOCAL_SRH]	= { .type = NLA_BINARY },
-	[SEG6_LOCAL_TABLE]	= { .type = NLA_U32 },
-	[SEG6_LOCAL_NH4]	= { .type = NLA_BINARY,
-				    .len = sizeof(struct in_addr) },
-	[SEG6_LOCAL_NH6]	= { .type = NLA_BINARY,
-				    .len = sizeof(struct in6_addr) },
-	[SEG6_LOCAL_IIF]	= { .type = NLA_U32 },
-	[SEG6_LOCAL_OIF]	= { .type = NLA_U32 },
-	[SEG6_LOCAL_BPF]	= { .type = NLA_NESTED },
-};
+	if (!pskb_pull(skb, off))
+		return -EINVAL;
 
-static int parse_nla_srh(struct nlattr **attrs, struct seg6_local_lwt *slwt)
-{
-	struct ipv6_sr_hdr *srh;
-	int len;
+	skb_postpull_rcsum(skb, skb_network_header(skb), off);
+	skb_reset_transport_header(skb);
 
-	srh = nla_data(attrs[SEG6_LOCAL_SRH]);
-	len = nla_len(attrs[SEG6_LOCAL_SRH]);
+	if (!pskb_may_pull(skb, sizeof(*icmph)))
+		return -EINVAL;
 
-	/* SRH must contain at least one segment */
-	if (len < sizeof(*srh) + sizeof(struct in6_addr))
+	if (icmp6_hdr(skb)->icmp6_type != ICMPV6_ECHO_REQUEST)
 		return -EINVAL;
 
-	if (!seg6_validate_srh(srh, len))
+	/* the pseudo-header still uses the received IPv6 header, whose DA
+	 * is the final destination since segments_left is zero
+	 */
+	if (skb_checksum_validate(skb, IPPROTO_ICMPV6, ip6_compute_pseudo))
 		return -EINVAL;
 
-	slwt->srh = kmalloc(len, GFP_KERNEL);
-	if (!slwt->srh)
+	if (skb_ensure_writable(skb, sizeof(*icmph)))
 		return -ENOMEM;
 
-	memcpy(slwt->srh, srh, len);
+	/* addresses are only swapped, so the pseudo-header sum is unchanged */
+	icmph = icmp6_hdr(skb);
+	code = icmph->icmp6_code;
+	icmph->icmp6_type = ICMPV6_ECHO_REPLY;
+	csum_replace2(&icmph->icmp6_cksum,
+		      htons(ICMPV6_ECHO_REQUEST << 8 | code),
+		      htons(ICMPV6_ECHO_REPLY << 8 | code));
+
+	memset(&fl6, 0, sizeof(fl6));
+	fl6.daddr = saddr;
+	fl6.saddr = daddr;
+	fl6.flowlabel = flowinfo;
+	fl6.flowi6_mark = skb->mark;
+	fl6.flowi6_proto = IPPROTO_ICMPV6;
+	fl6.fl6_icmp_type = ICMPV6_ECHO_REPLY;
+	fl6.fl6_icmp_code = code;
 
-	slwt->headroom += len;
+	dst = ip6_route_output(net, NULL, &fl6);
+	if (dst->error) {
+		int err = dst->error;
 
-	return 0;
-}
+		dst_release(dst);
+		return err;
+	}
 
-static int put_nla_srh(struct sk_buff *skb, struct seg6_local_lwt *slwt)
-{
+	if (slwt->oam_flags & SEG6_LOCAL_OAM_TSTAMP)
+		srhlen = sizeof(*srh) + sizeof(struct in6_addr) +
+			 sizeof(struct sr6_tlv_tstamp);
+
+	if (skb_cow_head(skb, srhlen + sizeof(*hdr) +
+			      LL_RESERVED_SPACE(dst->dev))) {
+		dst_release(dst);
+		return -ENOMEM;
+	}
+
+	if (srhlen) {
+		struct sr6_tlv_tstamp *tlv;
+
+		srh = skb_push(skb, srhlen);
+		srh->nexthdr = IPPROTO_ICMPV6;
+		srh->hdrlen = (srhlen >> 3) - 1;
+		srh->type = IPV6_SRCRT_TYPE_4;
+		srh->segments_left = 0;
+		srh->first_segment = 0;
+		srh->flags = 0;
+		srh->tag = 0;
+		srh->segments[0] = saddr;
+
+		tlv = (struct sr6_tlv_tstamp *)(srh->segments + 1);
+		tlv->type = SR6_TLV_TIMESTAMP;
+		tlv->len = sizeof(*tlv) - sizeof(struct sr6_tlv);
+		tlv->reserved = 0;
+		tlv->ifindex = htonl(iif);
+		tlv->rx_tstamp = cpu_to_be64(ktime_to_ns(rx_tstamp));
+		tlv->tx_tstamp = cpu_to_be64(ktime_get_real_ns());
+	}
+
+	skb_push(skb, sizeof(*hdr));
+	skb_reset_network_header(skb);
+
+	hdr = ipv6_hdr(skb);
+	ip6_flow_hdr(hdr, ip6_tclass(flowinfo), flowinfo & IPV6_FLOWLABEL_MASK);
+	hdr->payload_len = htons(skb->len - sizeof(*hdr));
+	hdr->nexthdr = srhlen ? NEXTHDR_ROUTING : IPPROTO_ICMPV6;
+	hdr->hop_limit = ip6_dst_hoplimit(dst);
+	hdr->saddr = daddr;
+	hdr->daddr = saddr;
+
+	skb_scrub_packet(skb, false);
+	memset(IP6CB(skb), 0, sizeof(*IP6CB(skb)));
+	skb->ip_summed = CHECKSUM_NONE;
+	skb->protocol = htons(ETH_P_IPV6);
+	skb->dev = dst->dev;
+	skb_dst_set(skb, dst);
+
+	ip6_local_out(net, NULL, skb);
+
+	return 0;
+}
+
+/* OAM endpoint: answer echo probes locally, behave as End otherwise */
+static int input_action_end_oam(struct sk_buff *skb,
+				struct seg6_local_lwt *slwt)
+{
+	struct ipv6_sr_hdr *srh;
+	int err = -EINVAL;
+	int srhoff = 0;
+	bool hmac_ok;
+
+	srh = get_srh(skb, &hmac_ok);
+	if (!srh) {
+		struct ipv6_rt_hdr *rh;
+
+		/* probes without an SRH are answered, invalid SRHs dropped,
+		 * other routing headers do not make an SRH invalid
+		 */
+		if (ipv6_find_hdr(skb, &srhoff, IPPROTO_ROUTING, NULL,
+				  NULL) >= 0) {
+			if (!pskb_may_pull(skb, srhoff + sizeof(*rh)))
+				goto drop;
+
+			rh = (struct ipv6_rt_hdr *)(skb->data + srhoff);
+			if (rh->type == IPV6_SRCRT_TYPE_4)
+				goto drop;
+		}
+	} else {
+#ifdef CONFIG_IPV6_SEG6_HMAC
+		if (!hmac_ok && !seg6_hmac_validate_skb(skb))
+			goto drop;
+#endif
+
+		seg6_oam_sample(skb, srh);
+
+		if (srh->segments_left > 0) {
+			advance_nextseg(srh, &ipv6_hdr(skb)->daddr);
+
+			seg6_lookup_nexthop(skb, NULL, 0);
+
+			return dst_input(skb);
+		}
+	}
+
+	err = seg6_oam_echo_reply(skb, slwt);
+	if (err)
+		goto drop;
+
+	return 0;
+
+drop:
+	kfree_skb(skb);
+	return err;
+}
+
+/* The hash only covers the flow, and uses fixed seeds: all the nodes
+ * serving the same End.LB SID must pick the same backend for a flow.
+ */
+static u32 seg6_lb_hash(struct sk_buff *skb)
+{
+	struct flow_keys keys;
+	u32 hash;
+
+	skb_flow_dissect_flow_keys(skb, &keys, 0);
+
+	switch (keys.control.addr_type) {
+	case FLOW_DISSECTOR_KEY_IPV4_ADDRS:
+		hash = jhash(&keys.addrs.v4addrs, sizeof(keys.addrs.v4addrs), 0);
+		break;
+	case FLOW_DISSECTOR_KEY_IPV6_ADDRS:
+		hash = jhash(&keys.addrs.v6addrs, sizeof(keys.addrs.v6addrs), 0);
+		break;
+	default:
+		hash = 0;
+		break;
+	}
+
+	return jhash_2words(hash, (__force u32)keys.ports.ports,
+			    keys.basic.ip_proto);
+}
+
+/* make sid the active segment, the current one being kept as the next
+ * segment so that the backend still knows which service was reached.
+ * The last segment is left alone, and with it the L4 checksum.
+ */
+static int seg6_lb_insert(struct sk_buff *skb, struct ipv6_sr_hdr *srh,
+			  const struct in6_addr *sid)
+{
+	int srhoff = (unsigned char *)srh - skb->data;
+	struct ipv6hdr *hdr;
+	int off;
+
+	if (srh->hdrlen > 253 || srh->first_segment == 255)
+		return -EINVAL;
+
+	off = (unsigned char *)(srh->segments + srh->segments_left + 1) -
+	      skb->data;
+
+	if (skb_cow_head(skb, sizeof(*sid) + skb->mac_len))
+		return -ENOMEM;
+
+	skb_postpull_rcsum(skb, skb->data, off);
+
+	skb_push(skb, sizeof(*sid));
+	memmove(skb->data, skb->data + sizeof(*sid), off);
+	skb_reset_network_header(skb);
+	skb_mac_header_rebuild(skb);
+
+	srh = (struct ipv6_sr_hdr *)(skb->data + srhoff);
+	srh->segments_left++;
+	srh->segments[srh->segments_left] = *sid;
+	srh->hdrlen += 2;
+	srh->first_segment++;
+
+	hdr = ipv6_hdr(skb);
+	hdr->daddr = *sid;
+	hdr->payload_len = htons(skb->len - sizeof(*hdr));
+
+	skb_postpush_rcsum(skb, skb->data, off + sizeof(*sid));
+
+	return 0;
+}
+
+/* service endpoint: steer the flow to one of the backend SIDs */
+static int input_action_end_lb(struct sk_buff *skb,
+			       struct seg6_local_lwt *slwt)
+{
+	struct seg6_lb *lb = slwt->lb;
+	const struct in6_addr *sid;
+	struct ipv6_sr_hdr *srh;
+	int err = -EINVAL;
+	bool hmac_ok;
+
+	/* the service SID may be the last segment, in SRH mode only */
+	srh = get_srh(skb, &hmac_ok);
+	if (!srh)
+		goto drop;
+
+#ifdef CONFIG_IPV6_SEG6_HMAC
+	if (!hmac_ok && !seg6_hmac_validate_skb(skb))
+		goto drop;
+#endif
+
+	seg6_oam_sample(skb, srh);
+
+	sid = &lb->backends[lb->table[seg6_lb_hash(skb) % lb->size]].sid;
+
+	switch (lb->mode) {
+	case SEG6_LOCAL_LB_MODE_DA:
+		/* the last segment is in the L4 pseudo-header */
+		if (!srh->segments_left)
+			goto drop;
+		srh->segments[srh->segments_left] = *sid;
+		ipv6_hdr(skb)->daddr = *sid;
+		break;
+	case SEG6_LOCAL_LB_MODE_SRH:
+		err = seg6_lb_insert(skb, srh, sid);
+		if (err)
+			goto drop;
+		break;
+	}
+
+	seg6_lookup_nexthop(skb, NULL, 0);
+
+	return dst_input(skb);
+
+drop:
+	kfree_skb(skb);
+	return err;
+}
+
+/* optional attributes accepted by every behaviour */
+#define SEG6_LOCAL_COMMON_OPTATTRS	(1 << SEG6_LOCAL_POLICER)
+
+static struct seg6_action_desc seg6_action_table[] = {
+	{
+		.action		= SEG6_LOCAL_ACTION_END,
+		.attrs		= 0,
+		.input		= input_action_end,
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_X,
+		.attrs		= (1 << SEG6_LOCAL_NH6),
+		.input		= input_action_end_x,
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_T,
+		.attrs		= (1 << SEG6_LOCAL_TABLE),
+		.input		= input_action_end_t,
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_DX2,
+		.attrs		= (1 << SEG6_LOCAL_OIF),
+		.input		= input_action_end_dx2,
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_DX6,
+		.attrs		= (1 << SEG6_LOCAL_NH6),
+		.input		= input_action_end_dx6,
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_DX4,
+		.attrs		= (1 << SEG6_LOCAL_NH4),
+		.input		= input_action_end_dx4,
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_DT6,
+		.attrs		= (1 << SEG6_LOCAL_TABLE),
+		.input		= input_action_end_dt6,
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_B6,
+		.attrs		= (1 << SEG6_LOCAL_SRH),
+		.input		= input_action_end_b6,
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_B6_ENCAP,
+		.attrs		= (1 << SEG6_LOCAL_SRH),
+		.input		= input_action_end_b6_encap,
+		.static_headroom	= sizeof(struct ipv6hdr),
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_BPF,
+		.attrs		= (1 << SEG6_LOCAL_BPF),
+		.input		= input_action_end_bpf,
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_OAM,
+		.attrs		= 0,
+		.optattrs	= (1 << SEG6_LOCAL_OAM),
+		.input		= input_action_end_oam,
+	},
+	{
+		.action		= SEG6_LOCAL_ACTION_END_LB,
+		.attrs		= (1 << SEG6_LOCAL_LB),
+		.input		= input_action_end_lb,
+	},
+
+};
+
+static struct seg6_action_desc *__get_action_desc(int action)
+{
+	struct seg6_action_desc *desc;
+	int i, count;
+
+	count = ARRAY_SIZE(seg6_action_table);
+	for (i = 0; i < count; i++) {
+		desc = &seg6_action_table[i];
+		if (desc->action == action)
+			return desc;
+	}
+
+	return NULL;
+}
+
+static bool seg6_policer_conform(struct seg6_policer *pol)
+{
+	struct seg6_policer_pcpu *tb = this_cpu_ptr(pol->pcpu);
+	u64 now, toks;
+
+	now = ktime_get_ns();
+	toks = tb->tokens + min_t(u64, now - tb->t_c, pol->burst_ns);
+	if (toks > pol->burst_ns)
+		toks = pol->burst_ns;
+
+	tb->t_c = now;
+
+	if (toks >= pol->cost_ns) {
+		tb->tokens = toks - pol->cost_ns;
+		return true;
+	}
+
+	tb->tokens = toks;
+
+	u64_stats_update_begin(&tb->syncp);
+	tb->drops++;
+	u64_stats_update_end(&tb->syncp);
+
+	return false;
+}
+
+static int seg6_local_input(struct sk_buff *skb)
+{
+	struct dst_entry *orig_dst = skb_dst(skb);
+	struct seg6_action_desc *desc;
+	struct seg6_local_lwt *slwt;
+
+	if (skb->protocol != htons(ETH_P_IPV6)) {
+		kfree_skb(skb);
+		return -EINVAL;
+	}
+
+	slwt = seg6_local_lwtunnel(orig_dst->lwtstate);
+	desc = slwt->desc;
+
+	/* police before any per-behaviour work (HMAC, BPF, route lookup) */
+	if (slwt->policer && !seg6_policer_conform(slwt->policer)) {
+		kfree_skb(skb);
+		return -ENOBUFS;
+	}
+
+	return desc->input(skb, slwt);
+}
+
+static const struct nla_policy seg6_local_policy[SEG6_LOCAL_MAX + 1] = {
+	[SEG6_LOCAL_ACTION]	= { .type = NLA_U32 },
+	[SEG6_LOCAL_SRH]	= { .type = NLA_BINARY },
+	[SEG6_LOCAL_TABLE]	= { .type = NLA_U32 },
+	[SEG6_LOCAL_NH4]	= { .type = NLA_BINARY,
+				    .len = sizeof(struct in_addr) },
+	[SEG6_LOCAL_NH6]	= { .type = NLA_BINARY,
+				    .len = sizeof(struct in6_addr) },
+	[SEG6_LOCAL_IIF]	= { .type = NLA_U32 },
+	[SEG6_LOCAL_OIF]	= { .type = NLA_U32 },
+	[SEG6_LOCAL_BPF]	= { .type = NLA_NESTED },
+	[SEG6_LOCAL_OAM]	= { .type = NLA_U32 },
+	[SEG6_LOCAL_POLICER]	= { .type = NLA_NESTED },
+	[SEG6_LOCAL_LB]		= { .type = NLA_NESTED },
+};
+
+static int parse_nla_srh(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+{
+	struct ipv6_sr_hdr *srh;
+	int len;
+
+	srh = nla_data(attrs[SEG6_LOCAL_SRH]);
+	len = nla_len(attrs[SEG6_LOCAL_SRH]);
+
+	/* SRH must contain at least one segment */
+	if (len < sizeof(*srh) + sizeof(struct in6_addr))
+		return -EINVAL;
+
+	if (!seg6_validate_srh(srh, len))
+		return -EINVAL;
+
+	slwt->srh = kmalloc(len, GFP_KERNEL);
+	if (!slwt->srh)
+		return -ENOMEM;
+
+	memcpy(slwt->srh, srh, len);
+
+	slwt->headroom += len;
+
+	return 0;
+}
+
+static int put_nla_srh(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+{
 	struct ipv6_sr_hdr *srh;
 	struct nlattr *nla;
 	int len;
 
-	srh = slwt->srh;
-	len = (srh->hdrlen + 1) << 3;
+	srh = slwt->srh;
+	len = (srh->hdrlen + 1) << 3;
+
+	nla = nla_reserve(skb, SEG6_LOCAL_SRH, len);
+	if (!nla)
+		return -EMSGSIZE;
+
+	memcpy(nla_data(nla), srh, len);
+
+	return 0;
+}
+
+static int cmp_nla_srh(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+{
+	int len = (a->srh->hdrlen + 1) << 3;
+
+	if (len != ((b->srh->hdrlen + 1) << 3))
+		return 1;
+
+	return memcmp(a->srh, b->srh, len);
+}
+
+static int parse_nla_table(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+{
+	slwt->table = nla_get_u32(attrs[SEG6_LOCAL_TABLE]);
+
+	return 0;
+}
+
+static int put_nla_table(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+{
+	if (nla_put_u32(skb, SEG6_LOCAL_TABLE, slwt->table))
+		return -EMSGSIZE;
+
+	return 0;
+}
+
+static int cmp_nla_table(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+{
+	if (a->table != b->table)
+		return 1;
+
+	return 0;
+}
+
+static int parse_nla_nh4(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+{
+	memcpy(&slwt->nh4, nla_data(attrs[SEG6_LOCAL_NH4]),
+	       sizeof(struct in_addr));
+
+	return 0;
+}
+
+static int put_nla_nh4(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+{
+	struct nlattr *nla;
+
+	nla = nla_reserve(skb, SEG6_LOCAL_NH4, sizeof(struct in_addr));
+	if (!nla)
+		return -EMSGSIZE;
+
+	memcpy(nla_data(nla), &slwt->nh4, sizeof(struct in_addr));
+
+	return 0;
+}
+
+static int cmp_nla_nh4(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+{
+	return memcmp(&a->nh4, &b->nh4, sizeof(struct in_addr));
+}
+
+static int parse_nla_nh6(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+{
+	memcpy(&slwt->nh6, nla_data(attrs[SEG6_LOCAL_NH6]),
+	       sizeof(struct in6_addr));
+
+	return 0;
+}
+
+static int put_nla_nh6(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+{
+	struct nlattr *nla;
+
+	nla = nla_reserve(skb, SEG6_LOCAL_NH6, sizeof(struct in6_addr));
+	if (!nla)
+		return -EMSGSIZE;
+
+	memcpy(nla_data(nla), &slwt->nh6, sizeof(struct in6_addr));
+
+	return 0;
+}
+
+static int cmp_nla_nh6(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+{
+	return memcmp(&a->nh6, &b->nh6, sizeof(struct in6_addr));
+}
+
+static int parse_nla_iif(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+{
+	slwt->iif = nla_get_u32(attrs[SEG6_LOCAL_IIF]);
+
+	return 0;
+}
+
+static int put_nla_iif(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+{
+	if (nla_put_u32(skb, SEG6_LOCAL_IIF, slwt->iif))
+		return -EMSGSIZE;
+
+	return 0;
+}
+
+static int cmp_nla_iif(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+{
+	if (a->iif != b->iif)
+		return 1;
+
+	return 0;
+}
+
+static int parse_nla_oif(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+{
+	slwt->oif = nla_get_u32(attrs[SEG6_LOCAL_OIF]);
+
+	return 0;
+}
+
+static int put_nla_oif(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+{
+	if (nla_put_u32(skb, SEG6_LOCAL_OIF, slwt->oif))
+		return -EMSGSIZE;
+
+	return 0;
+}
+
+static int cmp_nla_oif(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+{
+	if (a->oif != b->oif)
+		return 1;
+
+	return 0;
+}
+
+#define MAX_PROG_NAME 256
+static const struct nla_policy bpf_prog_policy[SEG6_LOCAL_BPF_PROG_MAX + 1] = {
+	[SEG6_LOCAL_BPF_PROG]	   = { .type = NLA_U32, },
+	[SEG6_LOCAL_BPF_PROG_NAME] = { .type = NLA_NUL_STRING,
+				       .len = MAX_PROG_NAME },
+	[SEG6_LOCAL_BPF_PROG_CACHE] = { .type = NLA_U32, },
+	[SEG6_LOCAL_BPF_PROG_ARRAY] = { .type = NLA_U32, },
+	[SEG6_LOCAL_BPF_PROG_INDEX] = { .type = NLA_U32, },
+};
+
+/* A prog array already owned by seg6local programs, so that whatever is
+ * stored in it later has the right type.
+ */
+static int parse_nla_bpf_array(struct nlattr **tb, struct seg6_local_lwt *slwt)
+{
+	struct bpf_array *array;
+	struct bpf_map *map;
+	u32 index = 0;
+
+	if (tb[SEG6_LOCAL_BPF_PROG_INDEX])
+		index = nla_get_u32(tb[SEG6_LOCAL_BPF_PROG_INDEX]);
+
+	map = bpf_map_get_with_uref(nla_get_u32(tb[SEG6_LOCAL_BPF_PROG_ARRAY]));
+	if (IS_ERR(map))
+		return PTR_ERR(map);
+
+	if (map->map_type != BPF_MAP_TYPE_PROG_ARRAY ||
+	    index >= map->max_entries)
+		goto err_put;
+
+	array = container_of(map, struct bpf_array, map);
+	if (READ_ONCE(array->owner_prog_type) != BPF_PROG_TYPE_LWT_SEG6LOCAL)
+		goto err_put;
+
+	slwt->bpf.array = map;
+	slwt->bpf.index = index;
+	return 0;
+
+err_put:
+	bpf_map_put_with_uref(map);
+	return -EINVAL;
+}
+
+static void seg6_bpf_cache_free(struct seg6_bpf_cache *cache)
+{
+	int cpu;
+
+	if (!cache)
+		return;
+
+	for_each_possible_cpu(cpu)
+		kvfree(*per_cpu_ptr(cache->tables, cpu));
+	free_percpu(cache->tables);
+	kfree(cache);
+}
+
+static struct seg6_bpf_cache *seg6_bpf_cache_alloc(u32 size)
+{
+	struct seg6_bpf_cache *cache;
+	int cpu;
+
+	cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+	if (!cache)
+		return NULL;
+
+	cache->tables = alloc_percpu(struct seg6_bpf_cache_entry *);
+	if (!cache->tables) {
+		kfree(cache);
+		return NULL;
+	}
+
+	size = roundup_pow_of_two(size);
+	cache->mask = size - 1;
+	cache->gen = 1;
+
+	for_each_possible_cpu(cpu) {
+		struct seg6_bpf_cache_entry *table;
+
+		table = kvzalloc_node(size * sizeof(*table), GFP_KERNEL,
+				      cpu_to_node(cpu));
+		if (!table) {
+			seg6_bpf_cache_free(cache);
+			return NULL;
+		}
+		*per_cpu_ptr(cache->tables, cpu) = table;
+	}
+
+	return cache;
+}
+
+static int parse_nla_bpf(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+{
+	struct nlattr *tb[SEG6_LOCAL_BPF_PROG_MAX + 1];
+	struct bpf_prog *p;
+	u32 fd, size;
+	int ret;
+
+	ret = nla_parse_nested(tb, SEG6_LOCAL_BPF_PROG_MAX,
+			       attrs[SEG6_LOCAL_BPF], bpf_prog_policy, NULL);
+	if (ret < 0)
+		return ret;
+
+	if (!tb[SEG6_LOCAL_BPF_PROG] == !tb[SEG6_LOCAL_BPF_PROG_ARRAY] ||
+	    !tb[SEG6_LOCAL_BPF_PROG_NAME])
+		return -EINVAL;
+
+	slwt->bpf.name = nla_memdup(tb[SEG6_LOCAL_BPF_PROG_NAME], GFP_KERNEL);
+	if (!slwt->bpf.name)
+		return -ENOMEM;
+
+	if (tb[SEG6_LOCAL_BPF_PROG_CACHE]) {
+		size = nla_get_u32(tb[SEG6_LOCAL_BPF_PROG_CACHE]);
+		if (!size || size > SEG6_BPF_CACHE_MAX) {
+			kfree(slwt->bpf.name);
+			slwt->bpf.name = NULL;
+			return -EINVAL;
+		}
+
+		slwt->bpf.cache = seg6_bpf_cache_alloc(size);
+		if (!slwt->bpf.cache) {
+			kfree(slwt->bpf.name);
+			slwt->bpf.name = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	if (tb[SEG6_LOCAL_BPF_PROG_ARRAY]) {
+		ret = parse_nla_bpf_array(tb, slwt);
+		if (ret) {
+			seg6_bpf_cache_free(slwt->bpf.cache);
+			slwt->bpf.cache = NULL;
+			kfree(slwt->bpf.name);
+			slwt->bpf.name = NULL;
+		}
+		return ret;
+	}
+
+	fd = nla_get_u32(tb[SEG6_LOCAL_BPF_PROG]);
+	p = bpf_prog_get_type(fd, BPF_PROG_TYPE_LWT_SEG6LOCAL);
+	if (IS_ERR(p)) {
+		seg6_bpf_cache_free(slwt->bpf.cache);
+		slwt->bpf.cache = NULL;
+		kfree(slwt->bpf.name);
+		slwt->bpf.name = NULL;
+		return PTR_ERR(p);
+	}
+
+	slwt->bpf.prog = p;
+	return 0;
+}
 
-	nla = nla_reserve(skb, SEG6_LOCAL_SRH, len);
-	if (!nla)
+static int put_nla_bpf(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+{
+	struct bpf_prog *prog;
+	struct nlattr *nest;
+	u32 id = 0;
+
+	if (!slwt->bpf.prog && !slwt->bpf.array)
+		return 0;
+
+	nest = nla_nest_start(skb, SEG6_LOCAL_BPF);
+	if (!nest)
 		return -EMSGSIZE;
 
-	memcpy(nla_data(nla), srh, len);
+	/* the program currently in use, if any */
+	rcu_read_lock();
+	prog = seg6_bpf_prog(slwt);
+	if (prog)
+		id = prog->aux->id;
+	rcu_read_unlock();
 
-	return 0;
+	if (nla_put_u32(skb, SEG6_LOCAL_BPF_PROG, id))
+		return -EMSGSIZE;
+
+	if (slwt->bpf.array &&
+	    (nla_put_u32(skb, SEG6_LOCAL_BPF_PROG_ARRAY, slwt->bpf.array->id) ||
+	     nla_put_u32(skb, SEG6_LOCAL_BPF_PROG_INDEX, slwt->bpf.index)))
+		return -EMSGSIZE;
+
+	if (slwt->bpf.name &&
+	    nla_put_string(skb, SEG6_LOCAL_BPF_PROG_NAME, slwt->bpf.name))
+		return -EMSGSIZE;
+
+	if (slwt->bpf.cache &&
+	    nla_put_u32(skb, SEG6_LOCAL_BPF_PROG_CACHE,
+			slwt->bpf.cache->mask + 1))
+		return -EMSGSIZE;
+
+	return nla_nest_end(skb, nest);
 }
 
-static int cmp_nla_srh(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+static int cmp_nla_bpf(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
 {
-	int len = (a->srh->hdrlen + 1) << 3;
+	if (a->bpf.array != b->bpf.array || a->bpf.index != b->bpf.index)
+		return 1;
 
-	if (len != ((b->srh->hdrlen + 1) << 3))
+	if (!a->bpf.cache != !b->bpf.cache)
 		return 1;
 
-	return memcmp(a->srh, b->srh, len);
+	if (a->bpf.cache && a->bpf.cache->mask != b->bpf.cache->mask)
+		return 1;
+
+	if (!a->bpf.name && !b->bpf.name)
+		return 0;
+
+	if (!a->bpf.name || !b->bpf.name)
+		return 1;
+
+	return strcmp(a->bpf.name, b->bpf.name);
 }
 
-static int parse_nla_table(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+static int parse_nla_oam(struct nlattr **attrs, struct seg6_local_lwt *slwt)
 {
-	slwt->table = nla_get_u32(attrs[SEG6_LOCAL_TABLE]);
+	slwt->oam_flags = nla_get_u32(attrs[SEG6_LOCAL_OAM]);
+
+	if (slwt->oam_flags & ~SEG6_LOCAL_OAM_TSTAMP)
+		return -EINVAL;
 
 	return 0;
 }
 
-static int put_nla_table(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+static int put_nla_oam(struct sk_buff *skb, struct seg6_local_lwt *slwt)
 {
-	if (nla_put_u32(skb, SEG6_LOCAL_TABLE, slwt->table))
+	if (nla_put_u32(skb, SEG6_LOCAL_OAM, slwt->oam_flags))
 		return -EMSGSIZE;
 
 	return 0;
 }
 
-static int cmp_nla_table(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+static int cmp_nla_oam(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
 {
-	if (a->table != b->table)
+	if (a->oam_flags != b->oam_flags)
 		return 1;
 
 	return 0;
 }
 
-static int parse_nla_nh4(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+static const struct nla_policy
+seg6_policer_policy[SEG6_LOCAL_POLICER_MAX + 1] = {
+	[SEG6_LOCAL_POLICER_RATE]	= { .type = NLA_U32 },
+	[SEG6_LOCAL_POLICER_BURST]	= { .type = NLA_U32 },
+	[SEG6_LOCAL_POLICER_DROPS]	= { .type = NLA_U64 },
+};
+
+static void seg6_policer_free(struct seg6_policer *pol)
 {
-	memcpy(&slwt->nh4, nla_data(attrs[SEG6_LOCAL_NH4]),
-	       sizeof(struct in_addr));
+	if (!pol)
+		return;
 
-	return 0;
+	free_percpu(pol->pcpu);
+	kfree(pol);
 }
 
-static int put_nla_nh4(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+static int parse_nla_policer(struct nlattr **attrs, struct seg6_local_lwt *slwt)
 {
-	struct nlattr *nla;
+	struct nlattr *tb[SEG6_LOCAL_POLICER_MAX + 1];
+	struct seg6_policer *pol;
+	u64 now;
+	int ret, cpu;
+
+	ret = nla_parse_nested(tb, SEG6_LOCAL_POLICER_MAX,
+			       attrs[SEG6_LOCAL_POLICER], seg6_policer_policy,
+			       NULL);
+	if (ret < 0)
+		return ret;
 
-	nla = nla_reserve(skb, SEG6_LOCAL_NH4, sizeof(struct in_addr));
-	if (!nla)
-		return -EMSGSIZE;
+	if (!tb[SEG6_LOCAL_POLICER_RATE] || !tb[SEG6_LOCAL_POLICER_BURST])
+		return -EINVAL;
 
-	memcpy(nla_data(nla), &slwt->nh4, sizeof(struct in_addr));
+	pol = kzalloc(sizeof(*pol), GFP_KERNEL);
+	if (!pol)
+		return -ENOMEM;
 
-	return 0;
-}
+	pol->rate = nla_get_u32(tb[SEG6_LOCAL_POLICER_RATE]);
+	pol->burst = nla_get_u32(tb[SEG6_LOCAL_POLICER_BURST]);
+	/* a packet must cost at least a nanosecond of tokens */
+	if (!pol->rate || pol->rate > NSEC_PER_SEC || !pol->burst) {
+		kfree(pol);
+		return -EINVAL;
+	}
 
-static int cmp_nla_nh4(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
-{
-	return memcmp(&a->nh4, &b->nh4, sizeof(struct in_addr));
-}
+	pol->cost_ns = div_u64(NSEC_PER_SEC, pol->rate);
+	pol->burst_ns = pol->cost_ns * pol->burst;
 
-static int parse_nla_nh6(struct nlattr **attrs, struct seg6_local_lwt *slwt)
-{
-	memcpy(&slwt->nh6, nla_data(attrs[SEG6_LOCAL_NH6]),
-	       sizeof(struct in6_addr));
+	pol->pcpu = alloc_percpu(struct seg6_policer_pcpu);
+	if (!pol->pcpu) {
+		kfree(pol);
+		return -ENOMEM;
+	}
+
+	/* start with a full bucket on every CPU */
+	now = ktime_get_ns();
+	for_each_possible_cpu(cpu) {
+		struct seg6_policer_pcpu *b = per_cpu_ptr(pol->pcpu, cpu);
+
+		b->tokens = pol->burst_ns;
+		b->t_c = now;
+		u64_stats_init(&b->syncp);
+	}
 
+	slwt->policer = pol;
 	return 0;
 }
 
-static int put_nla_nh6(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+static u64 seg6_policer_drops(struct seg6_policer *pol)
 {
-	struct nlattr *nla;
+	u64 drops = 0;
+	int cpu;
 
-	nla = nla_reserve(skb, SEG6_LOCAL_NH6, sizeof(struct in6_addr));
-	if (!nla)
-		return -EMSGSIZE;
+	for_each_possible_cpu(cpu) {
+		struct seg6_policer_pcpu *tb = per_cpu_ptr(pol->pcpu, cpu);
+		unsigned int start;
+		u64 val;
 
-	memcpy(nla_data(nla), &slwt->nh6, sizeof(struct in6_addr));
+		do {
+			start = u64_stats_fetch_begin_irq(&tb->syncp);
+			val = tb->drops;
+		} while (u64_stats_fetch_retry_irq(&tb->syncp, start));
 
-	return 0;
+		drops += val;
+	}
+
+	return drops;
 }
 
-static int cmp_nla_nh6(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+static int put_nla_policer(struct sk_buff *skb, struct seg6_local_lwt *slwt)
 {
-	return memcmp(&a->nh6, &b->nh6, sizeof(struct in6_addr));
+	struct seg6_policer *pol = slwt->policer;
+	struct nlattr *nest;
+
+	nest = nla_nest_start(skb, SEG6_LOCAL_POLICER);
+	if (!nest)
+		return -EMSGSIZE;
+
+	if (nla_put_u32(skb, SEG6_LOCAL_POLICER_RATE, pol->rate) ||
+	    nla_put_u32(skb, SEG6_LOCAL_POLICER_BURST, pol->burst) ||
+	    nla_put_u64_64bit(skb, SEG6_LOCAL_POLICER_DROPS,
+			      seg6_policer_drops(pol), SEG6_LOCAL_POLICER_PAD))
+		return -EMSGSIZE;
+
+	return nla_nest_end(skb, nest);
 }
 
-static int parse_nla_iif(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+static int cmp_nla_policer(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
 {
-	slwt->iif = nla_get_u32(attrs[SEG6_LOCAL_IIF]);
+	if (a->policer->rate != b->policer->rate ||
+	    a->policer->burst != b->policer->burst)
+		return 1;
 
 	return 0;
 }
 
-static int put_nla_iif(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+/* bound the cost of seg6_lb_populate(), which runs under RTNL */
+#define SEG6_LB_TABLE_MAX	(1 << 18)
+#define SEG6_LB_WEIGHT_MAX	256
+
+static const struct nla_policy seg6_lb_policy[SEG6_LOCAL_LB_MAX + 1] = {
+	[SEG6_LOCAL_LB_MODE]		= { .type = NLA_U32 },
+	[SEG6_LOCAL_LB_TABLE_SIZE]	= { .type = NLA_U32 },
+	[SEG6_LOCAL_LB_BACKENDS]	= { .type = NLA_NESTED },
+};
+
+static const struct nla_policy
+seg6_lb_backend_policy[SEG6_LOCAL_LB_BACKEND_MAX + 1] = {
+	[SEG6_LOCAL_LB_BACKEND_SID]	= { .type = NLA_BINARY,
+					    .len = sizeof(struct in6_addr) },
+	[SEG6_LOCAL_LB_BACKEND_WEIGHT]	= { .type = NLA_U32 },
+};
+
+static void seg6_lb_free(struct seg6_lb *lb)
 {
-	if (nla_put_u32(skb, SEG6_LOCAL_IIF, slwt->iif))
-		return -EMSGSIZE;
+	if (!lb)
+		return;
 
-	return 0;
+	kvfree(lb->table);
+	kfree(lb);
 }
 
-static int cmp_nla_iif(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+static bool seg6_lb_is_prime(u32 n)
 {
-	if (a->iif != b->iif)
-		return 1;
+	u32 i;
 
-	return 0;
+	if (n < 2)
+		return false;
+
+	for (i = 2; i * i <= n; i++) {
+		if (!(n % i))
+			return false;
+	}
+
+	return true;
 }
 
-static int parse_nla_oif(struct nlattr **attrs, struct seg6_local_lwt *slwt)
+/* Maglev population (Eisenbud et al., NSDI 2016). Every backend walks
+ * its own permutation of the slots, derived from its SID only, and
+ * claims the next free one in turn; weights set how many turns a
+ * backend gets per round. Changing the backend set thus only moves a
+ * small share of the slots.
+ */
+static int seg6_lb_populate(struct seg6_lb *lb)
 {
-	slwt->oif = nla_get_u32(attrs[SEG6_LOCAL_OIF]);
+	u32 *offset, *skip, *next, *credit;
+	u32 i, filled = 0, wmax = 0;
+	int err = -ENOMEM;
 
-	return 0;
+	offset = kcalloc(lb->nr, 4 * sizeof(u32), GFP_KERNEL);
+	if (!offset)
+		return err;
+
+	skip = offset + lb->nr;
+	next = skip + lb->nr;
+	credit = next + lb->nr;
+
+	lb->table = kvmalloc_array(lb->size, sizeof(*lb->table), GFP_KERNEL);
+	if (!lb->table)
+		goto out;
+
+	memset(lb->table, 0xff, lb->size * sizeof(*lb->table));
+
+	for (i = 0; i < lb->nr; i++) {
+		const u32 *sid = lb->backends[i].sid.s6_addr32;
+
+		offset[i] = jhash2(sid, 4, 0) % lb->size;
+		skip[i] = jhash2(sid, 4, 1) % (lb->size - 1) + 1;
+		wmax = max(wmax, lb->backends[i].weight);
+	}
+
+	while (filled < lb->size) {
+		for (i = 0; i < lb->nr && filled < lb->size; i++) {
+			credit[i] += lb->backends[i].weight;
+			if (credit[i] < wmax)
+				continue;
+			credit[i] -= wmax;
+
+			for (;;) {
+				u32 slot = (offset[i] + (u64)next[i] * skip[i]) %
+					   lb->size;
+
+				next[i]++;
+				if (lb->table[slot] == 0xffff) {
+					lb->table[slot] = i;
+					filled++;
+					break;
+				}
+			}
+		}
+	}
+
+	err = 0;
+out:
+	kfree(offset);
+	return err;
 }
 
-static int put_nla_oif(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+static int seg6_lb_parse_backend(struct seg6_lb *lb, struct nlattr *nla)
 {
-	if (nla_put_u32(skb, SEG6_LOCAL_OIF, slwt->oif))
-		return -EMSGSIZE;
+	struct nlattr *tb[SEG6_LOCAL_LB_BACKEND_MAX + 1];
+	struct seg6_lb_backend *be;
+	int err;
+
+	err = nla_parse_nested(tb, SEG6_LOCAL_LB_BACKEND_MAX, nla,
+			       seg6_lb_backend_policy, NULL);
+	if (err < 0)
+		return err;
+
+	if (!tb[SEG6_LOCAL_LB_BACKEND_SID] ||
+	    nla_len(tb[SEG6_LOCAL_LB_BACKEND_SID]) != sizeof(struct in6_addr))
+		return -EINVAL;
+
+	be = &lb->backends[lb->nr];
+	memcpy(&be->sid, nla_data(tb[SEG6_LOCAL_LB_BACKEND_SID]),
+	       sizeof(struct in6_addr));
+
+	be->weight = 1;
+	if (tb[SEG6_LOCAL_LB_BACKEND_WEIGHT])
+		be->weight = nla_get_u32(tb[SEG6_LOCAL_LB_BACKEND_WEIGHT]);
+
+	if (!be->weight || be->weight > SEG6_LB_WEIGHT_MAX)
+		return -EINVAL;
+
+	lb->nr++;
 
 	return 0;
 }
 
-static int cmp_nla_oif(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+static int parse_nla_lb(struct nlattr **attrs, struct seg6_local_lwt *slwt)
 {
-	if (a->oif != b->oif)
-		return 1;
+	struct nlattr *tb[SEG6_LOCAL_LB_MAX + 1];
+	u32 mode = SEG6_LOCAL_LB_MODE_DA;
+	u32 size = SEG6_LOCAL_LB_TABLE_DEFAULT;
+	struct nlattr *attr;
+	struct seg6_lb *lb;
+	int rem, count = 0;
+	int err;
 
-	return 0;
-}
+	err = nla_parse_nested(tb, SEG6_LOCAL_LB_MAX, attrs[SEG6_LOCAL_LB],
+			       seg6_lb_policy, NULL);
+	if (err < 0)
+		return err;
 
-#define MAX_PROG_NAME 256
-static const struct nla_policy bpf_prog_policy[SEG6_LOCAL_BPF_PROG_MAX + 1] = {
-	[SEG6_LOCAL_BPF_PROG]	   = { .type = NLA_U32, },
-	[SEG6_LOCAL_BPF_PROG_NAME] = { .type = NLA_NUL_STRING,
-				       .len = MAX_PROG_NAME },
-};
+	if (!tb[SEG6_LOCAL_LB_BACKENDS])
+		return -EINVAL;
 
-static int parse_nla_bpf(struct nlattr **attrs, struct seg6_local_lwt *slwt)
-{
-	struct nlattr *tb[SEG6_LOCAL_BPF_PROG_MAX + 1];
-	struct bpf_prog *p;
-	int ret;
-	u32 fd;
+	if (tb[SEG6_LOCAL_LB_MODE])
+		mode = nla_get_u32(tb[SEG6_LOCAL_LB_MODE]);
 
-	ret = nla_parse_nested(tb, SEG6_LOCAL_BPF_PROG_MAX,
-			       attrs[SEG6_LOCAL_BPF], bpf_prog_policy, NULL);
-	if (ret < 0)
-		return ret;
+	if (mode != SEG6_LOCAL_LB_MODE_DA && mode != SEG6_LOCAL_LB_MODE_SRH)
+		return -EINVAL;
+
+	if (tb[SEG6_LOCAL_LB_TABLE_SIZE])
+		size = nla_get_u32(tb[SEG6_LOCAL_LB_TABLE_SIZE]);
 
-	if (!tb[SEG6_LOCAL_BPF_PROG] || !tb[SEG6_LOCAL_BPF_PROG_NAME])
+	if (size > SEG6_LB_TABLE_MAX || !seg6_lb_is_prime(size))
 		return -EINVAL;
 
-	slwt->bpf.name = nla_memdup(tb[SEG6_LOCAL_BPF_PROG_NAME], GFP_KERNEL);
-	if (!slwt->bpf.name)
+	nla_for_each_nested(attr, tb[SEG6_LOCAL_LB_BACKENDS], rem) {
+		if (nla_type(attr) != SEG6_LOCAL_LB_BACKEND)
+			return -EINVAL;
+		count++;
+	}
+
+	if (!count || count > SEG6_LOCAL_LB_BACKENDS_MAX || count > size)
+		return -EINVAL;
+
+	lb = kzalloc(sizeof(*lb) + count * sizeof(struct seg6_lb_backend),
+		     GFP_KERNEL);
+	if (!lb)
 		return -ENOMEM;
 
-	fd = nla_get_u32(tb[SEG6_LOCAL_BPF_PROG]);
-	p = bpf_prog_get_type(fd, BPF_PROG_TYPE_LWT_SEG6LOCAL);
-	if (IS_ERR(p)) {
-		kfree(slwt->bpf.name);
-		return PTR_ERR(p);
+	lb->mode = mode;
+	lb->size = size;
+
+	nla_for_each_nested(attr, tb[SEG6_LOCAL_LB_BACKENDS], rem) {
+		err = seg6_lb_parse_backend(lb, attr);
+		if (err)
+			goto err_free;
 	}
 
-	slwt->bpf.prog = p;
+	err = seg6_lb_populate(lb);
+	if (err)
+		goto err_free;
+
+	if (mode == SEG6_LOCAL_LB_MODE_SRH)
+		slwt->headroom += sizeof(struct in6_addr);
+
+	slwt->lb = lb;
 	return 0;
+
+err_free:
+	seg6_lb_free(lb);
+	return err;
 }
 
-static int put_nla_bpf(struct sk_buff *skb, struct seg6_local_lwt *slwt)
+static int put_nla_lb(struct sk_buff *skb, struct seg6_local_lwt *slwt)
 {
-	struct nlattr *nest;
-
-	if (!slwt->bpf.prog)
-		return 0;
+	struct seg6_lb *lb = slwt->lb;
+	struct nlattr *nest, *list, *entry;
+	int i;
 
-	nest = nla_nest_start(skb, SEG6_LOCAL_BPF);
+	nest = nla_nest_start(skb, SEG6_LOCAL_LB);
 	if (!nest)
 		return -EMSGSIZE;
 
-	if (nla_put_u32(skb, SEG6_LOCAL_BPF_PROG, slwt->bpf.prog->aux->id))
+	if (nla_put_u32(skb, SEG6_LOCAL_LB_MODE, lb->mode) ||
+	    nla_put_u32(skb, SEG6_LOCAL_LB_TABLE_SIZE, lb->size))
 		return -EMSGSIZE;
 
-	if (slwt->bpf.name &&
-	    nla_put_string(skb, SEG6_LOCAL_BPF_PROG_NAME, slwt->bpf.name))
+	list = nla_nest_start(skb, SEG6_LOCAL_LB_BACKENDS);
+	if (!list)
 		return -EMSGSIZE;
 
+	for (i = 0; i < lb->nr; i++) {
+		entry = nla_nest_start(skb, SEG6_LOCAL_LB_BACKEND);
+		if (!entry)
+			return -EMSGSIZE;
+
+		if (nla_put(skb, SEG6_LOCAL_LB_BACKEND_SID,
+			    sizeof(struct in6_addr), &lb->backends[i].sid) ||
+		    nla_put_u32(skb, SEG6_LOCAL_LB_BACKEND_WEIGHT,
+				lb->backends[i].weight))
+			return -EMSGSIZE;
+
+		nla_nest_end(skb, entry);
+	}
+
+	nla_nest_end(skb, list);
+
 	return nla_nest_end(skb, nest);
 }
 
-static int cmp_nla_bpf(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
+static int cmp_nla_lb(struct seg6_local_lwt *a, struct seg6_local_lwt *b)
 {
-	if (!a->bpf.name && !b->bpf.name)
-		return 0;
+	struct seg6_lb *lb_a = a->lb, *lb_b = b->lb;
 
-	if (!a->bpf.name || !b->bpf.name)
+	if (lb_a->mode != lb_b->mode || lb_a->size != lb_b->size ||
+	    lb_a->nr != lb_b->nr)
 		return 1;
 
-	return strcmp(a->bpf.name, b->bpf.name);
+	return memcmp(lb_a->backends, lb_b->backends,
+		      lb_a->nr * sizeof(struct seg6_lb_backend));
 }
 
 struct seg6_action_param {
@@ -917,12 +2167,25 @@ static struct seg6_action_param seg6_action_params[SEG6_LOCAL_MAX + 1] = {
 				    .put = put_nla_bpf,
 				    .cmp = cmp_nla_bpf },
 
+	[SEG6_LOCAL_OAM]	= { .parse = parse_nla_oam,
+				    .put = put_nla_oam,
+				    .cmp = cmp_nla_oam },
+
+	[SEG6_LOCAL_POLICER]	= { .parse = parse_nla_policer,
+				    .put = put_nla_policer,
+				    .cmp = cmp_nla_policer },
+
+	[SEG6_LOCAL_LB]		= { .parse = parse_nla_lb,
+				    .put = put_nla_lb,
+				    .cmp = cmp_nla_lb },
+
 };
 
 static int parse_nla_action(struct nlattr **attrs, struct seg6_local_lwt *slwt)
 {
 	struct seg6_action_param *param;
 	struct seg6_action_desc *desc;
+	unsigned long optattrs;
 	int i, err;
 
 	desc = __get_action_desc(slwt->action);
@@ -948,9 +2211,42 @@ static int parse_nla_action(struct nlattr **attrs, struct seg6_local_lwt *slwt)
 		}
 	}
 
+	optattrs = desc->optattrs | SEG6_LOCAL_COMMON_OPTATTRS;
+
+	/* optional attributes are parsed only when supplied */
+	for (i = 0; i < SEG6_LOCAL_MAX + 1; i++) {
+		if (!(optattrs & (1 << i)) || !attrs[i])
+			continue;
+
+		param = &seg6_action_params[i];
+
+		err = param->parse(attrs, slwt);
+		if (err < 0)
+			return err;
+
+		slwt->parsed_optattrs |= (1 << i);
+	}
+
 	return 0;
 }
 
+/* releases whatever the attributes parsed so far hold, either when the
+ * route goes away or when building its state failed half way
+ */
+static void seg6_local_release(struct seg6_local_lwt *slwt)
+{
+	kfree(slwt->srh);
+	seg6_policer_free(slwt->policer);
+	seg6_lb_free(slwt->lb);
+
+	kfree(slwt->bpf.name);
+	if (slwt->bpf.prog)
+		bpf_prog_put(slwt->bpf.prog);
+	if (slwt->bpf.array)
+		bpf_map_put_with_uref(slwt->bpf.array);
+	seg6_bpf_cache_free(slwt->bpf.cache);
+}
+
 static int seg6_local_build_state(struct nlattr *nla, unsigned int family,
 				  const void *cfg, struct lwtunnel_state **ts,
 				  struct netlink_ext_ack *extack)
@@ -991,23 +2287,14 @@ static int seg6_local_build_state(struct nlattr *nla, unsigned int family,
 	return 0;
 
 out_free:
-	kfree(slwt->srh);
+	seg6_local_release(slwt);
 	kfree(newts);
 	return err;
 }
 
 static void seg6_local_destroy_state(struct lwtunnel_state *lwt)
 {
-	struct seg6_local_lwt *slwt = seg6_local_lwtunnel(lwt);
-
-	kfree(slwt->srh);
-
-	if (slwt->desc->attrs & (1 << SEG6_LOCAL_BPF)) {
-		kfree(slwt->bpf.name);
-		bpf_prog_put(slwt->bpf.prog);
-	}
-
-	return;
+	seg6_local_release(seg6_local_lwtunnel(lwt));
 }
 
 static int seg6_local_fill_encap(struct sk_buff *skb,
@@ -1021,7 +2308,7 @@ static int seg6_local_fill_encap(struct sk_buff *skb,
 		return -EMSGSIZE;
 
 	for (i = 0; i < SEG6_LOCAL_MAX + 1; i++) {
-		if (slwt->desc->attrs & (1 << i)) {
+		if (seg6_local_attrs(slwt) & (1 << i)) {
 			param = &seg6_action_params[i];
 			err = param->put(skb, slwt);
 			if (err < 0)
@@ -1040,7 +2327,7 @@ static int seg6_local_get_encap_size(struct lwtunnel_state *lwt)
 
 	nlsize = nla_total_size(4); /* action */
 
-	attrs = slwt->desc->attrs;
+	attrs = seg6_local_attrs(slwt);
 
 	if (attrs & (1 << SEG6_LOCAL_SRH))
 		nlsize += nla_total_size((slwt->srh->hdrlen + 1) << 3);
@@ -1063,8 +2350,29 @@ static int seg6_local_get_encap_size(struct lwtunnel_state *lwt)
 	if (attrs & (1 << SEG6_LOCAL_BPF))
 		nlsize += nla_total_size(sizeof(struct nlattr)) +
 		       nla_total_size(MAX_PROG_NAME) +
+		       nla_total_size(4) +
+		       nla_total_size(4) +
+		       nla_total_size(4) +
 		       nla_total_size(4);
 
+	if (attrs & (1 << SEG6_LOCAL_OAM))
+		nlsize += nla_total_size(4);
+
+	if (attrs & (1 << SEG6_LOCAL_POLICER))
+		nlsize += nla_total_size(0) +
+		       nla_total_size(4) +
+		       nla_total_size(4) +
+		       nla_total_size_64bit(8);
+
+	if (attrs & (1 << SEG6_LOCAL_LB))
+		nlsize += nla_total_size(0) +	/* SEG6_LOCAL_LB */
+		       nla_total_size(4) +
+		       nla_total_size(4) +
+		       nla_total_size(0) +	/* SEG6_LOCAL_LB_BACKENDS */
+		       slwt->lb->nr * (nla_total_size(0) +
+				       nla_total_size(16) +
+				       nla_total_size(4));
+
 	return nlsize;
 }
 
@@ -1081,11 +2389,11 @@ static int seg6_local_cmp_encap(struct lwtunnel_state *a,
 	if (slwt_a->action != slwt_b->action)
 		return 1;
 
-	if (slwt_a->desc->attrs != slwt_b->desc->attrs)
+	if (seg6_local_attrs(slwt_a) != seg6_local_attrs(slwt_b))
 		return 1;
 
 	for (i = 0; i < SEG6_LOCAL_MAX + 1; i++) {
-		if (slwt_a->desc->attrs & (1 << i)) {
+		if (seg6_local_attrs(slwt_a) & (1 << i)) {
 			param = &seg6_action_params[i];
 			if (param->cmp(slwt_a, slwt_b))
 				return 1;
@@ -1095,6 +2403,24 @@ static int seg6_local_cmp_encap(struct lwtunnel_state *a,
 	return 0;
 }
 
+void seg6_local_offload_fill(struct lwtunnel_state *lwt,
+			     struct seg6_local_offload *local)
+{
+	struct seg6_local_lwt *slwt = seg6_local_lwtunnel(lwt);
+
+	local->action = slwt->action;
+	local->srh = slwt->srh;
+	local->table = slwt->table;
+	local->nh4 = slwt->nh4;
+	local->nh6 = slwt->nh6;
+	local->iif = slwt->iif;
+	local->oif = slwt->oif;
+
+	/* optional behaviours on top of the action only exist in software */
+	local->sw_only = slwt->bpf.prog || slwt->bpf.array || slwt->oam_flags ||
+			 slwt->policer || slwt->lb;
+}
+
 static const struct lwtunnel_encap_ops seg6_local_ops = {
 	.build_state	= seg6_local_build_state,
 	.destroy_state	= seg6_local_destroy_state,
@@ -6,6 +6,7 @@
 #include <linux/netdevice.h>
 #include <net/ip.h>
 #include <net/ip6_route.h>
+#include <net/lwtunnel.h>
 #include <net/netfilter/nf_tables.h>
 #include <net/netfilter/nf_flow_table.h>
 #include <net/netfilter/nf_conntrack.h>
@@ -21,7 +22,7 @@ struct flow_offload_entry {
 static DEFINE_MUTEX(flowtable_lock);
 static LIST_HEAD(flowtables);
 
-static void
+static int
 flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
 		      struct nf_flow_route *route,
 		      enum flow_offload_tuple_dir dir)
@@ -53,6 +54,21 @@ flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
 	ft->iifidx = route->tuple[dir].ifindex;
 	ft->oifidx = route->tuple[!dir].ifindex;
 	ft->dst_cache = dst;
+
+	/* The fast path transmits to the neighbour, bypassing dst_output(),
+	 * so lwtunnel encaps must be replayed from a template or the flow
+	 * stays on the slow path.
+	 */
+	if (lwtunnel_output_redirect(dst->lwtstate) ||
+	    lwtunnel_xmit_redirect(dst->lwtstate)) {
+		ft->encap = lwtunnel_get_encap_tmpl(dst, ft->l3proto);
+		if (!ft->encap)
+			return -EOPNOTSUPP;
+
+		ft->mtu = min(ft->mtu, ft->encap->mtu);
+	}
+
+	return 0;
 }
 
 struct flow_offload *
@@ -79,8 +95,9 @@ flow_offload_alloc(struct nf_conn *ct, struct nf_flow_route *route)
 
 	entry->ct = ct;
 
-	flow_offload_fill_dir(flow, ct, route, FLOW_OFFLOAD_DIR_ORIGINAL);
-	flow_offload_fill_dir(flow, ct, route, FLOW_OFFLOAD_DIR_REPLY);
+	if (flow_offload_fill_dir(flow, ct, route, FLOW_OFFLOAD_DIR_ORIGINAL) < 0 ||
+	    flow_offload_fill_dir(flow, ct, route, FLOW_OFFLOAD_DIR_REPLY) < 0)
+		goto err_fill_dir;
 
 	if (ct->status & IPS_SRC_NAT)
 		flow->flags |= FLOW_OFFLOAD_SNAT;
@@ -89,6 +106,9 @@ flow_offload_alloc(struct nf_conn *ct, struct nf_flow_route *route)
 
 	return flow;
 
+err_fill_dir:
+	lwtunnel_encap_tmpl_free(flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.encap);
+	dst_release(route->tuple[FLOW_OFFLOAD_DIR_REPLY].dst);
 err_dst_cache_reply:
 	dst_release(route->tuple[FLOW_OFFLOAD_DIR_ORIGINAL].dst);
 err_dst_cache_original:
@@ -143,6 +163,8 @@ void flow_offload_free(struct flow_offload *flow)
 
 	dst_release(flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.dst_cache);
 	dst_release(flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.dst_cache);
+	lwtunnel_encap_tmpl_free(flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.encap);
+	lwtunnel_encap_tmpl_free(flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.encap);
 	e = container_of(flow, struct flow_offload_entry, flow);
 	if (flow->flags & FLOW_OFFLOAD_DYING)
 		nf_ct_delete(e->ct, 0, 0);
@@ -478,6 +500,12 @@ int nf_flow_table_init(struct nf_flowtable *flowtable)
 }
 EXPORT_SYMBOL_GPL(nf_flow_table_init);
 
+static bool flow_offload_encap_dev(const struct flow_offload_tuple *tuple,
+				   const struct net_device *dev)
+{
+	return tuple->encap && tuple->encap->dst->dev == dev;
+}
+
 static void nf_flow_table_do_cleanup(struct flow_offload *flow, void *data)
 {
 	struct net_device *dev = data;
@@ -488,7 +516,9 @@ static void nf_flow_table_do_cleanup(struct flow_offload *flow, void *data)
 	}
 
 	if (flow->tuplehash[0].tuple.iifidx == dev->ifindex ||
-	    flow->tuplehash[1].tuple.iifidx == dev->ifindex)
+	    flow->tuplehash[1].tuple.iifidx == dev->ifindex ||
+	    flow_offload_encap_dev(&flow->tuplehash[0].tuple, dev) ||
+	    flow_offload_encap_dev(&flow->tuplehash[1].tuple, dev))
 		flow_offload_dead(flow);
 }
 
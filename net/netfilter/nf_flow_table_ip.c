@@ -9,6 +9,8 @@
 #include <net/ip.h>
 #include <net/ipv6.h>
 #include <net/ip6_route.h>
+#include <net/ip_tunnels.h>
+#include <net/lwtunnel.h>
 #include <net/neighbour.h>
 #include <net/netfilter/nf_flow_table.h>
 /* For layer 4 checksum field offset. */
@@ -210,6 +212,67 @@ static bool nf_flow_exceeds_mtu(const struct sk_buff *skb, unsigned int mtu)
 	return true;
 }
 
+/* Push the outer headers of an encapsulated flow and transmit the result
+ * along the outer route. The inner packet has already been forwarded;
+ * flowinfo and hop_limit are its resulting fields, which the template
+ * may inherit.
+ */
+static unsigned int nf_flow_encap_xmit(struct sk_buff *skb,
+				       const struct lwtunnel_encap_tmpl *tmpl,
+				       unsigned int thoff, __be32 flowinfo,
+				       u8 hop_limit)
+{
+	struct rt6_info *rt = (struct rt6_info *)tmpl->dst;
+	struct net_device *outdev = tmpl->dst->dev;
+	struct in6_addr *nexthop;
+	struct ipv6hdr *hdr;
+	__be32 *outer;
+	u32 hash = 0;
+
+	if (iptunnel_handle_offloads(skb, SKB_GSO_IPXIP6))
+		return NF_DROP;
+
+	if (skb_cow_head(skb, tmpl->len + LL_RESERVED_SPACE(outdev)))
+		return NF_DROP;
+
+	/* hash the inner packet, as the encap output path does */
+	if (tmpl->flags & LWTUNNEL_TMPL_HASH_FLOWLABEL)
+		hash = skb_get_hash(skb);
+
+	/* the hook runs before the transport header is set */
+	skb_set_inner_transport_header(skb, thoff);
+	skb_set_inner_protocol(skb, skb->protocol);
+
+	skb_push(skb, tmpl->len);
+	skb_reset_network_header(skb);
+	skb_set_transport_header(skb, sizeof(*hdr));
+	memcpy(skb->data, tmpl->data, tmpl->len);
+
+	hdr = ipv6_hdr(skb);
+	outer = (__be32 *)hdr;
+	if (tmpl->flags & LWTUNNEL_TMPL_INHERIT_DSFIELD)
+		*outer = (*outer & ~IPV6_TCLASS_MASK) |
+			 (flowinfo & IPV6_TCLASS_MASK);
+	if (tmpl->flags & LWTUNNEL_TMPL_INHERIT_FLOWLABEL)
+		*outer = (*outer & ~IPV6_FLOWLABEL_MASK) |
+			 (flowinfo & IPV6_FLOWLABEL_MASK);
+	if (tmpl->flags & LWTUNNEL_TMPL_HASH_FLOWLABEL)
+		*outer = (*outer & ~IPV6_FLOWLABEL_MASK) |
+			 ((__force __be32)hash & IPV6_FLOWLABEL_MASK);
+	if (tmpl->flags & LWTUNNEL_TMPL_INHERIT_HOPLIMIT)
+		hdr->hop_limit = hop_limit;
+
+	skb_postpush_rcsum(skb, hdr, tmpl->len);
+	hdr->payload_len = htons(skb->len - sizeof(*hdr));
+
+	skb->protocol = tmpl->protocol;
+	skb->dev = outdev;
+	nexthop = rt6_nexthop(rt, &hdr->daddr);
+	neigh_xmit(NEIGH_ND_TABLE, outdev, nexthop, skb);
+
+	return NF_STOLEN;
+}
+
 unsigned int
 nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 			const struct nf_hook_state *state)
@@ -243,8 +306,10 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
 	rt = (const struct rtable *)flow->tuplehash[dir].tuple.dst_cache;
 
+	/* an encapsulated flow cannot fragment here, leave it to the stack */
 	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)) &&
-	    (ip_hdr(skb)->frag_off & htons(IP_DF)) != 0)
+	    ((ip_hdr(skb)->frag_off & htons(IP_DF)) != 0 ||
+	     flow->tuplehash[dir].tuple.encap))
 		return NF_ACCEPT;
 
 	if (skb_try_make_writable(skb, sizeof(*iph)))
@@ -262,6 +327,12 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	iph = ip_hdr(skb);
 	ip_decrease_ttl(iph);
 
+	if (flow->tuplehash[dir].tuple.encap)
+		return nf_flow_encap_xmit(skb, flow->tuplehash[dir].tuple.encap,
+					  thoff,
+					  htonl((u32)iph->tos << IPV6_TCLASS_SHIFT),
+					  iph->ttl);
+
 	skb->dev = outdev;
 	nexthop = rt_nexthop(rt, flow->tuplehash[!dir].tuple.src_v4.s_addr);
 	neigh_xmit(NEIGH_ARP_TABLE, outdev, &nexthop, skb);
@@ -478,6 +549,11 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	ip6h = ipv6_hdr(skb);
 	ip6h->hop_limit--;
 
+	if (flow->tuplehash[dir].tuple.encap)
+		return nf_flow_encap_xmit(skb, flow->tuplehash[dir].tuple.encap,
+					  sizeof(*ip6h), ip6_flowinfo(ip6h),
+					  ip6h->hop_limit);
+
 	skb->dev = outdev;
 	nexthop = rt6_nexthop(rt, &flow->tuplehash[!dir].tuple.src_v6);
 	neigh_xmit(NEIGH_ND_TABLE, outdev, nexthop, skb);
@@ -51,6 +51,7 @@ struct fl_flow_key {
 	struct flow_dissector_key_mpls mpls;
 	struct flow_dissector_key_tcp tcp;
 	struct flow_dissector_key_ip ip;
+	struct flow_dissector_key_srh srh;
 } __aligned(BITS_PER_LONG / 8); /* Ensure that we can do comparisons as longs. */
 
 struct fl_flow_mask_range {
@@ -452,6 +453,16 @@ static const struct nla_policy fl_policy[TCA_FLOWER_MAX + 1] = {
 	[TCA_FLOWER_KEY_IP_TOS_MASK]	= { .type = NLA_U8 },
 	[TCA_FLOWER_KEY_IP_TTL]		= { .type = NLA_U8 },
 	[TCA_FLOWER_KEY_IP_TTL_MASK]	= { .type = NLA_U8 },
+	[TCA_FLOWER_KEY_SRH_SEGMENTS_LEFT]	= { .type = NLA_U8 },
+	[TCA_FLOWER_KEY_SRH_SEGMENTS_LEFT_MASK]	= { .type = NLA_U8 },
+	[TCA_FLOWER_KEY_SRH_FLAGS]	= { .type = NLA_U8 },
+	[TCA_FLOWER_KEY_SRH_FLAGS_MASK]	= { .type = NLA_U8 },
+	[TCA_FLOWER_KEY_SRH_TAG]	= { .type = NLA_U16 },
+	[TCA_FLOWER_KEY_SRH_TAG_MASK]	= { .type = NLA_U16 },
+	[TCA_FLOWER_KEY_SRH_ACTIVE_SEG]	= { .len = sizeof(struct in6_addr) },
+	[TCA_FLOWER_KEY_SRH_ACTIVE_SEG_MASK] = { .len = sizeof(struct in6_addr) },
+	[TCA_FLOWER_KEY_SRH_LAST_SEG]	= { .len = sizeof(struct in6_addr) },
+	[TCA_FLOWER_KEY_SRH_LAST_SEG_MASK] = { .len = sizeof(struct in6_addr) },
 };
 
 static void fl_set_key_val(struct nlattr **tb,
@@ -569,6 +580,29 @@ static void fl_set_key_ip(struct nlattr **tb,
 			       sizeof(key->ttl));
 }
 
+static void fl_set_key_srh(struct nlattr **tb,
+			   struct flow_dissector_key_srh *key,
+			   struct flow_dissector_key_srh *mask)
+{
+	fl_set_key_val(tb, &key->segments_left,
+		       TCA_FLOWER_KEY_SRH_SEGMENTS_LEFT,
+		       &mask->segments_left,
+		       TCA_FLOWER_KEY_SRH_SEGMENTS_LEFT_MASK,
+		       sizeof(key->segments_left));
+	fl_set_key_val(tb, &key->flags, TCA_FLOWER_KEY_SRH_FLAGS,
+		       &mask->flags, TCA_FLOWER_KEY_SRH_FLAGS_MASK,
+		       sizeof(key->flags));
+	fl_set_key_val(tb, &key->tag, TCA_FLOWER_KEY_SRH_TAG,
+		       &mask->tag, TCA_FLOWER_KEY_SRH_TAG_MASK,
+		       sizeof(key->tag));
+	fl_set_key_val(tb, &key->active_seg, TCA_FLOWER_KEY_SRH_ACTIVE_SEG,
+		       &mask->active_seg, TCA_FLOWER_KEY_SRH_ACTIVE_SEG_MASK,
+		       sizeof(key->active_seg));
+	fl_set_key_val(tb, &key->last_seg, TCA_FLOWER_KEY_SRH_LAST_SEG,
+		       &mask->last_seg, TCA_FLOWER_KEY_SRH_LAST_SEG_MASK,
+		       sizeof(key->last_seg));
+}
+
 static int fl_set_key(struct net *net, struct nlattr **tb,
 		      struct fl_flow_key *key, struct fl_flow_key *mask,
 		      struct netlink_ext_ack *extack)
@@ -615,6 +649,9 @@ static int fl_set_key(struct net *net, struct nlattr **tb,
 		fl_set_key_ip(tb, &key->ip, &mask->ip);
 	}
 
+	if (key->basic.n_proto == htons(ETH_P_IPV6))
+		fl_set_key_srh(tb, &key->srh, &mask->srh);
+
 	if (tb[TCA_FLOWER_KEY_IPV4_SRC] || tb[TCA_FLOWER_KEY_IPV4_DST]) {
 		key->control.addr_type = FLOW_DISSECTOR_KEY_IPV4_ADDRS;
 		mask->control.addr_type = ~0;
@@ -817,6 +854,8 @@ static void fl_init_dissector(struct fl_flow_mask *mask)
 			     FLOW_DISSECTOR_KEY_IP, ip);
 	FL_KEY_SET_IF_MASKED(&mask->key, keys, cnt,
 			     FLOW_DISSECTOR_KEY_TCP, tcp);
+	FL_KEY_SET_IF_MASKED(&mask->key, keys, cnt,
+			     FLOW_DISSECTOR_KEY_SRH, srh);
 	FL_KEY_SET_IF_MASKED(&mask->key, keys, cnt,
 			     FLOW_DISSECTOR_KEY_ICMP, icmp);
 	FL_KEY_SET_IF_MASKED(&mask->key, keys, cnt,
@@ -1159,6 +1198,34 @@ static int fl_dump_key_ip(struct sk_buff *skb,
 	return 0;
 }
 
+static int fl_dump_key_srh(struct sk_buff *skb,
+			   struct flow_dissector_key_srh *key,
+			   struct flow_dissector_key_srh *mask)
+{
+	if (fl_dump_key_val(skb, &key->segments_left,
+			    TCA_FLOWER_KEY_SRH_SEGMENTS_LEFT,
+			    &mask->segments_left,
+			    TCA_FLOWER_KEY_SRH_SEGMENTS_LEFT_MASK,
+			    sizeof(key->segments_left)) ||
+	    fl_dump_key_val(skb, &key->flags, TCA_FLOWER_KEY_SRH_FLAGS,
+			    &mask->flags, TCA_FLOWER_KEY_SRH_FLAGS_MASK,
+			    sizeof(key->flags)) ||
+	    fl_dump_key_val(skb, &key->tag, TCA_FLOWER_KEY_SRH_TAG,
+			    &mask->tag, TCA_FLOWER_KEY_SRH_TAG_MASK,
+			    sizeof(key->tag)) ||
+	    fl_dump_key_val(skb, &key->active_seg,
+			    TCA_FLOWER_KEY_SRH_ACTIVE_SEG, &mask->active_seg,
+			    TCA_FLOWER_KEY_SRH_ACTIVE_SEG_MASK,
+			    sizeof(key->active_seg)) ||
+	    fl_dump_key_val(skb, &key->last_seg,
+			    TCA_FLOWER_KEY_SRH_LAST_SEG, &mask->last_seg,
+			    TCA_FLOWER_KEY_SRH_LAST_SEG_MASK,
+			    sizeof(key->last_seg)))
+		return -1;
+
+	return 0;
+}
+
 static int fl_dump_key_vlan(struct sk_buff *skb,
 			    struct flow_dissector_key_vlan *vlan_key,
 			    struct flow_dissector_key_vlan *vlan_mask)
@@ -1280,6 +1347,10 @@ static int fl_dump(struct net *net, struct tcf_proto *tp, void *fh,
 	    fl_dump_key_ip(skb, &key->ip, &mask->ip)))
 		goto nla_put_failure;
 
+	if (key->basic.n_proto == htons(ETH_P_IPV6) &&
+	    fl_dump_key_srh(skb, &key->srh, &mask->srh))
+		goto nla_put_failure;
+
 	if (key->control.addr_type == FLOW_DISSECTOR_KEY_IPV4_ADDRS &&
 	    (fl_dump_key_val(skb, &key->ipv4.src, TCA_FLOWER_KEY_IPV4_SRC,
 			     &mask->ipv4.src, TCA_FLOWER_KEY_IPV4_SRC_MASK,
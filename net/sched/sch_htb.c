@@ -37,6 +37,7 @@
 #include <linux/rbtree.h>
 #include <linux/workqueue.h>
 #include <linux/slab.h>
+#include <linux/percpu.h>
 #include <net/netlink.h>
 #include <net/sch_generic.h>
 #include <net/pkt_sched.h>
@@ -91,6 +92,37 @@ struct htb_prio {
 	u32		last_ptr_id;
 };
 
+/* tokens a CPU took from a shared pool, and the rate they are spent at,
+ * snapshotted under the pool lock when the batch was taken
+ */
+struct htb_shared_batch {
+	s64			budget;
+	struct psched_ratecfg	rate;
+};
+
+/* Token pool shared by classes of several HTB instances on one device.
+ * With an HTB grafted on each TX queue (e.g. under mq), every queue
+ * keeps its own class hierarchy and qdisc lock; classes carrying the
+ * same TCA_HTB_SHARED id still have their aggregate rate held to the
+ * rate of the group. Tokens are handed to CPUs in batches so that the
+ * pool lock is only taken when the batch of a CPU runs out.
+ */
+struct htb_shared {
+	struct list_head	list;		/* on htb_shared_list */
+	struct net_device	*dev;
+	u32			id;
+	unsigned int		refcnt;		/* under RTNL */
+
+	spinlock_t		lock;
+	struct psched_ratecfg	rate;
+	s64			buffer;		/* pool depth */
+	s64			batch;		/* tokens taken per refill */
+	s64			tokens;
+	s64			t_c;		/* checkpoint time */
+
+	struct htb_shared_batch __percpu *pcpu;
+};
+
 /* interior & leaf nodes; props specific to leaves are marked L:
  * To reduce false sharing, place mostly read fields at beginning,
  * and mostly written ones at the end.
@@ -111,6 +143,7 @@ struct htb_class {
 	int			level;		/* our level (see above) */
 	unsigned int		children;
 	struct htb_class	*parent;	/* parent class */
+	struct htb_shared	*shared;	/* cross-queue token pool */
 
 	struct net_rate_estimator __rcu *rate_est;
 
@@ -197,6 +230,135 @@ static unsigned long htb_search(struct Qdisc *sch, u32 handle)
 {
 	return (unsigned long)htb_find(handle, sch);
 }
+
+static LIST_HEAD(htb_shared_list);	/* protected by RTNL */
+
+static struct htb_shared *htb_shared_get(struct net_device *dev, u32 id)
+{
+	struct htb_shared *sh;
+	int cpu;
+
+	ASSERT_RTNL();
+
+	list_for_each_entry(sh, &htb_shared_list, list) {
+		if (sh->dev == dev && sh->id == id) {
+			sh->refcnt++;
+			return sh;
+		}
+	}
+
+	sh = kzalloc(sizeof(*sh), GFP_KERNEL);
+	if (!sh)
+		return NULL;
+
+	sh->pcpu = alloc_percpu(struct htb_shared_batch);
+	if (!sh->pcpu) {
+		kfree(sh);
+		return NULL;
+	}
+	/* no CPU holds a batch yet, the first packet takes one */
+	for_each_possible_cpu(cpu)
+		per_cpu_ptr(sh->pcpu, cpu)->budget = -1;
+
+	spin_lock_init(&sh->lock);
+	sh->dev = dev;
+	sh->id = id;
+	sh->refcnt = 1;
+	sh->t_c = ktime_get_ns();
+	list_add(&sh->list, &htb_shared_list);
+
+	return sh;
+}
+
+static void htb_shared_put(struct htb_shared *sh)
+{
+	ASSERT_RTNL();
+
+	if (--sh->refcnt)
+		return;
+
+	list_del(&sh->list);
+	free_percpu(sh->pcpu);
+	kfree(sh);
+}
+
+/* the group follows the rate of the class configured last, CPUs pick it
+ * up with their next batch
+ */
+static void htb_shared_set_rate(struct htb_shared *sh,
+				const struct htb_class *cl)
+{
+	s64 batch;
+
+	spin_lock_bh(&sh->lock);
+	/* a new pool starts full, as classes do */
+	if (!sh->buffer)
+		sh->tokens = cl->buffer;
+	sh->rate = cl->rate;
+	sh->buffer = cl->buffer;
+
+	/* at most one burst in flight across all CPUs, but never less
+	 * than a couple of packets per refill
+	 */
+	batch = div_s64(cl->buffer, num_possible_cpus());
+	sh->batch = max_t(s64, batch,
+			  psched_l2t_ns(&sh->rate, 2 * psched_mtu(sh->dev)));
+	if (sh->tokens > sh->buffer)
+		sh->tokens = sh->buffer;
+	spin_unlock_bh(&sh->lock);
+}
+
+/* settle the overdraft of the batch of a CPU and take a fresh one,
+ * returns how long the pool is overdrawn
+ */
+static s64 htb_shared_refill(struct htb_shared *sh, struct htb_shared_batch *b,
+			     s64 now)
+{
+	s64 toks, debt = 0;
+
+	spin_lock(&sh->lock);
+	toks = sh->tokens;
+	/* dequeue times of other queues may lag behind ours */
+	if (now > sh->t_c) {
+		toks = min_t(s64, toks + now - sh->t_c, sh->buffer);
+		sh->t_c = now;
+	}
+	toks -= sh->batch - b->budget;
+	if (toks < 0)
+		debt = -toks;
+	sh->tokens = toks;
+	b->budget = sh->batch;
+	b->rate = sh->rate;
+	spin_unlock(&sh->lock);
+
+	return debt;
+}
+
+/**
+ * htb_shared_charge - charge a packet to a cross-queue token pool
+ *
+ * Takes the transmission time of @bytes from the batch of the local CPU
+ * and refills the batch from the pool when it runs out. Returns how long
+ * the pool is overdrawn, 0 if the group is still within its rate. The
+ * rate of the pool is only read under its lock: qdiscs of other queues
+ * may be changing it.
+ */
+static s64 htb_shared_charge(struct htb_shared *sh, int bytes, s64 now)
+{
+	struct htb_shared_batch *b = this_cpu_ptr(sh->pcpu);
+	s64 debt = 0;
+
+	/* the first packet of a CPU needs a batch, and its rate, first */
+	if (unlikely(b->budget < 0))
+		debt = htb_shared_refill(sh, b, now);
+
+	b->budget -= psched_l2t_ns(&b->rate, bytes);
+	if (b->budget < 0)
+		debt = htb_shared_refill(sh, b, now);
+
+	return debt;
+}
+
 /**
  * htb_classify - classify a packet into class
  *
@@ -693,6 +855,15 @@ static void htb_charge_class(struct htb_sched *q, struct htb_class *cl,
 		htb_accnt_ctokens(cl, bytes, diff);
 		cl->t_c = q->now;
 
+		/* hold the class back until its group has recovered */
+		if (cl->shared) {
+			s64 debt = htb_shared_charge(cl->shared, bytes, q->now);
+
+			if (debt)
+				cl->ctokens = max_t(s64, cl->ctokens - debt,
+						    1 - cl->mbuffer);
+		}
+
 		old_mode = cl->cmode;
 		diff = 0;
 		htb_change_class_mode(q, cl, &diff);
@@ -1005,6 +1176,7 @@ static const struct nla_policy htb_policy[TCA_HTB_MAX + 1] = {
 	[TCA_HTB_DIRECT_QLEN] = { .type = NLA_U32 },
 	[TCA_HTB_RATE64] = { .type = NLA_U64 },
 	[TCA_HTB_CEIL64] = { .type = NLA_U64 },
+	[TCA_HTB_SHARED] = { .type = NLA_U32 },
 };
 
 static void htb_work_func(struct work_struct *work)
@@ -1135,6 +1307,8 @@ static int htb_dump_class(struct Qdisc *sch, unsigned long arg,
 	    nla_put_u64_64bit(skb, TCA_HTB_CEIL64, cl->ceil.rate_bytes_ps,
 			      TCA_HTB_PAD))
 		goto nla_put_failure;
+	if (cl->shared && nla_put_u32(skb, TCA_HTB_SHARED, cl->shared->id))
+		goto nla_put_failure;
 
 	return nla_nest_end(skb, nest);
 
@@ -1240,6 +1414,8 @@ static void htb_destroy_class(struct Qdisc *sch, struct htb_class *cl)
 	}
 	gen_kill_estimator(&cl->rate_est);
 	tcf_block_put(cl->block);
+	if (cl->shared)
+		htb_shared_put(cl->shared);
 	kfree(cl);
 }
 
@@ -1333,6 +1509,7 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 	int err = -EINVAL;
 	struct htb_sched *q = qdisc_priv(sch);
 	struct htb_class *cl = (struct htb_class *)*arg, *parent;
+	struct htb_shared *shared = NULL, *old_shared = NULL;
 	struct nlattr *opt = tca[TCA_OPTIONS];
 	struct nlattr *tb[TCA_HTB_MAX + 1];
 	struct tc_htb_opt *hopt;
@@ -1366,6 +1543,15 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 		qdisc_put_rtab(qdisc_get_rtab(&hopt->ceil, tb[TCA_HTB_CTAB],
 					      NULL));
 
+	if (tb[TCA_HTB_SHARED] && nla_get_u32(tb[TCA_HTB_SHARED])) {
+		err = -ENOBUFS;
+		shared = htb_shared_get(qdisc_dev(sch),
+					nla_get_u32(tb[TCA_HTB_SHARED]));
+		if (!shared)
+			goto failure;
+		err = -EINVAL;
+	}
+
 	if (!cl) {		/* new class */
 		struct Qdisc *new_q;
 		int prio;
@@ -1478,7 +1664,7 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 						    qdisc_root_sleeping_running(sch),
 						    tca[TCA_RATE]);
 			if (err)
-				return err;
+				goto failure;
 		}
 		sch_tree_lock(sch);
 	}
@@ -1516,8 +1702,21 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 	cl->buffer = PSCHED_TICKS2NS(hopt->buffer);
 	cl->cbuffer = PSCHED_TICKS2NS(hopt->cbuffer);
 
+	/* tools unaware of pools leave the class in its pool, only an
+	 * explicit 0 detaches it
+	 */
+	if (tb[TCA_HTB_SHARED]) {
+		old_shared = cl->shared;
+		cl->shared = shared;
+	}
+	if (cl->shared)
+		htb_shared_set_rate(cl->shared, cl);
+
 	sch_tree_unlock(sch);
 
+	if (old_shared)
+		htb_shared_put(old_shared);
+
 	if (warn)
 		pr_warn("HTB: quantum of class %X is %s. Consider r2q change.\n",
 			    cl->common.classid, (warn == -1 ? "small" : "big"));
@@ -1528,6 +1727,8 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 	return 0;
 
 failure:
+	if (shared)
+		htb_shared_put(shared);
 	return err;
 }
 
@@ -108,12 +108,13 @@ static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 			    size_t total_len)
 {
 	bool need_wait = !(m->msg_flags & MSG_DONTWAIT);
-	u32 max_batch = TX_BATCH_SIZE;
+	struct sk_buff *skbs[TX_BATCH_SIZE];
+	u32 pos[TX_BATCH_SIZE];
 	struct xdp_sock *xs = xdp_sk(sk);
-	bool sent_frame = false;
 	struct xdp_desc desc;
 	struct sk_buff *skb;
-	int err = 0;
+	int err = 0, n = 0;
+	int i, sent;
 
 	if (unlikely(!xs->tx))
 		return -ENOBUFS;
@@ -122,30 +123,40 @@ static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 
 	mutex_lock(&xs->mutex);
 
-	while (xskq_peek_desc(xs->tx, &desc)) {
+	/* Build skbs for a batch of descriptors before handing them all to
+	 * the driver. Stop before the consumer index gets published so that
+	 * the descriptors the driver does not take can be given back.
+	 */
+	for (;;) {
 		char *buffer;
 		u32 id, len;
 
-		if (max_batch-- == 0) {
+		if (n == TX_BATCH_SIZE ||
+		    (n && xskq_batch_done_desc(xs->tx))) {
 			err = -EAGAIN;
-			goto out;
+			break;
 		}
 
+		if (!xskq_peek_desc(xs->tx, &desc))
+			break;
+
 		if (xskq_reserve_id(xs->umem->cq)) {
 			err = -EAGAIN;
-			goto out;
+			break;
 		}
 
 		len = desc.len;
 		if (unlikely(len > xs->dev->mtu)) {
+			xskq_cancel_id(xs->umem->cq, 1);
 			err = -EMSGSIZE;
-			goto out;
+			break;
 		}
 
 		skb = sock_alloc_send_skb(sk, len, !need_wait, &err);
 		if (unlikely(!skb)) {
+			xskq_cancel_id(xs->umem->cq, 1);
 			err = -EAGAIN;
-			goto out;
+			break;
 		}
 
 		skb_put(skb, len);
@@ -154,7 +165,8 @@ static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 		err = skb_store_bits(skb, 0, buffer, len);
 		if (unlikely(err)) {
 			kfree_skb(skb);
-			goto out;
+			xskq_cancel_id(xs->umem->cq, 1);
+			break;
 		}
 
 		skb->dev = xs->dev;
@@ -163,22 +175,32 @@ static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 		skb_shinfo(skb)->destructor_arg = (void *)(long)id;
 		skb->destructor = xsk_destruct_skb;
 
-		err = dev_direct_xmit(skb, xs->queue_id);
-		/* Ignore NET_XMIT_CN as packet might have been sent */
-		if (err == NET_XMIT_DROP || err == NETDEV_TX_BUSY) {
-			err = -EAGAIN;
-			/* SKB consumed by dev_direct_xmit() */
-			goto out;
-		}
-
-		sent_frame = true;
+		pos[n] = xs->tx->cons_tail;
+		skbs[n++] = skb;
 		xskq_discard_desc(xs->tx);
 	}
 
-out:
-	if (sent_frame)
+	if (!n)
+		goto out;
+
+	sent = dev_direct_xmit_bulk(skbs, n, xs->queue_id);
+	if (sent < n) {
+		/* Not sent, neither completed: retried on the next call */
+		xskq_rewind_desc(xs->tx, pos[sent]);
+		xskq_cancel_id(xs->umem->cq, n - sent);
+		for (i = sent; i < n; i++) {
+			skbs[i]->destructor = sock_wfree;
+			kfree_skb(skbs[i]);
+		}
+		/* keep the error of the descriptor that ended the batch */
+		if (!err)
+			err = -EAGAIN;
+	}
+
+	if (sent)
 		sk->sk_write_space(sk);
 
+out:
 	mutex_unlock(&xs->mutex);
 	return err;
 }
@@ -8,10 +8,13 @@
 
 #include <linux/types.h>
 #include <linux/if_xdp.h>
+#include <linux/netdevice.h>
 
 #include "xdp_umem_props.h"
 
 #define RX_BATCH_SIZE 16
+/* ids taken from the fill queue at once, a whole NAPI poll burst */
+#define FQ_BATCH_SIZE NAPI_POLL_WEIGHT
 
 struct xsk_queue {
 	struct xdp_umem_props umem_props;
@@ -89,7 +92,7 @@ static inline u32 *xskq_peek_id(struct xsk_queue *q)
 
 	if (q->cons_tail == q->cons_head) {
 		WRITE_ONCE(q->ring->consumer, q->cons_tail);
-		q->cons_head = q->cons_tail + xskq_nb_avail(q, RX_BATCH_SIZE);
+		q->cons_head = q->cons_tail + xskq_nb_avail(q, FQ_BATCH_SIZE);
 
 		/* Order consumer and data */
 		smp_rmb();
@@ -129,6 +132,11 @@ static inline int xskq_reserve_id(struct xsk_queue *q)
 	return 0;
 }
 
+static inline void xskq_cancel_id(struct xsk_queue *q, u32 cnt)
+{
+	q->prod_head -= cnt;
+}
+
 /* Rx/Tx queue */
 
 static inline bool xskq_is_valid_desc(struct xsk_queue *q, struct xdp_desc *d)
@@ -195,6 +203,20 @@ static inline void xskq_discard_desc(struct xsk_queue *q)
 	(void)xskq_validate_desc(q, NULL);
 }
 
+/* True when the next peek refills the batch, publishing the consumer
+ * index: descriptors discarded so far can then no longer be given back.
+ */
+static inline bool xskq_batch_done_desc(struct xsk_queue *q)
+{
+	return q->cons_tail == q->cons_head;
+}
+
+/* Give back the descriptors discarded since @cons_tail was read */
+static inline void xskq_rewind_desc(struct xsk_queue *q, u32 cons_tail)
+{
+	q->cons_tail = cons_tail;
+}
+
 static inline int xskq_produce_batch_desc(struct xsk_queue *q,
 					  u32 id, u32 len, u16 offset)
 {
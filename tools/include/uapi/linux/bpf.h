@@ -241,6 +241,11 @@ enum bpf_attach_type {
 /* flags for BPF_PROG_QUERY */
 #define BPF_F_QUERY_EFFECTIVE	(1U << 0)
 
+/* flags for BPF_PROG_TEST_RUN on XDP programs: run over repeat copies of
+ * data_in received on test.ifindex, transmitting and redirecting them
+ */
+#define BPF_F_TEST_XDP_LIVE_FRAMES	(1U << 0)
+
 #define BPF_OBJ_NAME_LEN 16U
 
 /* Flags for accessing BPF object */
@@ -287,6 +292,9 @@ union bpf_attr {
 		__u32	btf_fd;		/* fd pointing to a BTF type data */
 		__u32	btf_key_id;	/* BTF type_id of the key */
 		__u32	btf_value_id;	/* BTF type_id of the value */
+		__u32	map_ttl;	/* idle timeout of hash map entries
+					 * in ms, 0 means no expiry.
+					 */
 	};
 
 	struct { /* anonymous struct used by BPF_MAP_*_ELEM commands */
@@ -340,6 +348,8 @@ union bpf_attr {
 		__aligned_u64	data_out;
 		__u32		repeat;
 		__u32		duration;
+		__u32		flags;
+		__u32		ifindex;
 	} test;
 
 	struct { /* anonymous struct used by BPF_*_GET_*_ID */
@@ -1848,6 +1858,13 @@ union bpf_attr {
  *             full lookup using FIB rules
  *             **BPF_FIB_LOOKUP_OUTPUT** means do lookup from an egress
  *             perspective (default is ingress)
+ *             **BPF_FIB_LOOKUP_SEG6** means resolve routes steering the
+ *             destination into an IPv6 Segment Routing policy. *params*
+ *             must then be followed by a **struct bpf_fib_seg6** and,
+ *             optionally, room for a copy of the SRH of the policy. The
+ *             lookup is done again for the first segment, whose nexthop
+ *             is returned in ipv6_dst along with smac and dmac. *params*
+ *             are left untouched if the first segment is not forwarded.
  *
  *             *ctx* is either **struct xdp_md** for XDP programs or
  *             **struct sk_buff** tc cls_act programs.
@@ -1920,6 +1937,11 @@ union bpf_attr {
  *			Segment Routing Header (**struct ipv6_sr_hdr**) inside
  *			the IPv6 header.
  *
+ *		The packet is then routed towards its new destination: as a
+ *		received packet from **BPF_PROG_TYPE_LWT_IN** programs, as a
+ *		locally generated one from **BPF_PROG_TYPE_LWT_OUT** and
+ *		**BPF_PROG_TYPE_LWT_XMIT** programs.
+ *
  * 		A call to this helper is susceptible to change the underlaying
  * 		packet buffer. Therefore, at load time, all checks on pointers
  * 		previously done by the verifier are invalidated and must be
@@ -1987,6 +2009,15 @@ union bpf_attr {
  * 		direct packet access.
  *	Return
  * 		0 on success, or a negative error in case of failure.
+ *
+ * int bpf_lwt_seg6_cache_flush(struct sk_buff *skb)
+ *	Description
+ *		Invalidate all the verdicts cached by the flow cache of the
+ *		End.BPF SID running the program. The verdict of the current
+ *		packet is not cached either. This is a no-op when the SID has
+ *		no flow cache.
+ *	Return
+ * 		0 on success, or a negative error in case of failure.
  */
 #define __BPF_FUNC_MAPPER(FN)		\
 	FN(unspec),			\
@@ -2065,7 +2096,11 @@ union bpf_attr {
 	FN(lwt_push_encap),		\
 	FN(lwt_seg6_store_bytes),	\
 	FN(lwt_seg6_adjust_srh),	\
-	FN(lwt_seg6_action),
+	FN(lwt_seg6_action),		\
+	FN(ipv6_fib_multipath_nh), 	\
+	FN(ktime_get_real_ns),		\
+	FN(skb_get_tstamp),		\
+	FN(lwt_seg6_cache_flush),
 
 /* integer value in 'imm' field of BPF_CALL instruction selects which helper
  * function eBPF program intends to call
@@ -2507,6 +2542,7 @@ struct bpf_raw_tracepoint_args {
  */
 #define BPF_FIB_LOOKUP_DIRECT  BIT(0)
 #define BPF_FIB_LOOKUP_OUTPUT  BIT(1)
+#define BPF_FIB_LOOKUP_SEG6    BIT(2)
 
 struct bpf_fib_lookup {
 	/* input */
@@ -2553,4 +2589,22 @@ struct bpf_fib_lookup {
 	__u8	dmac[6];     /* ETH_ALEN */
 };
 
+/* SEG6: output, follows struct bpf_fib_lookup when BPF_FIB_LOOKUP_SEG6 is
+ * set. srh_len is 0 if the route is not a seg6 one. Otherwise, the SRH
+ * to push is copied in srh when it fits in the buffer given to
+ * bpf_fib_lookup, -ENOSPC being returned when it does not. In encap mode,
+ * ipv6_src is the source of the outer header and the HMAC, if any, is
+ * already computed. In inline mode, the first entry of the segment list
+ * is left for the caller to set to the original destination, as is the
+ * nexthdr field of the SRH in both modes.
+ */
+struct bpf_fib_seg6 {
+	__u8	mode;		/* SEG6_IPTUN_MODE_* */
+	__u8	pad;
+	__u16	srh_len;	/* bytes */
+	__u32	ipv6_src[4];	/* in6_addr; network order */
+	__u32	segment[4];	/* first segment, destination of the packet */
+	__u8	srh[0];
+};
+
 #endif /* _UAPI__LINUX_BPF_H__ */
@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: GPL-2.0+ WITH Linux-syscall-note */
+/*
+ *  SR-IPv6 implementation
+ *
+ *  Author:
+ *  David Lebrun <david.lebrun@uclouvain.be>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ */
+
+#ifndef _UAPI_LINUX_SEG6_IPTUNNEL_H
+#define _UAPI_LINUX_SEG6_IPTUNNEL_H
+
+#include <linux/seg6.h>		/* For struct ipv6_sr_hdr. */
+
+enum {
+	SEG6_IPTUNNEL_UNSPEC,
+	SEG6_IPTUNNEL_SRH,
+	SEG6_IPTUNNEL_CLASS_KEY,	/* u32, SEG6_IPTUN_CLASS_* */
+	SEG6_IPTUNNEL_CLASSES,		/* nested list of SEG6_IPTUNNEL_CLASS */
+	SEG6_IPTUNNEL_MTU,		/* u32, path MTU of the policy */
+	SEG6_IPTUNNEL_MSS_CLAMP,	/* flag, clamp MSS of forwarded SYNs */
+	__SEG6_IPTUNNEL_MAX,
+};
+#define SEG6_IPTUNNEL_MAX (__SEG6_IPTUNNEL_MAX - 1)
+
+enum {
+	SEG6_IPTUNNEL_CLASS_UNSPEC,
+	SEG6_IPTUNNEL_CLASS,		/* nested, one per traffic class */
+	__SEG6_IPTUNNEL_CLASS_LIST_MAX,
+};
+#define SEG6_IPTUNNEL_CLASS_LIST_MAX (__SEG6_IPTUNNEL_CLASS_LIST_MAX - 1)
+
+enum {
+	SEG6_IPTUNNEL_CLASS_ATTR_UNSPEC,
+	SEG6_IPTUNNEL_CLASS_VALUE,	/* u32, mark or DSCP to match */
+	SEG6_IPTUNNEL_CLASS_SRH,	/* struct ipv6_sr_hdr */
+	__SEG6_IPTUNNEL_CLASS_MAX,
+};
+#define SEG6_IPTUNNEL_CLASS_MAX (__SEG6_IPTUNNEL_CLASS_MAX - 1)
+
+/* how SEG6_IPTUNNEL_CLASSES entries are selected */
+enum {
+	SEG6_IPTUN_CLASS_NONE,
+	SEG6_IPTUN_CLASS_MARK,		/* skb->mark */
+	SEG6_IPTUN_CLASS_DSCP,		/* DSCP of the inner IPv4/IPv6 header */
+};
+
+#define SEG6_IPTUN_CLASSES_MAX	16
+
+struct seg6_iptunnel_encap {
+	int mode;
+	struct ipv6_sr_hdr srh[0];
+};
+
+#define SEG6_IPTUN_ENCAP_SIZE(x) ((sizeof(*x)) + (((x)->srh->hdrlen + 1) << 3))
+
+enum {
+	SEG6_IPTUN_MODE_INLINE,
+	SEG6_IPTUN_MODE_ENCAP,
+	SEG6_IPTUN_MODE_L2ENCAP,
+};
+
+#ifdef __KERNEL__
+
+static inline size_t seg6_lwt_headroom(struct seg6_iptunnel_encap *tuninfo)
+{
+	int head = 0;
+
+	switch (tuninfo->mode) {
+	case SEG6_IPTUN_MODE_INLINE:
+		break;
+	case SEG6_IPTUN_MODE_ENCAP:
+		head = sizeof(struct ipv6hdr);
+		break;
+	case SEG6_IPTUN_MODE_L2ENCAP:
+		return 0;
+	}
+
+	return ((tuninfo->srh->hdrlen + 1) << 3) + head;
+}
+
+#endif
+
+#endif
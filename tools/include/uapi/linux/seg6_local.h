@@ -0,0 +1,141 @@
+/*
+ *  SR-IPv6 implementation
+ *
+ *  Author:
+ *  David Lebrun <david.lebrun@uclouvain.be>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ */
+
+#ifndef _UAPI_LINUX_SEG6_LOCAL_H
+#define _UAPI_LINUX_SEG6_LOCAL_H
+
+#include <linux/seg6.h>
+
+enum {
+	SEG6_LOCAL_UNSPEC,
+	SEG6_LOCAL_ACTION,
+	SEG6_LOCAL_SRH,
+	SEG6_LOCAL_TABLE,
+	SEG6_LOCAL_NH4,
+	SEG6_LOCAL_NH6,
+	SEG6_LOCAL_IIF,
+	SEG6_LOCAL_OIF,
+	SEG6_LOCAL_BPF,
+	SEG6_LOCAL_OAM,
+	SEG6_LOCAL_POLICER,
+	SEG6_LOCAL_LB,
+	__SEG6_LOCAL_MAX,
+};
+#define SEG6_LOCAL_MAX (__SEG6_LOCAL_MAX - 1)
+
+enum {
+	SEG6_LOCAL_ACTION_UNSPEC	= 0,
+	/* node segment */
+	SEG6_LOCAL_ACTION_END		= 1,
+	/* adjacency segment (IPv6 cross-connect) */
+	SEG6_LOCAL_ACTION_END_X		= 2,
+	/* lookup of next seg NH in table */
+	SEG6_LOCAL_ACTION_END_T		= 3,
+	/* decap and L2 cross-connect */
+	SEG6_LOCAL_ACTION_END_DX2	= 4,
+	/* decap and IPv6 cross-connect */
+	SEG6_LOCAL_ACTION_END_DX6	= 5,
+	/* decap and IPv4 cross-connect */
+	SEG6_LOCAL_ACTION_END_DX4	= 6,
+	/* decap and lookup of DA in v6 table */
+	SEG6_LOCAL_ACTION_END_DT6	= 7,
+	/* decap and lookup of DA in v4 table */
+	SEG6_LOCAL_ACTION_END_DT4	= 8,
+	/* binding segment with insertion */
+	SEG6_LOCAL_ACTION_END_B6	= 9,
+	/* binding segment with encapsulation */
+	SEG6_LOCAL_ACTION_END_B6_ENCAP	= 10,
+	/* binding segment with MPLS encap */
+	SEG6_LOCAL_ACTION_END_BM	= 11,
+	/* lookup last seg in table */
+	SEG6_LOCAL_ACTION_END_S		= 12,
+	/* forward to SR-unaware VNF with static proxy */
+	SEG6_LOCAL_ACTION_END_AS	= 13,
+	/* forward to SR-unaware VNF with masquerading */
+	SEG6_LOCAL_ACTION_END_AM	= 14,
+	/* custom BPF action */
+	SEG6_LOCAL_ACTION_END_BPF	= 15,
+	/* answer echo probes, forward as End otherwise */
+	SEG6_LOCAL_ACTION_END_OAM	= 16,
+	/* steer flows to a backend SID by consistent hashing */
+	SEG6_LOCAL_ACTION_END_LB	= 17,
+
+	__SEG6_LOCAL_ACTION_MAX,
+};
+
+#define SEG6_LOCAL_ACTION_MAX (__SEG6_LOCAL_ACTION_MAX - 1)
+
+enum {
+	SEG6_LOCAL_BPF_PROG_UNSPEC,
+	SEG6_LOCAL_BPF_PROG,
+	SEG6_LOCAL_BPF_PROG_NAME,
+	SEG6_LOCAL_BPF_PROG_CACHE,	/* u32, flow cache entries per CPU */
+	SEG6_LOCAL_BPF_PROG_ARRAY,	/* u32, BPF_MAP_TYPE_PROG_ARRAY fd, id on dumps */
+	SEG6_LOCAL_BPF_PROG_INDEX,	/* u32, slot of the program in PROG_ARRAY */
+	__SEG6_LOCAL_BPF_PROG_MAX,
+};
+
+#define SEG6_LOCAL_BPF_PROG_MAX (__SEG6_LOCAL_BPF_PROG_MAX - 1)
+
+enum {
+	SEG6_LOCAL_POLICER_UNSPEC,
+	SEG6_LOCAL_POLICER_RATE,	/* u32, packets per second and per CPU */
+	SEG6_LOCAL_POLICER_BURST,	/* u32, packets */
+	SEG6_LOCAL_POLICER_DROPS,	/* u64, read-only */
+	SEG6_LOCAL_POLICER_PAD,
+	__SEG6_LOCAL_POLICER_MAX,
+};
+
+#define SEG6_LOCAL_POLICER_MAX (__SEG6_LOCAL_POLICER_MAX - 1)
+
+enum {
+	SEG6_LOCAL_LB_UNSPEC,
+	SEG6_LOCAL_LB_MODE,		/* u32, SEG6_LOCAL_LB_MODE_* */
+	SEG6_LOCAL_LB_TABLE_SIZE,	/* u32, prime number of lookup slots */
+	SEG6_LOCAL_LB_BACKENDS,		/* nested list of SEG6_LOCAL_LB_BACKEND */
+	__SEG6_LOCAL_LB_MAX,
+};
+
+#define SEG6_LOCAL_LB_MAX (__SEG6_LOCAL_LB_MAX - 1)
+
+enum {
+	SEG6_LOCAL_LB_BACKEND_LIST_UNSPEC,
+	SEG6_LOCAL_LB_BACKEND,		/* nested, one per backend */
+	__SEG6_LOCAL_LB_BACKEND_LIST_MAX,
+};
+
+#define SEG6_LOCAL_LB_BACKEND_LIST_MAX (__SEG6_LOCAL_LB_BACKEND_LIST_MAX - 1)
+
+enum {
+	SEG6_LOCAL_LB_BACKEND_UNSPEC,
+	SEG6_LOCAL_LB_BACKEND_SID,	/* struct in6_addr */
+	SEG6_LOCAL_LB_BACKEND_WEIGHT,	/* u32, 1 to 256, defaults to 1 */
+	__SEG6_LOCAL_LB_BACKEND_MAX,
+};
+
+#define SEG6_LOCAL_LB_BACKEND_MAX (__SEG6_LOCAL_LB_BACKEND_MAX - 1)
+
+/* where End.LB writes the chosen backend SID */
+enum {
+	SEG6_LOCAL_LB_MODE_DA,		/* replace the active segment */
+	SEG6_LOCAL_LB_MODE_SRH,		/* insert it, keeping the service SID */
+};
+
+/* about 32 bytes of route dump per backend, keeps the route in a dump skb */
+#define SEG6_LOCAL_LB_BACKENDS_MAX	256
+#define SEG6_LOCAL_LB_TABLE_DEFAULT	65537
+
+/* SEG6_LOCAL_OAM flags */
+#define SEG6_LOCAL_OAM_TSTAMP	(1 << 0)	/* add a timestamp TLV to replies */
+
+#endif
@@ -39,6 +39,7 @@ struct bpf_create_map_attr {
 	__u32 btf_key_id;
 	__u32 btf_value_id;
 	__u32 map_ifindex;
+	__u32 map_ttl;
 };
 
 int bpf_create_map_xattr(const struct bpf_create_map_attr *create_attr);
@@ -96,6 +97,9 @@ int bpf_prog_detach2(int prog_fd, int attachable_fd, enum bpf_attach_type type);
 int bpf_prog_test_run(int prog_fd, int repeat, void *data, __u32 size,
 		      void *data_out, __u32 *size_out, __u32 *retval,
 		      __u32 *duration);
+int bpf_prog_test_run_xdp_live(int prog_fd, int ifindex, int repeat,
+			       void *data, __u32 size, __u32 *retval,
+			       __u32 *duration);
 int bpf_prog_get_next_id(__u32 start_id, __u32 *next_id);
 int bpf_map_get_next_id(__u32 start_id, __u32 *next_id);
 int bpf_prog_get_fd_by_id(__u32 id);
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stddef.h>
+#include <linux/bpf.h>
+#include "bpf_helpers.h"
+
+#define FIB_SEG6_BUF	256
+
+/* params of the lookup, followed by struct bpf_fib_seg6 and the SRH */
+struct fib_seg6_ctx {
+	__u32 short_buf;	/* leave no room for the SRH */
+	int ret;
+	__u8 buf[FIB_SEG6_BUF];
+};
+
+struct bpf_map_def SEC("maps") fib_seg6 = {
+	.type = BPF_MAP_TYPE_ARRAY,
+	.key_size = sizeof(__u32),
+	.value_size = sizeof(struct fib_seg6_ctx),
+	.max_entries = 1,
+};
+
+SEC("xdp_fib_seg6")
+int xdp_fib_seg6(struct xdp_md *ctx)
+{
+	struct fib_seg6_ctx *c;
+	__u32 key = 0;
+
+	c = bpf_map_lookup_elem(&fib_seg6, &key);
+	if (!c)
+		return XDP_ABORTED;
+
+	if (c->short_buf)
+		c->ret = bpf_fib_lookup(ctx, (void *)c->buf,
+					sizeof(struct bpf_fib_lookup) +
+					sizeof(struct bpf_fib_seg6),
+					BPF_FIB_LOOKUP_SEG6);
+	else
+		c->ret = bpf_fib_lookup(ctx, (void *)c->buf, FIB_SEG6_BUF,
+					BPF_FIB_LOOKUP_SEG6);
+
+	return XDP_PASS;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -406,8 +406,8 @@ int __pop_egr(struct __sk_buff *skb)
 
 // Inspect if the Egress TLV and flag have been removed, if the tag is correct,
 // then apply a End.T action to reach the last segment
-SEC("inspect_t")
-int __inspect_t(struct __sk_buff *skb)
+__attribute__((always_inline))
+int inspect_t(struct __sk_buff *skb)
 {
 	struct ip6_srh_t *srh = get_srh(skb);
 	int table = 117;
@@ -434,4 +434,43 @@ int __inspect_t(struct __sk_buff *skb)
 	return BPF_REDIRECT;
 }
 
+SEC("inspect_t")
+int __inspect_t(struct __sk_buff *skb)
+{
+	return inspect_t(skb);
+}
+
+enum {
+	CACHE_RUNS,	/* number of runs of cached_t */
+	CACHE_FLUSH,	/* when set, cached_t flushes the cache of its SID */
+	__CACHE_MAX,
+};
+
+struct bpf_map_def SEC("maps") cache_stats = {
+	.type = BPF_MAP_TYPE_ARRAY,
+	.key_size = sizeof(uint32_t),
+	.value_size = sizeof(uint64_t),
+	.max_entries = __CACHE_MAX,
+};
+
+// Same as inspect_t, for a SID with a flow cache: counts its runs so that
+// cache hits can be told apart, and flushes the cache when asked to
+SEC("cached_t")
+int __cached_t(struct __sk_buff *skb)
+{
+	uint32_t key = CACHE_RUNS;
+	uint64_t *val;
+
+	val = bpf_map_lookup_elem(&cache_stats, &key);
+	if (val)
+		__sync_fetch_and_add(val, 1);
+
+	key = CACHE_FLUSH;
+	val = bpf_map_lookup_elem(&cache_stats, &key);
+	if (val && *val && bpf_lwt_seg6_cache_flush(skb))
+		return BPF_DROP;
+
+	return inspect_t(skb);
+}
+
 char __license[] SEC("license") = "GPL";
@@ -20,8 +20,19 @@
 #
 # An UDP datagram is sent from fb00::1 to fb00::6. The test succeeds if this
 # datagram can be read on NS6 when binding to fb00::6.
+#
+# fd00::1 is then moved to a prog array slot, through test_lwt_seg6local_user:
+# the program of the slot is swapped while datagrams are flowing, none may be
+# lost, and packets must be dropped while the slot is empty. A prog array not
+# yet owned by LWT_SEG6LOCAL programs must be refused.
+#
+# fd00::3 is finally moved to a slot as well, with a flow cache. The program
+# counts its runs: only the first datagram of the flow may run it, until a map
+# of the program is updated or the program flushes the cache.
 
 TMP_FILE="/tmp/selftest_lwt_seg6local.txt"
+BPF_FS="/tmp/selftest_lwt_seg6local_bpffs"
+SEG6_USER=./test_lwt_seg6local_user
 
 cleanup()
 {
@@ -39,6 +50,42 @@ cleanup()
 	ip netns del ns5 2> /dev/null
 	ip netns del ns6 2> /dev/null
 	rm -f $TMP_FILE
+	umount $BPF_FS 2> /dev/null
+	rmdir $BPF_FS 2> /dev/null
+}
+
+# send_datagrams <count> [<cmd run after half of them>]
+# succeeds if all datagrams reached NS6
+send_datagrams()
+{
+	local count=$1 i recv
+
+	ip netns exec ns6 nc -l -6 -u -d 7330 > $TMP_FILE &
+	recv=$!
+	sleep 1
+
+	for i in $(seq 1 $count); do
+		ip netns exec ns1 taskset -c 0 bash -c "echo 'seq $i' | nc -w0 -6 -u -p 2121 -s fb00::1 fb00::6 7330"
+		if [ $i -eq $((count / 2)) ] && [ -n "$2" ]; then
+			$2
+		fi
+		sleep 0.1
+	done
+	sleep 2
+	kill -INT $recv
+
+	[ $(grep -c '^seq' $TMP_FILE) -eq $count ]
+}
+
+# cached_runs <count> <expected runs>
+# sends datagrams from CPU 0, so that they share one cache table, and
+# succeeds if the program of fd00::3 ran the expected number of times
+cached_runs()
+{
+	local before=$($SEG6_USER get $BPF_FS/slot_t_stats 0)
+
+	send_datagrams $1
+	[ $(($($SEG6_USER get $BPF_FS/slot_t_stats 0) - before)) -eq $2 ]
 }
 
 set -e
@@ -137,4 +184,48 @@ if [[ $(< $TMP_FILE) != "foobar" ]]; then
 	exit 1
 fi
 
+mkdir -p $BPF_FS
+mount -t bpf bpf $BPF_FS
+
+# an array never used by LWT_SEG6LOCAL programs is refused
+$SEG6_USER create $BPF_FS/unowned
+if ip netns exec ns3 $SEG6_USER route $BPF_FS/unowned fd00::2 veth4 2> /dev/null; then
+	exit 1
+fi
+
+$SEG6_USER create $BPF_FS/slot
+$SEG6_USER set $BPF_FS/slot test_lwt_seg6local.o add_egr_x
+ip netns exec ns3 ip -6 route del fd00::1
+ip netns exec ns3 $SEG6_USER route $BPF_FS/slot fd00::1 veth4
+
+# swap the program while traffic is flowing
+send_datagrams 20 "$SEG6_USER set $BPF_FS/slot test_lwt_seg6local.o add_egr_x"
+
+# an empty slot drops packets
+$SEG6_USER clear $BPF_FS/slot
+if send_datagrams 2; then
+	exit 1
+fi
+
+$SEG6_USER set $BPF_FS/slot test_lwt_seg6local.o add_egr_x
+send_datagrams 2
+
+$SEG6_USER create $BPF_FS/slot_t
+$SEG6_USER set $BPF_FS/slot_t test_lwt_seg6local.o cached_t
+ip netns exec ns5 ip -6 route del fd00::3
+ip netns exec ns5 $SEG6_USER route $BPF_FS/slot_t fd00::3 veth8 64
+
+# the first datagram misses, the next ones hit
+cached_runs 5 1
+
+# updating a map of the program invalidates the cached verdicts
+$SEG6_USER put $BPF_FS/slot_t_stats 1 0
+cached_runs 5 1
+
+# a program flushing the cache never gets its verdicts cached
+$SEG6_USER put $BPF_FS/slot_t_stats 1 1
+cached_runs 5 5
+$SEG6_USER put $BPF_FS/slot_t_stats 1 0
+cached_runs 5 1
+
 exit 0
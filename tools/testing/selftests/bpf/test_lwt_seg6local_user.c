@@ -0,0 +1,307 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Helper of test_lwt_seg6local.sh for End.BPF routes running the program
+ * stored in a prog array slot, which iproute2 cannot set up:
+ *
+ *   create <pin>			create a one slot prog array
+ *   set <pin> <obj> <sec>		load program <sec> into the slot
+ *   clear <pin>			empty the slot
+ *   route <pin> <sid> <dev> [<size>]	add an End.BPF route using the slot,
+ *					with a flow cache of <size> entries
+ *   get <pin> <key>			print a value of an array of u64
+ *   put <pin> <key> <value>		update a value of an array of u64
+ *
+ * When the object of <obj> has a "cache_stats" map, set pins it next to
+ * the slot, as <pin>_stats.
+ *
+ * test_seg6_lb.sh uses it to add End.LB routes as well:
+ *
+ *   lb da|srh <sid> <dev> <backend>...	add an End.LB route
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/bpf.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/lwtunnel.h>
+#include <linux/seg6_local.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include "bpf_rlimit.h"
+
+struct nl_req {
+	struct nlmsghdr nh;
+	struct rtmsg rtm;
+	char buf[512];
+};
+
+static struct rtattr *nl_attr(struct nlmsghdr *nh, int type,
+			      const void *data, int len)
+{
+	struct rtattr *rta;
+
+	rta = (struct rtattr *)((char *)nh + NLMSG_ALIGN(nh->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len)
+		memcpy(RTA_DATA(rta), data, len);
+	nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+
+	return rta;
+}
+
+static void nl_nest_end(struct nlmsghdr *nh, struct rtattr *nest)
+{
+	nest->rta_len = (char *)nh + nh->nlmsg_len - (char *)nest;
+}
+
+/* start an RTM_NEWROUTE request for a seg6local route to <sid>, returns
+ * the RTA_ENCAP nest to be closed once the action attributes are in
+ */
+static int route_begin(struct nl_req *req, const char *sid, const char *dev,
+		       __u32 action, struct rtattr **encap)
+{
+	__u16 encap_type = LWTUNNEL_ENCAP_SEG6_LOCAL;
+	struct in6_addr dst;
+	__u32 oif;
+
+	if (inet_pton(AF_INET6, sid, &dst) != 1)
+		return -EINVAL;
+
+	oif = if_nametoindex(dev);
+	if (!oif)
+		return -ENODEV;
+
+	memset(req, 0, sizeof(*req));
+	req->nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+	req->nh.nlmsg_type = RTM_NEWROUTE;
+	req->nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE |
+			      NLM_F_EXCL;
+	req->rtm.rtm_family = AF_INET6;
+	req->rtm.rtm_dst_len = 128;
+	req->rtm.rtm_table = RT_TABLE_MAIN;
+	req->rtm.rtm_protocol = RTPROT_BOOT;
+	req->rtm.rtm_scope = RT_SCOPE_UNIVERSE;
+	req->rtm.rtm_type = RTN_UNICAST;
+
+	nl_attr(&req->nh, RTA_DST, &dst, sizeof(dst));
+	nl_attr(&req->nh, RTA_OIF, &oif, sizeof(oif));
+	nl_attr(&req->nh, RTA_ENCAP_TYPE, &encap_type, sizeof(encap_type));
+	*encap = nl_attr(&req->nh, RTA_ENCAP, NULL, 0);
+	nl_attr(&req->nh, SEG6_LOCAL_ACTION, &action, sizeof(action));
+
+	return 0;
+}
+
+static int route_commit(struct nl_req *req)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+	struct nlmsgerr *err;
+	char ack[1024];
+	int fd, len;
+
+	fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (fd < 0)
+		return -errno;
+
+	if (sendto(fd, req, req->nh.nlmsg_len, 0, (struct sockaddr *)&sa,
+		   sizeof(sa)) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	len = recv(fd, ack, sizeof(ack), 0);
+	close(fd);
+	if (len < (int)NLMSG_LENGTH(sizeof(*err)))
+		return -EPROTO;
+
+	err = NLMSG_DATA((struct nlmsghdr *)ack);
+	return err->error;
+}
+
+static int add_route(int map_fd, const char *sid, const char *dev,
+		     __u32 cache_size)
+{
+	struct rtattr *encap, *bpf;
+	struct nl_req req;
+	__u32 index = 0;
+	int err;
+
+	err = route_begin(&req, sid, dev, SEG6_LOCAL_ACTION_END_BPF, &encap);
+	if (err)
+		return err;
+
+	bpf = nl_attr(&req.nh, SEG6_LOCAL_BPF, NULL, 0);
+	nl_attr(&req.nh, SEG6_LOCAL_BPF_PROG_ARRAY, &map_fd, sizeof(map_fd));
+	nl_attr(&req.nh, SEG6_LOCAL_BPF_PROG_INDEX, &index, sizeof(index));
+	nl_attr(&req.nh, SEG6_LOCAL_BPF_PROG_NAME, "slot", sizeof("slot"));
+	if (cache_size)
+		nl_attr(&req.nh, SEG6_LOCAL_BPF_PROG_CACHE, &cache_size,
+			sizeof(cache_size));
+	nl_nest_end(&req.nh, bpf);
+	nl_nest_end(&req.nh, encap);
+
+	return route_commit(&req);
+}
+
+static int add_lb_route(const char *mode, const char *sid, const char *dev,
+			char **backends, int count)
+{
+	struct rtattr *encap, *lb, *list, *entry;
+	struct in6_addr addr;
+	struct nl_req req;
+	__u32 lb_mode;
+	int i, err;
+
+	if (!strcmp(mode, "da"))
+		lb_mode = SEG6_LOCAL_LB_MODE_DA;
+	else if (!strcmp(mode, "srh"))
+		lb_mode = SEG6_LOCAL_LB_MODE_SRH;
+	else
+		return -EINVAL;
+
+	err = route_begin(&req, sid, dev, SEG6_LOCAL_ACTION_END_LB, &encap);
+	if (err)
+		return err;
+
+	lb = nl_attr(&req.nh, SEG6_LOCAL_LB, NULL, 0);
+	nl_attr(&req.nh, SEG6_LOCAL_LB_MODE, &lb_mode, sizeof(lb_mode));
+	list = nl_attr(&req.nh, SEG6_LOCAL_LB_BACKENDS, NULL, 0);
+	for (i = 0; i < count; i++) {
+		if (inet_pton(AF_INET6, backends[i], &addr) != 1)
+			return -EINVAL;
+
+		entry = nl_attr(&req.nh, SEG6_LOCAL_LB_BACKEND, NULL, 0);
+		nl_attr(&req.nh, SEG6_LOCAL_LB_BACKEND_SID, &addr,
+			sizeof(addr));
+		nl_nest_end(&req.nh, entry);
+	}
+	nl_nest_end(&req.nh, list);
+	nl_nest_end(&req.nh, lb);
+	nl_nest_end(&req.nh, encap);
+
+	return route_commit(&req);
+}
+
+static int load_prog(const char *file, const char *sec, const char *pin)
+{
+	struct bpf_program *prog, *found = NULL;
+	struct bpf_object *obj;
+	struct bpf_map *stats;
+	char path[256];
+
+	obj = bpf_object__open(file);
+	if (libbpf_get_error(obj))
+		return -ENOENT;
+
+	bpf_object__for_each_program(prog, obj) {
+		const char *title = bpf_program__title(prog, false);
+
+		/* the encap program of the object is an LWT_IN one */
+		if (!strcmp(title, "encap_srh"))
+			bpf_program__set_type(prog, BPF_PROG_TYPE_LWT_IN);
+		else
+			bpf_program__set_type(prog,
+					      BPF_PROG_TYPE_LWT_SEG6LOCAL);
+		if (!strcmp(title, sec))
+			found = prog;
+	}
+
+	if (!found || bpf_object__load(obj))
+		return -EINVAL;
+
+	stats = bpf_object__find_map_by_name(obj, "cache_stats");
+	if (stats) {
+		snprintf(path, sizeof(path), "%s_stats", pin);
+		unlink(path);
+		if (bpf_map__pin(stats, path))
+			return -EINVAL;
+	}
+
+	/* the object is left open, the slot holds the program anyway */
+	return bpf_program__fd(found);
+}
+
+int main(int argc, char **argv)
+{
+	__u64 value;
+	__u32 key = 0;
+	int map_fd, prog_fd, err;
+
+	if (argc < 3)
+		goto usage;
+
+	if (!strcmp(argv[1], "lb") && argc >= 6) {
+		err = add_lb_route(argv[2], argv[3], argv[4], argv + 5,
+				   argc - 5);
+		if (err) {
+			errno = -err;
+			perror(argv[1]);
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	if (!strcmp(argv[1], "create")) {
+		map_fd = bpf_create_map(BPF_MAP_TYPE_PROG_ARRAY, sizeof(__u32),
+					sizeof(__u32), 1, 0);
+		if (map_fd < 0 || bpf_obj_pin(map_fd, argv[2])) {
+			perror("create");
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	map_fd = bpf_obj_get(argv[2]);
+	if (map_fd < 0) {
+		perror(argv[2]);
+		return EXIT_FAILURE;
+	}
+
+	if (!strcmp(argv[1], "set") && argc == 5) {
+		prog_fd = load_prog(argv[3], argv[4], argv[2]);
+		if (prog_fd < 0) {
+			fprintf(stderr, "failed to load %s from %s\n",
+				argv[4], argv[3]);
+			return EXIT_FAILURE;
+		}
+		err = bpf_map_update_elem(map_fd, &key, &prog_fd, BPF_ANY);
+	} else if (!strcmp(argv[1], "clear") && argc == 3) {
+		err = bpf_map_delete_elem(map_fd, &key);
+	} else if (!strcmp(argv[1], "route") && (argc == 5 || argc == 6)) {
+		err = add_route(map_fd, argv[3], argv[4],
+				argc == 6 ? atoi(argv[5]) : 0);
+		if (err)
+			errno = -err;
+	} else if (!strcmp(argv[1], "get") && argc == 4) {
+		key = atoi(argv[3]);
+		err = bpf_map_lookup_elem(map_fd, &key, &value);
+		if (!err)
+			printf("%llu\n", (unsigned long long)value);
+	} else if (!strcmp(argv[1], "put") && argc == 5) {
+		key = atoi(argv[3]);
+		value = strtoull(argv[4], NULL, 0);
+		err = bpf_map_update_elem(map_fd, &key, &value, BPF_ANY);
+	} else {
+		goto usage;
+	}
+
+	if (err) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+
+usage:
+	fprintf(stderr, "usage: %s create|set|clear|route|get|put <pin> [args]\n"
+		"       %s lb da|srh <sid> <dev> <backend>...\n",
+		argv[0], argv[0]);
+	return EXIT_FAILURE;
+}
@@ -15,6 +15,7 @@
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <sys/wait.h>
 
@@ -1150,6 +1151,81 @@ static void test_map_wronly(void)
 	assert(bpf_map_get_next_key(fd, &key, &value) == -1 && errno == EPERM);
 }
 
+#define MAP_TTL_MS		1000
+#define MAP_TTL_TIMEOUT_MS	(10 * MAP_TTL_MS)
+#define MAP_TTL_TICK_US		100000
+
+static unsigned long map_ttl_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Expiry is checked with generous slack on each side, so that a loaded
+ * machine only makes the test slower: elements touched ten times per ttl
+ * must stay, elements idle for twice the ttl must be gone, and the reaper
+ * is given ten ttl periods to unlink them.
+ */
+static void test_map_ttl(void)
+{
+	struct bpf_create_map_attr attr = {};
+	unsigned long start;
+	int fd, key, value;
+
+	attr.map_type = BPF_MAP_TYPE_HASH;
+	attr.map_flags = map_flags;
+	attr.key_size = sizeof(key);
+	attr.value_size = sizeof(value);
+	attr.max_entries = MAP_SIZE;
+	attr.map_ttl = MAP_TTL_MS;
+
+	fd = bpf_create_map_xattr(&attr);
+	if (fd < 0) {
+		printf("Failed to create map with ttl '%s'!\n",
+		       strerror(errno));
+		exit(1);
+	}
+
+	key = 1;
+	value = 1234;
+	assert(bpf_map_update_elem(fd, &key, &value, BPF_NOEXIST) == 0);
+	key = 2;
+	assert(bpf_map_update_elem(fd, &key, &value, BPF_NOEXIST) == 0);
+
+	/* Keep key=1 alive by looking it up, let key=2 expire. */
+	key = 1;
+	start = map_ttl_now_ms();
+	while (map_ttl_now_ms() - start < 2 * MAP_TTL_MS) {
+		usleep(MAP_TTL_TICK_US);
+		assert(bpf_map_lookup_elem(fd, &key, &value) == 0 &&
+		       value == 1234);
+	}
+
+	key = 2;
+	assert(bpf_map_lookup_elem(fd, &key, &value) == -1 && errno == ENOENT);
+
+	/* An expired element can be created again. */
+	value = 5678;
+	assert(bpf_map_update_elem(fd, &key, &value, BPF_NOEXIST) == 0);
+	assert(bpf_map_lookup_elem(fd, &key, &value) == 0 && value == 5678);
+
+	/* The reaper eventually unlinks idle elements. */
+	start = map_ttl_now_ms();
+	while (bpf_map_get_next_key(fd, NULL, &key) == 0) {
+		assert(map_ttl_now_ms() - start < MAP_TTL_TIMEOUT_MS);
+		usleep(MAP_TTL_TICK_US);
+	}
+	assert(errno == ENOENT);
+
+	close(fd);
+
+	/* Expiry is not supported for other map types. */
+	attr.map_type = BPF_MAP_TYPE_PERCPU_HASH;
+	assert(bpf_create_map_xattr(&attr) == -1 && errno == EINVAL);
+}
+
 static void run_all_tests(void)
 {
 	test_hashmap(0, NULL);
@@ -1170,6 +1246,8 @@ static void run_all_tests(void)
 
 	test_map_rdonly();
 	test_map_wronly();
+
+	test_map_ttl();
 }
 
 int main(void)
@@ -17,6 +17,7 @@ typedef __u16 __sum16;
 #include <arpa/inet.h>
 #include <linux/if_ether.h>
 #include <linux/if_packet.h>
+#include <linux/if_tun.h>
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <linux/tcp.h>
@@ -27,7 +28,15 @@ typedef __u16 __sum16;
 #include <sys/ioctl.h>
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <sys/socket.h>
 #include <fcntl.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/lwtunnel.h>
+#include <linux/sched.h>
+#include <linux/seg6.h>
+#include <linux/seg6_iptunnel.h>
 
 #include <linux/bpf.h>
 #include <linux/err.h>
@@ -1542,6 +1551,495 @@ static void test_get_stack_raw_tp(void)
 	bpf_object__close(obj);
 }
 
+/* the verifier caps log_size at UINT_MAX >> 8 */
+#define VERIF_SCALE_LOG_SIZE	(16 * 1024 * 1024 - 1)
+
+static enum bpf_prog_type verif_scale_type;
+static char *verif_scale_log;
+
+/* Called by libbpf with the relocated insns of every program in the
+ * object: time a plain load, then load again with the verifier log on
+ * to pick up the complexity summary.
+ */
+static int verif_scale_prep(struct bpf_program *prog, int n,
+			    struct bpf_insn *insns, int insns_cnt,
+			    struct bpf_prog_prep_result *res)
+{
+	int processed = -1, total_states = -1, peak_states = -1;
+	const char *title = bpf_program__title(prog, false);
+	struct timespec start, end;
+	__u32 duration = 0;
+	__u64 usec;
+	char *p;
+	int fd;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	fd = bpf_load_program(verif_scale_type, insns, insns_cnt, "GPL", 0,
+			      NULL, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (CHECK(fd < 0, title, "load err %d errno %d\n", fd, errno))
+		return -1;
+	close(fd);
+	usec = (end.tv_sec - start.tv_sec) * 1000000ULL +
+	       (end.tv_nsec - start.tv_nsec) / 1000;
+
+	memset(verif_scale_log, 0, VERIF_SCALE_LOG_SIZE);
+	fd = bpf_verify_program(verif_scale_type, insns, insns_cnt, 0, "GPL",
+				0, verif_scale_log, VERIF_SCALE_LOG_SIZE, 1);
+	if (CHECK(fd < 0, title, "verify err %d errno %d\n", fd, errno))
+		return -1;
+	close(fd);
+
+	p = strstr(verif_scale_log, "processed ");
+	if (CHECK(!p || sscanf(p, "processed %d insns (limit %*d), total_states %d peak_states %d",
+			       &processed, &total_states, &peak_states) != 3,
+		  title, "no complexity summary in verifier log\n"))
+		return -1;
+
+	printf("%s:%s: insns %d processed %d total_states %d peak_states %d load %llu usec\n",
+	       __func__, title, insns_cnt, processed, total_states,
+	       peak_states, usec);
+
+	res->new_insn_ptr = insns;
+	res->new_insn_cnt = insns_cnt;
+	res->pfd = NULL;
+	return 0;
+}
+
+static void test_verif_scale(void)
+{
+	struct {
+		const char *file;
+		enum bpf_prog_type type;
+	} tests[] = {
+		{ "./test_xdp.o", BPF_PROG_TYPE_XDP },
+		{ "./test_l4lb.o", BPF_PROG_TYPE_SCHED_CLS },
+		{ "./test_l4lb_noinline.o", BPF_PROG_TYPE_SCHED_CLS },
+		{ "./test_xdp_noinline.o", BPF_PROG_TYPE_XDP },
+		{ "./test_tunnel_kern.o", BPF_PROG_TYPE_SCHED_CLS },
+		{ "./test_lwt_seg6local.o", BPF_PROG_TYPE_LWT_SEG6LOCAL },
+	};
+	struct bpf_program *prog;
+	struct bpf_object *obj;
+	__u32 duration = 0;
+	int i, err;
+
+	verif_scale_log = malloc(VERIF_SCALE_LOG_SIZE);
+	if (CHECK(!verif_scale_log, "malloc", "errno %d\n", errno))
+		return;
+
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		obj = bpf_object__open(tests[i].file);
+		err = libbpf_get_error(obj);
+		if (CHECK(err, tests[i].file, "open err %d\n", err))
+			continue;
+
+		verif_scale_type = tests[i].type;
+		bpf_object__for_each_program(prog, obj) {
+			bpf_program__set_type(prog, tests[i].type);
+			bpf_program__set_prep(prog, 1, verif_scale_prep);
+		}
+
+		err = bpf_object__load(obj);
+		CHECK(err, tests[i].file, "load err %d\n", err);
+		bpf_object__close(obj);
+	}
+
+	free(verif_scale_log);
+}
+
+#define XDP_LIVE_DEV		"xdp_live0"
+#define XDP_LIVE_REPEAT		64
+
+enum {
+	XDP_LIVE_ACTION,
+	XDP_LIVE_IFINDEX,
+	XDP_LIVE_RUNS,
+};
+
+/* number of frames queued on the tap device */
+static int xdp_live_drain(int tap_fd)
+{
+	char buf[2048];
+	int n = 0;
+
+	while (read(tap_fd, buf, sizeof(buf)) > 0)
+		n++;
+
+	return n;
+}
+
+static int xdp_live_run(int prog_fd, int map_fd, int tap_fd, __u32 action,
+			__u32 ifindex, __u32 *runs, int *frames)
+{
+	__u32 key, zero = 0, duration, retval;
+	int err;
+
+	key = XDP_LIVE_ACTION;
+	bpf_map_update_elem(map_fd, &key, &action, BPF_ANY);
+	key = XDP_LIVE_RUNS;
+	bpf_map_update_elem(map_fd, &key, &zero, BPF_ANY);
+
+	err = bpf_prog_test_run_xdp_live(prog_fd, ifindex, XDP_LIVE_REPEAT,
+					 &pkt_v4, sizeof(pkt_v4), &retval,
+					 &duration);
+	if (err)
+		return err;
+	if (retval != action)
+		return -1;
+
+	bpf_map_lookup_elem(map_fd, &key, runs);
+	*frames = xdp_live_drain(tap_fd);
+	return 0;
+}
+
+static int xdp_live_attr(int prog_fd, __u32 flags, __u32 ifindex,
+			 void *data_out)
+{
+	char buf[128];
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.test.prog_fd = prog_fd;
+	attr.test.data_in = ptr_to_u64(&pkt_v4);
+	attr.test.data_size_in = sizeof(pkt_v4);
+	attr.test.data_out = ptr_to_u64(data_out);
+	attr.test.data_size_out = data_out ? sizeof(buf) : 0;
+	attr.test.repeat = 1;
+	attr.test.flags = flags;
+	attr.test.ifindex = ifindex;
+
+	return syscall(__NR_bpf, BPF_PROG_TEST_RUN, &attr, sizeof(attr));
+}
+
+static void test_xdp_live(void)
+{
+	const char *file = "./test_xdp_live.o";
+	struct ifreq ifr = {
+		.ifr_flags = IFF_TAP | IFF_NO_PI,
+	};
+	int err, prog_fd, map_fd, tap_fd, frames;
+	__u32 duration = 0, key, ifindex, runs;
+	struct bpf_object *obj;
+	char buf[128];
+
+	err = bpf_prog_load(file, BPF_PROG_TYPE_XDP, &obj, &prog_fd);
+	if (err) {
+		error_cnt++;
+		return;
+	}
+
+	map_fd = bpf_find_map(__func__, obj, "xdp_live");
+	if (map_fd < 0)
+		goto out;
+
+	/* a tap device queues what it transmits for its reader */
+	tap_fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+	if (CHECK(tap_fd < 0, "open tun", "errno %d\n", errno))
+		goto out;
+	strncpy(ifr.ifr_name, XDP_LIVE_DEV, sizeof(ifr.ifr_name) - 1);
+	err = ioctl(tap_fd, TUNSETIFF, &ifr);
+	if (CHECK(err, "TUNSETIFF", "errno %d\n", errno))
+		goto out_tap;
+	err = system("ip link set dev " XDP_LIVE_DEV " up");
+	if (CHECK(err, "link up", "err %d\n", err))
+		goto out_tap;
+	ifindex = if_nametoindex(XDP_LIVE_DEV);
+
+	key = XDP_LIVE_IFINDEX;
+	bpf_map_update_elem(map_fd, &key, &ifindex, BPF_ANY);
+
+	/* every frame is run once and transmitted back */
+	err = xdp_live_run(prog_fd, map_fd, tap_fd, XDP_TX, ifindex,
+			   &runs, &frames);
+	CHECK(err || runs != XDP_LIVE_REPEAT || frames != XDP_LIVE_REPEAT,
+	      "xdp_tx", "err %d errno %d runs %u frames %d\n",
+	      err, errno, runs, frames);
+
+	/* or redirected to the device */
+	err = xdp_live_run(prog_fd, map_fd, tap_fd, XDP_REDIRECT, ifindex,
+			   &runs, &frames);
+	CHECK(err || runs != XDP_LIVE_REPEAT || frames != XDP_LIVE_REPEAT,
+	      "xdp_redirect", "err %d errno %d runs %u frames %d\n",
+	      err, errno, runs, frames);
+
+	/* dropped frames go nowhere */
+	err = xdp_live_run(prog_fd, map_fd, tap_fd, XDP_DROP, ifindex,
+			   &runs, &frames);
+	CHECK(err || runs != XDP_LIVE_REPEAT || frames != 0, "xdp_drop",
+	      "err %d errno %d runs %u frames %d\n",
+	      err, errno, runs, frames);
+
+	/* unknown flags */
+	err = xdp_live_attr(prog_fd, BPF_F_TEST_XDP_LIVE_FRAMES << 1,
+			    ifindex, NULL);
+	CHECK(err != -1 || errno != EINVAL, "unknown flags",
+	      "err %d errno %d\n", err, errno);
+
+	/* live frames are not copied out */
+	err = xdp_live_attr(prog_fd, BPF_F_TEST_XDP_LIVE_FRAMES, ifindex,
+			    buf);
+	CHECK(err != -1 || errno != EINVAL, "live data_out",
+	      "err %d errno %d\n", err, errno);
+
+	/* a device is only meaningful with live frames */
+	err = xdp_live_attr(prog_fd, 0, ifindex, buf);
+	CHECK(err != -1 || errno != EINVAL, "ifindex without live",
+	      "err %d errno %d\n", err, errno);
+
+	err = xdp_live_attr(prog_fd, BPF_F_TEST_XDP_LIVE_FRAMES, 0, NULL);
+	CHECK(err != -1 || errno != ENODEV, "live without device",
+	      "err %d errno %d\n", err, errno);
+
+out_tap:
+	close(tap_fd);
+out:
+	bpf_object__close(obj);
+}
+
+#define FIB_SEG6_NS	"test_fib_seg6"
+#define FIB_SEG6_BUF	256
+
+struct fib_seg6_ctx {
+	__u32 short_buf;
+	int ret;
+	__u8 buf[FIB_SEG6_BUF];
+};
+
+struct fib_seg6_req {
+	struct nlmsghdr nh;
+	struct rtmsg rtm;
+	char buf[512];
+};
+
+static struct rtattr *fib_seg6_attr(struct nlmsghdr *nh, int type,
+				    const void *data, int len)
+{
+	struct rtattr *rta;
+
+	rta = (struct rtattr *)((char *)nh + NLMSG_ALIGN(nh->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len)
+		memcpy(RTA_DATA(rta), data, len);
+	nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+
+	return rta;
+}
+
+static void fib_seg6_nest_end(struct nlmsghdr *nh, struct rtattr *nest)
+{
+	nest->rta_len = (char *)nh + nh->nlmsg_len - (char *)nest;
+}
+
+/* a one segment SRH towards seg */
+static void fib_seg6_srh(struct ipv6_sr_hdr *srh, const char *seg)
+{
+	memset(srh, 0, sizeof(*srh) + sizeof(struct in6_addr));
+	srh->hdrlen = 2;
+	srh->type = IPV6_SRCRT_TYPE_4;
+	inet_pton(AF_INET6, seg, &srh->segments[0]);
+}
+
+/* 2001:db8:12::/64 steered into a policy with a traffic class on mark 1,
+ * which iproute2 cannot set up
+ */
+static int fib_seg6_add_classes(int oif)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+	char tuninfo[sizeof(struct seg6_iptunnel_encap) +
+		     sizeof(struct ipv6_sr_hdr) + sizeof(struct in6_addr)];
+	char srh[sizeof(struct ipv6_sr_hdr) + sizeof(struct in6_addr)];
+	struct seg6_iptunnel_encap *encap = (void *)tuninfo;
+	__u16 encap_type = LWTUNNEL_ENCAP_SEG6;
+	struct rtattr *nest, *list, *class;
+	__u32 key = SEG6_IPTUN_CLASS_MARK;
+	struct fib_seg6_req req;
+	struct nlmsgerr *err;
+	struct in6_addr dst;
+	__u32 mark = 1;
+	char ack[1024];
+	int fd, len;
+
+	encap->mode = SEG6_IPTUN_MODE_ENCAP;
+	fib_seg6_srh(encap->srh, "fc00::1");
+	fib_seg6_srh((struct ipv6_sr_hdr *)srh, "fc00::2");
+	inet_pton(AF_INET6, "2001:db8:12::", &dst);
+
+	memset(&req, 0, sizeof(req));
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+	req.nh.nlmsg_type = RTM_NEWROUTE;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE |
+			     NLM_F_EXCL;
+	req.rtm.rtm_family = AF_INET6;
+	req.rtm.rtm_dst_len = 64;
+	req.rtm.rtm_table = RT_TABLE_MAIN;
+	req.rtm.rtm_protocol = RTPROT_BOOT;
+	req.rtm.rtm_scope = RT_SCOPE_UNIVERSE;
+	req.rtm.rtm_type = RTN_UNICAST;
+
+	fib_seg6_attr(&req.nh, RTA_DST, &dst, sizeof(dst));
+	fib_seg6_attr(&req.nh, RTA_OIF, &oif, sizeof(oif));
+	fib_seg6_attr(&req.nh, RTA_ENCAP_TYPE, &encap_type,
+		      sizeof(encap_type));
+	nest = fib_seg6_attr(&req.nh, RTA_ENCAP, NULL, 0);
+	fib_seg6_attr(&req.nh, SEG6_IPTUNNEL_SRH, tuninfo, sizeof(tuninfo));
+	fib_seg6_attr(&req.nh, SEG6_IPTUNNEL_CLASS_KEY, &key, sizeof(key));
+	list = fib_seg6_attr(&req.nh, SEG6_IPTUNNEL_CLASSES, NULL, 0);
+	class = fib_seg6_attr(&req.nh, SEG6_IPTUNNEL_CLASS, NULL, 0);
+	fib_seg6_attr(&req.nh, SEG6_IPTUNNEL_CLASS_VALUE, &mark, sizeof(mark));
+	fib_seg6_attr(&req.nh, SEG6_IPTUNNEL_CLASS_SRH, srh, sizeof(srh));
+	fib_seg6_nest_end(&req.nh, class);
+	fib_seg6_nest_end(&req.nh, list);
+	fib_seg6_nest_end(&req.nh, nest);
+
+	fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (fd < 0)
+		return -errno;
+
+	if (sendto(fd, &req, req.nh.nlmsg_len, 0, (struct sockaddr *)&sa,
+		   sizeof(sa)) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	len = recv(fd, ack, sizeof(ack), 0);
+	close(fd);
+	if (len < (int)NLMSG_LENGTH(sizeof(*err)))
+		return -EPROTO;
+
+	err = NLMSG_DATA((struct nlmsghdr *)ack);
+	return err->error;
+}
+
+/* look dst up from veth1 with BPF_FIB_LOOKUP_SEG6 */
+static int fib_seg6_lookup(int prog_fd, int map_fd, const char *dst,
+			   bool short_buf, struct fib_seg6_ctx *c)
+{
+	struct bpf_fib_lookup *params = (void *)c->buf;
+	__u32 key = 0, duration, retval, size;
+	char buf[128];
+	int err;
+
+	memset(c, 0, sizeof(*c));
+	c->short_buf = short_buf;
+	params->family = AF_INET6;
+	params->ifindex = if_nametoindex("veth1");
+	inet_pton(AF_INET6, "2001:db8:2::1", params->ipv6_src);
+	inet_pton(AF_INET6, dst, params->ipv6_dst);
+
+	err = bpf_map_update_elem(map_fd, &key, c, BPF_ANY);
+	if (err)
+		return err;
+
+	err = bpf_prog_test_run(prog_fd, 1, &pkt_v6, sizeof(pkt_v6),
+				buf, &size, &retval, &duration);
+	if (err || retval != XDP_PASS)
+		return -1;
+
+	return bpf_map_lookup_elem(map_fd, &key, c);
+}
+
+static void test_fib_seg6(void)
+{
+	const char *file = "./test_fib_seg6.o";
+	struct fib_seg6_ctx c;
+	struct bpf_fib_lookup *params = (void *)c.buf;
+	struct bpf_fib_seg6 *seg6 = (void *)(params + 1);
+	struct ipv6_sr_hdr *srh = (void *)seg6->srh;
+	struct in6_addr gw, src, seg, in_src;
+	int err, prog_fd, map_fd, oif;
+	int host_ns = -1, ns = -1;
+	struct bpf_object *obj;
+	__u32 duration = 0;
+
+	err = system("ip netns add " FIB_SEG6_NS " && "
+		"ip -n " FIB_SEG6_NS " link add veth0 type veth peer name veth1 && "
+		"ip -n " FIB_SEG6_NS " link set veth0 up && "
+		"ip -n " FIB_SEG6_NS " link set veth1 up && "
+		"ip netns exec " FIB_SEG6_NS " sysctl -qw net.ipv6.conf.all.forwarding=1 && "
+		"ip -n " FIB_SEG6_NS " -6 addr add 2001:db8:1::1/64 dev veth0 nodad && "
+		"ip -n " FIB_SEG6_NS " -6 neigh add 2001:db8:1::2 lladdr 02:00:00:00:00:02 dev veth0 && "
+		"ip -n " FIB_SEG6_NS " -6 route add fc00::1/128 via 2001:db8:1::2 dev veth0 && "
+		"ip -n " FIB_SEG6_NS " -6 route add 2001:db8:10::/64 dev veth0 "
+			"encap seg6 mode encap segs fc00::1,fc00::2 && "
+		"ip -n " FIB_SEG6_NS " -6 route add 2001:db8:11::/64 dev veth0 "
+			"encap seg6 mode inline segs fc00::1");
+	if (CHECK(err, "setup", "err %d\n", err))
+		goto out_ns;
+
+	host_ns = open("/proc/self/ns/net", O_RDONLY);
+	ns = open("/var/run/netns/" FIB_SEG6_NS, O_RDONLY);
+	if (CHECK(host_ns < 0 || ns < 0, "open netns", "errno %d\n", errno))
+		goto out_ns;
+	err = syscall(__NR_setns, ns, CLONE_NEWNET);
+	if (CHECK(err, "setns", "errno %d\n", errno))
+		goto out_ns;
+
+	oif = if_nametoindex("veth0");
+	err = fib_seg6_add_classes(oif);
+	if (CHECK(err, "classes route", "err %d\n", err))
+		goto out_host;
+
+	err = bpf_prog_load(file, BPF_PROG_TYPE_XDP, &obj, &prog_fd);
+	if (CHECK(err, "load", "err %d errno %d\n", err, errno))
+		goto out_host;
+
+	map_fd = bpf_find_map(__func__, obj, "fib_seg6");
+	if (map_fd < 0)
+		goto out;
+
+	inet_pton(AF_INET6, "2001:db8:1::2", &gw);
+	inet_pton(AF_INET6, "2001:db8:1::1", &src);
+	inet_pton(AF_INET6, "2001:db8:2::1", &in_src);
+	inet_pton(AF_INET6, "fc00::1", &seg);
+
+	/* encap: outer source and first segment, forwarded to its gateway */
+	err = fib_seg6_lookup(prog_fd, map_fd, "2001:db8:10::1", false, &c);
+	CHECK(err || c.ret != oif || seg6->mode != SEG6_IPTUN_MODE_ENCAP ||
+	      seg6->srh_len != 40 || srh->first_segment != 1 ||
+	      memcmp(seg6->segment, &seg, sizeof(seg)) ||
+	      memcmp(seg6->ipv6_src, &src, sizeof(src)) ||
+	      memcmp(params->ipv6_src, &src, sizeof(src)) ||
+	      memcmp(params->ipv6_dst, &gw, sizeof(gw)) ||
+	      params->dmac[5] != 2, "encap",
+	      "err %d ret %d mode %d srh_len %d\n",
+	      err, c.ret, seg6->mode, seg6->srh_len);
+
+	/* inline: the source of the packet is kept */
+	err = fib_seg6_lookup(prog_fd, map_fd, "2001:db8:11::1", false, &c);
+	CHECK(err || c.ret != oif || seg6->mode != SEG6_IPTUN_MODE_INLINE ||
+	      seg6->srh_len != 40 ||
+	      memcmp(seg6->segment, &seg, sizeof(seg)) ||
+	      memcmp(params->ipv6_src, &in_src, sizeof(in_src)) ||
+	      memcmp(params->ipv6_dst, &gw, sizeof(gw)), "inline",
+	      "err %d ret %d mode %d srh_len %d\n",
+	      err, c.ret, seg6->mode, seg6->srh_len);
+
+	/* no room for the SRH, its length is still reported */
+	err = fib_seg6_lookup(prog_fd, map_fd, "2001:db8:10::1", true, &c);
+	CHECK(err || c.ret != -ENOSPC || seg6->srh_len != 40, "short buffer",
+	      "err %d ret %d srh_len %d\n", err, c.ret, seg6->srh_len);
+
+	/* per-class policies have no single SRH to describe */
+	err = fib_seg6_lookup(prog_fd, map_fd, "2001:db8:12::1", false, &c);
+	CHECK(err || c.ret != 0 || seg6->srh_len != 0, "classes",
+	      "err %d ret %d srh_len %d\n", err, c.ret, seg6->srh_len);
+
+out:
+	bpf_object__close(obj);
+out_host:
+	syscall(__NR_setns, host_ns, CLONE_NEWNET);
+out_ns:
+	if (ns >= 0)
+		close(ns);
+	if (host_ns >= 0)
+		close(host_ns);
+	system("ip netns del " FIB_SEG6_NS " 2> /dev/null");
+}
+
 int main(void)
 {
 	jit_enabled = is_jit_enabled();
@@ -1561,6 +2059,9 @@ int main(void)
 	test_stacktrace_build_id_nmi();
 	test_stacktrace_map_raw_tp();
 	test_get_stack_raw_tp();
+	test_verif_scale();
+	test_fib_seg6();
+	test_xdp_live();
 
 	printf("Summary: %d PASSED, %d FAILED\n", pass_cnt, error_cnt);
 	return error_cnt ? EXIT_FAILURE : EXIT_SUCCESS;
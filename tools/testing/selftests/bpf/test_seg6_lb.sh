@@ -0,0 +1,154 @@
+#!/bin/bash
+# Connects 5 network namespaces through veths:
+#
+#                           +---- NS4 (backend fd00::11)
+#   NS1 ---- NS2 ---- NS3 --+
+#                           +---- NS5 (backend fd00::12)
+#
+# NS1 sends UDP datagrams from fb00::1 to fb00::6. NS2 encapsulates them in
+# an outer IPv6 header with a Segment Routing Header towards a service SID of
+# NS3, which is bound to a seg6local End.LB action balancing between the two
+# backends. Both backends own fb00::6 and the remaining segments, so that the
+# datagrams are decapsulated on whichever backend the flow was steered to.
+#
+# - fd00::1 : End.LB in SRH mode, segments fd00::1. The backend SID is
+#   inserted before the service SID, which stays the last segment.
+# - fd00::3 : End.LB in DA mode, segments fd00::3 -> fd00::2. The backend
+#   SID replaces the active segment. Packets where the service SID is the
+#   last segment are dropped, as it is part of the L4 checksum.
+#
+# Each test sends a single flow, which must reach one backend only.
+#
+# End.LB routes are added through test_lwt_seg6local_user, as iproute2
+# cannot set them up.
+
+TMP_FILE="/tmp/selftest_seg6_lb.txt"
+SEG6_USER=./test_lwt_seg6local_user
+
+cleanup()
+{
+	if [ "$?" = "0" ]; then
+		echo "selftests: test_seg6_lb [PASS]";
+	else
+		echo "selftests: test_seg6_lb [FAILED]";
+	fi
+
+	set +e
+	ip netns del ns1 2> /dev/null
+	ip netns del ns2 2> /dev/null
+	ip netns del ns3 2> /dev/null
+	ip netns del ns4 2> /dev/null
+	ip netns del ns5 2> /dev/null
+	rm -f $TMP_FILE.4 $TMP_FILE.5
+}
+
+# send_flow <count>
+# succeeds if all datagrams of the flow reached the same backend
+send_flow()
+{
+	local count=$1 i recv4 recv5 n4 n5
+
+	ip netns exec ns4 nc -l -6 -u -d 7330 > $TMP_FILE.4 &
+	recv4=$!
+	ip netns exec ns5 nc -l -6 -u -d 7330 > $TMP_FILE.5 &
+	recv5=$!
+	sleep 1
+
+	for i in $(seq 1 $count); do
+		ip netns exec ns1 bash -c "echo 'seq $i' | nc -w0 -6 -u -p 2121 -s fb00::1 fb00::6 7330"
+		sleep 0.1
+	done
+	sleep 2
+	kill -INT $recv4 $recv5
+
+	n4=$(grep -c '^seq' $TMP_FILE.4 || true)
+	n5=$(grep -c '^seq' $TMP_FILE.5 || true)
+
+	[ $((n4 + n5)) -eq $count ] && [ $n4 -eq 0 -o $n5 -eq 0 ]
+}
+
+set -e
+
+ip netns add ns1
+ip netns add ns2
+ip netns add ns3
+ip netns add ns4
+ip netns add ns5
+
+trap cleanup 0 2 3 6 9
+
+ip link add veth1 type veth peer name veth2
+ip link add veth3 type veth peer name veth4
+ip link add veth5 type veth peer name veth6
+ip link add veth7 type veth peer name veth8
+
+ip link set veth1 netns ns1
+ip link set veth2 netns ns2
+ip link set veth3 netns ns2
+ip link set veth4 netns ns3
+ip link set veth5 netns ns3
+ip link set veth6 netns ns4
+ip link set veth7 netns ns3
+ip link set veth8 netns ns5
+
+ip netns exec ns1 ip link set dev veth1 up
+ip netns exec ns2 ip link set dev veth2 up
+ip netns exec ns2 ip link set dev veth3 up
+ip netns exec ns3 ip link set dev veth4 up
+ip netns exec ns3 ip link set dev veth5 up
+ip netns exec ns3 ip link set dev veth7 up
+ip netns exec ns4 ip link set dev veth6 up
+ip netns exec ns4 ip link set dev lo up
+ip netns exec ns5 ip link set dev veth8 up
+ip netns exec ns5 ip link set dev lo up
+
+# One prefix per link
+ip netns exec ns1 ip -6 addr add fb01::1/64 dev veth1 nodad
+ip netns exec ns2 ip -6 addr add fb01::2/64 dev veth2 nodad
+ip netns exec ns2 ip -6 addr add fb02::1/64 dev veth3 nodad
+ip netns exec ns3 ip -6 addr add fb02::2/64 dev veth4 nodad
+ip netns exec ns3 ip -6 addr add fb03::1/64 dev veth5 nodad
+ip netns exec ns4 ip -6 addr add fb03::2/64 dev veth6 nodad
+ip netns exec ns3 ip -6 addr add fb04::1/64 dev veth7 nodad
+ip netns exec ns5 ip -6 addr add fb04::2/64 dev veth8 nodad
+
+ip netns exec ns1 ip -6 addr add fb00::1/128 dev lo
+ip netns exec ns1 ip -6 route add fb00::6 via fb01::2 dev veth1
+
+ip netns exec ns2 ip -6 route add fb00::6 encap seg6 mode encap segs fd00::1 dev veth3
+ip netns exec ns2 ip -6 route add fd00::/16 via fb02::2 dev veth3
+
+ip netns exec ns3 ip -6 route add fd00::11 via fb03::2 dev veth5
+ip netns exec ns3 ip -6 route add fd00::12 via fb04::2 dev veth7
+ip netns exec ns3 $SEG6_USER lb srh fd00::1 veth4 fd00::11 fd00::12
+ip netns exec ns3 $SEG6_USER lb da fd00::3 veth4 fd00::11 fd00::12
+
+for ns in ns4 ns5; do
+	ip netns exec $ns ip -6 addr add fb00::6/128 dev lo
+	ip netns exec $ns ip -6 addr add fd00::1/128 dev lo
+	ip netns exec $ns ip -6 addr add fd00::2/128 dev lo
+	ip netns exec $ns sysctl net.ipv6.conf.all.seg6_enabled=1 > /dev/null
+	ip netns exec $ns sysctl net.ipv6.conf.lo.seg6_enabled=1 > /dev/null
+done
+ip netns exec ns4 ip -6 addr add fd00::11/128 dev lo
+ip netns exec ns4 sysctl net.ipv6.conf.veth6.seg6_enabled=1 > /dev/null
+ip netns exec ns5 ip -6 addr add fd00::12/128 dev lo
+ip netns exec ns5 sysctl net.ipv6.conf.veth8.seg6_enabled=1 > /dev/null
+
+ip netns exec ns2 sysctl net.ipv6.conf.all.forwarding=1 > /dev/null
+ip netns exec ns3 sysctl net.ipv6.conf.all.forwarding=1 > /dev/null
+
+# SRH mode, the service SID is the last segment
+send_flow 10
+
+# DA mode
+ip netns exec ns2 ip -6 route replace fb00::6 encap seg6 mode encap segs fd00::3,fd00::2 dev veth3
+send_flow 10
+
+# DA mode cannot replace the last segment
+ip netns exec ns2 ip -6 route replace fb00::6 encap seg6 mode encap segs fd00::3 dev veth3
+if send_flow 2; then
+	exit 1
+fi
+
+exit 0
@@ -0,0 +1,120 @@
+#!/bin/bash
+# Checks how netdevsim emulates the offload of seg6 and seg6local routes.
+#
+# The seg6-encap and seg6-local devlink resources of a netdevsim device are
+# sized to 2 entries each. Routes are then added to table 100 of the initial
+# namespace, the only one netdevsim devlink instances live in:
+#
+# - supported encap policies and seg6local actions are marked "offload" and
+#   accounted, until their resource is full
+# - HMAC policies, policies of more than 8 segments and End.BPF actions are
+#   marked "trap" and not accounted
+# - replacing or deleting a route releases its entry, so that the occupancy
+#   of both resources is 0 once the routes are gone
+
+SIM_DEV=sim0
+DL_DEV=netdevsim/$SIM_DEV
+DUMMY_DEV=dummy_seg6
+TABLE=100
+
+cleanup()
+{
+	if [ "$?" = "0" ]; then
+		echo "selftests: test_seg6_offload [PASS]";
+	else
+		echo "selftests: test_seg6_offload [FAILED]";
+	fi
+
+	set +e
+	ip -6 route flush table $TABLE 2> /dev/null
+	ip link del $DUMMY_DEV 2> /dev/null
+	ip link del $SIM_DEV 2> /dev/null
+}
+
+# occ <resource>
+occ()
+{
+	devlink resource show $DL_DEV | \
+		sed -n "s/.*name $1 .* occ \([0-9]*\) .*/\1/p"
+}
+
+# check_occ <resource> <expected occupancy>
+check_occ()
+{
+	[ "$(occ $1)" = "$2" ]
+}
+
+# check_flag <prefix> offload|trap
+check_flag()
+{
+	ip -6 route show table $TABLE $1 | grep -qw $2
+}
+
+set -e
+
+trap cleanup 0 2 3 6 9
+
+ip link add $SIM_DEV type netdevsim
+ip link add $DUMMY_DEV type dummy
+ip link set dev $DUMMY_DEV up
+
+devlink resource set $DL_DEV path /IPv6/seg6-encap size 2
+devlink resource set $DL_DEV path /IPv6/seg6-local size 2
+devlink dev reload $DL_DEV
+
+check_occ seg6-encap 0
+check_occ seg6-local 0
+
+# supported routes are offloaded
+ip -6 route add 2001:db8:1::/64 table $TABLE dev $DUMMY_DEV \
+	encap seg6 mode encap segs fc00::1,fc00::2
+check_flag 2001:db8:1::/64 offload
+ip -6 route add fc00:1::1/128 table $TABLE dev $DUMMY_DEV \
+	encap seg6local action End
+check_flag fc00:1::1/128 offload
+check_occ seg6-encap 1
+check_occ seg6-local 1
+
+# HMAC, more than 8 segments and End.BPF are trapped, and not accounted
+ip -6 route add 2001:db8:2::/64 table $TABLE dev $DUMMY_DEV \
+	encap seg6 mode encap segs fc00::1 hmac 42
+check_flag 2001:db8:2::/64 trap
+ip -6 route add 2001:db8:3::/64 table $TABLE dev $DUMMY_DEV \
+	encap seg6 mode encap \
+	segs fc00::1,fc00::2,fc00::3,fc00::4,fc00::5,fc00::6,fc00::7,fc00::8,fc00::9
+check_flag 2001:db8:3::/64 trap
+ip -6 route add fc00:1::2/128 table $TABLE dev $DUMMY_DEV \
+	encap seg6local action End.BPF obj test_lwt_seg6local.o sec add_egr_x
+check_flag fc00:1::2/128 trap
+check_occ seg6-encap 1
+check_occ seg6-local 1
+
+# routes beyond the size of the resource are trapped
+ip -6 route add 2001:db8:4::/64 table $TABLE dev $DUMMY_DEV \
+	encap seg6 mode inline segs fc00::1
+check_flag 2001:db8:4::/64 offload
+ip -6 route add 2001:db8:5::/64 table $TABLE dev $DUMMY_DEV \
+	encap seg6 mode encap segs fc00::3
+check_flag 2001:db8:5::/64 trap
+check_occ seg6-encap 2
+
+# replacing an offloaded route releases its entry
+ip -6 route replace 2001:db8:4::/64 table $TABLE dev $DUMMY_DEV \
+	encap seg6 mode encap segs fc00::1 hmac 42
+check_flag 2001:db8:4::/64 trap
+check_occ seg6-encap 1
+ip -6 route replace 2001:db8:4::/64 table $TABLE dev $DUMMY_DEV \
+	encap seg6 mode encap segs fc00::4
+check_flag 2001:db8:4::/64 offload
+check_occ seg6-encap 2
+ip -6 route replace fc00:1::1/128 table $TABLE dev $DUMMY_DEV \
+	encap seg6local action End.X nh6 fc00::1
+check_flag fc00:1::1/128 offload
+check_occ seg6-local 1
+
+# deleting routes releases their entries
+ip -6 route flush table $TABLE
+check_occ seg6-encap 0
+check_occ seg6-local 0
+
+exit 0
@@ -10467,6 +10467,101 @@ static struct bpf_test tests[] = {
 		.prog_type = BPF_PROG_TYPE_XDP,
 		.result = ACCEPT,
 	},
+	{
+		"calls: inlined leaf with own stack",
+		.insns = {
+			/* main prog */
+			BPF_ST_MEM(BPF_DW, BPF_REG_10, -8, 1),
+			BPF_MOV64_IMM(BPF_REG_1, 40),
+			BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 1, 0, 3),
+			BPF_LDX_MEM(BPF_DW, BPF_REG_1, BPF_REG_10, -8),
+			BPF_ALU64_REG(BPF_ADD, BPF_REG_0, BPF_REG_1),
+			BPF_EXIT_INSN(),
+
+			/* subprog 1, must not clobber the caller's stack */
+			BPF_STX_MEM(BPF_DW, BPF_REG_10, BPF_REG_1, -8),
+			BPF_MOV64_REG(BPF_REG_2, BPF_REG_10),
+			BPF_LDX_MEM(BPF_DW, BPF_REG_0, BPF_REG_2, -8),
+			BPF_ALU64_IMM(BPF_ADD, BPF_REG_0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.prog_type = BPF_PROG_TYPE_XDP,
+		.result = ACCEPT,
+		.retval = 42,
+	},
+	{
+		"calls: inlined leaf with several exits",
+		.insns = {
+			/* main prog */
+			BPF_MOV64_IMM(BPF_REG_1, 50),
+			BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 1, 0, 1),
+			BPF_EXIT_INSN(),
+
+			/* subprog 1 */
+			BPF_JMP_IMM(BPF_JGT, BPF_REG_1, 10, 2),
+			BPF_MOV64_IMM(BPF_REG_0, 1),
+			BPF_EXIT_INSN(),
+			BPF_MOV64_IMM(BPF_REG_0, 42),
+			BPF_EXIT_INSN(),
+		},
+		.prog_type = BPF_PROG_TYPE_XDP,
+		.result = ACCEPT,
+		.retval = 42,
+	},
+	{
+		"calls: inlined leaf at several call sites",
+		.insns = {
+			/* main prog */
+			BPF_ST_MEM(BPF_DW, BPF_REG_10, -8, 2),
+			BPF_MOV64_IMM(BPF_REG_1, 20),
+			BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 1, 0, 7),
+			BPF_MOV64_REG(BPF_REG_6, BPF_REG_0),
+			BPF_MOV64_IMM(BPF_REG_1, 20),
+			BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 1, 0, 4),
+			BPF_ALU64_REG(BPF_ADD, BPF_REG_0, BPF_REG_6),
+			BPF_LDX_MEM(BPF_DW, BPF_REG_1, BPF_REG_10, -8),
+			BPF_ALU64_REG(BPF_ADD, BPF_REG_0, BPF_REG_1),
+			BPF_EXIT_INSN(),
+
+			/* subprog 1 */
+			BPF_STX_MEM(BPF_DW, BPF_REG_10, BPF_REG_1, -8),
+			BPF_LDX_MEM(BPF_DW, BPF_REG_0, BPF_REG_10, -8),
+			BPF_EXIT_INSN(),
+		},
+		.prog_type = BPF_PROG_TYPE_XDP,
+		.result = ACCEPT,
+		.retval = 42,
+	},
+	{
+		"calls: leaf not inlined when it would overflow another call",
+		.insns = {
+			/* main prog, 256 bytes of stack */
+			BPF_ST_MEM(BPF_DW, BPF_REG_10, -256, 1),
+			BPF_MOV64_IMM(BPF_REG_1, 40),
+			BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 1, 0, 6),
+			BPF_MOV64_REG(BPF_REG_6, BPF_REG_0),
+			BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 1, 0, 7),
+			BPF_ALU64_REG(BPF_ADD, BPF_REG_0, BPF_REG_6),
+			BPF_LDX_MEM(BPF_DW, BPF_REG_1, BPF_REG_10, -256),
+			BPF_ALU64_REG(BPF_ADD, BPF_REG_0, BPF_REG_1),
+			BPF_EXIT_INSN(),
+
+			/* subprog 1, inlining it would grow main to 512 bytes */
+			BPF_STX_MEM(BPF_DW, BPF_REG_10, BPF_REG_1, -256),
+			BPF_LDX_MEM(BPF_DW, BPF_REG_0, BPF_REG_10, -256),
+			BPF_EXIT_INSN(),
+
+			/* subprog 2, clobbers r6 so it is never inlined */
+			BPF_MOV64_IMM(BPF_REG_6, 1),
+			BPF_ST_MEM(BPF_DW, BPF_REG_10, -256, 0),
+			BPF_LDX_MEM(BPF_DW, BPF_REG_0, BPF_REG_10, -256),
+			BPF_ALU64_REG(BPF_ADD, BPF_REG_0, BPF_REG_6),
+			BPF_EXIT_INSN(),
+		},
+		.prog_type = BPF_PROG_TYPE_XDP,
+		.result = ACCEPT,
+		.retval = 42,
+	},
 	{
 		"calls: two calls with stack write",
 		.insns = {
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <linux/bpf.h>
+#include "bpf_helpers.h"
+
+#define XDP_LIVE_ACTION		0	/* verdict to return */
+#define XDP_LIVE_IFINDEX	1	/* target of XDP_REDIRECT */
+#define XDP_LIVE_RUNS		2	/* number of frames seen */
+
+struct bpf_map_def SEC("maps") xdp_live = {
+	.type = BPF_MAP_TYPE_ARRAY,
+	.key_size = sizeof(__u32),
+	.value_size = sizeof(__u32),
+	.max_entries = 3,
+};
+
+SEC("xdp_live")
+int xdp_live_prog(struct xdp_md *ctx)
+{
+	__u32 key = XDP_LIVE_RUNS;
+	__u32 *action, *ifindex, *runs;
+
+	runs = bpf_map_lookup_elem(&xdp_live, &key);
+	if (!runs)
+		return XDP_ABORTED;
+	__sync_fetch_and_add(runs, 1);
+
+	key = XDP_LIVE_ACTION;
+	action = bpf_map_lookup_elem(&xdp_live, &key);
+	if (!action)
+		return XDP_ABORTED;
+
+	if (*action != XDP_REDIRECT)
+		return *action;
+
+	key = XDP_LIVE_IFINDEX;
+	ifindex = bpf_map_lookup_elem(&xdp_live, &key);
+	if (!ifindex)
+		return XDP_ABORTED;
+
+	return bpf_redirect(*ifindex, 0);
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Helper of flower_srh.sh for the SRH keys of cls_flower, which tc does
+ * not know about. Adds an IPv6 flower filter on the clsact ingress of
+ * <dev>, whose gact action of index <index> counts the matched packets
+ * and lets classification continue:
+ *
+ *   <dev> <pref> <index> [sl <n>] [tag <n>] [active <addr>] [last <addr>]
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/pkt_cls.h>
+#include <linux/pkt_sched.h>
+#include <linux/tc_act/tc_gact.h>
+
+struct nl_req {
+	struct nlmsghdr nh;
+	struct tcmsg tcm;
+	char buf[1024];
+};
+
+static struct rtattr *nl_attr(struct nlmsghdr *nh, int type,
+			      const void *data, int len)
+{
+	struct rtattr *rta;
+
+	rta = (struct rtattr *)((char *)nh + NLMSG_ALIGN(nh->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len)
+		memcpy(RTA_DATA(rta), data, len);
+	nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+
+	return rta;
+}
+
+static void nl_nest_end(struct nlmsghdr *nh, struct rtattr *nest)
+{
+	nest->rta_len = (char *)nh + nh->nlmsg_len - (char *)nest;
+}
+
+static int add_filter(int argc, char **argv)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+	struct tc_gact gact = {
+		.action = TC_ACT_UNSPEC,
+	};
+	struct rtattr *opts, *acts, *act, *aopts;
+	__be16 proto = htons(ETH_P_IPV6);
+	struct nlmsgerr *err;
+	struct in6_addr seg;
+	struct nl_req req;
+	int fd, len, ifindex;
+	__be16 tag;
+	__u8 sl;
+
+	ifindex = if_nametoindex(argv[0]);
+	if (!ifindex)
+		return -ENODEV;
+	gact.index = strtoul(argv[2], NULL, 0);
+
+	memset(&req, 0, sizeof(req));
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+	req.nh.nlmsg_type = RTM_NEWTFILTER;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE |
+			     NLM_F_EXCL;
+	req.tcm.tcm_family = AF_UNSPEC;
+	req.tcm.tcm_ifindex = ifindex;
+	req.tcm.tcm_parent = TC_H_MAKE(TC_H_CLSACT, TC_H_MIN_INGRESS);
+	req.tcm.tcm_info = TC_H_MAKE(strtoul(argv[1], NULL, 0) << 16, proto);
+
+	nl_attr(&req.nh, TCA_KIND, "flower", sizeof("flower"));
+	opts = nl_attr(&req.nh, TCA_OPTIONS, NULL, 0);
+	nl_attr(&req.nh, TCA_FLOWER_KEY_ETH_TYPE, &proto, sizeof(proto));
+
+	for (argc -= 3, argv += 3; argc > 1; argc -= 2, argv += 2) {
+		if (!strcmp(argv[0], "sl")) {
+			sl = strtoul(argv[1], NULL, 0);
+			nl_attr(&req.nh, TCA_FLOWER_KEY_SRH_SEGMENTS_LEFT, &sl,
+				sizeof(sl));
+		} else if (!strcmp(argv[0], "tag")) {
+			tag = htons(strtoul(argv[1], NULL, 0));
+			nl_attr(&req.nh, TCA_FLOWER_KEY_SRH_TAG, &tag,
+				sizeof(tag));
+		} else if (!strcmp(argv[0], "active") &&
+			   inet_pton(AF_INET6, argv[1], &seg) == 1) {
+			nl_attr(&req.nh, TCA_FLOWER_KEY_SRH_ACTIVE_SEG, &seg,
+				sizeof(seg));
+		} else if (!strcmp(argv[0], "last") &&
+			   inet_pton(AF_INET6, argv[1], &seg) == 1) {
+			nl_attr(&req.nh, TCA_FLOWER_KEY_SRH_LAST_SEG, &seg,
+				sizeof(seg));
+		} else {
+			return -EINVAL;
+		}
+	}
+	if (argc)
+		return -EINVAL;
+
+	acts = nl_attr(&req.nh, TCA_FLOWER_ACT, NULL, 0);
+	act = nl_attr(&req.nh, 1, NULL, 0);
+	nl_attr(&req.nh, TCA_ACT_KIND, "gact", sizeof("gact"));
+	aopts = nl_attr(&req.nh, TCA_ACT_OPTIONS, NULL, 0);
+	nl_attr(&req.nh, TCA_GACT_PARMS, &gact, sizeof(gact));
+	nl_nest_end(&req.nh, aopts);
+	nl_nest_end(&req.nh, act);
+	nl_nest_end(&req.nh, acts);
+	nl_nest_end(&req.nh, opts);
+
+	fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (fd < 0)
+		return -errno;
+
+	if (sendto(fd, &req, req.nh.nlmsg_len, 0, (struct sockaddr *)&sa,
+		   sizeof(sa)) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	len = recv(fd, &req, sizeof(req), 0);
+	close(fd);
+	if (len < (int)NLMSG_LENGTH(sizeof(*err)))
+		return -EPROTO;
+
+	err = NLMSG_DATA(&req.nh);
+	return err->error;
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+
+	if (argc < 4) {
+		fprintf(stderr, "usage: %s <dev> <pref> <index> [sl <n>] "
+			"[tag <n>] [active <addr>] [last <addr>]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	err = add_filter(argc - 1, argv + 1);
+	if (err) {
+		errno = -err;
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Checks the SRH keys of cls_flower. NS1 encapsulates pings to
+# 2001:db8:2::1 with the segments fc00::1,fc00::2,fc00::3 and the tag 42,
+# so that NS2 receives an SRH with 2 segments left, fc00::1 as the active
+# segment and fc00::3 as the last one. Each flower filter on the ingress of
+# NS2 counts what it matches in its own gact action, and lets the packet
+# through to the next filter.
+
+NS1=flowersrh1
+NS2=flowersrh2
+FLOWER_SRH=./flower_srh
+SEG6_ROUTE=./seg6_route
+COUNT=3
+
+ret=0
+
+log_test()
+{
+	local rc=$1
+	local msg="$2"
+
+	if [ ${rc} -eq 0 ]; then
+		printf "    TEST: %-60s  [ OK ]\n" "${msg}"
+	else
+		ret=1
+		printf "    TEST: %-60s  [FAIL]\n" "${msg}"
+	fi
+}
+
+# filter <index> <keys>...
+filter()
+{
+	local index=$1
+
+	shift
+	ip netns exec $NS2 $FLOWER_SRH veth2 $index $index "$@"
+}
+
+# check_count <index> <expected packets>
+check_count()
+{
+	ip netns exec $NS2 tc -s actions get action gact index $1 | \
+		grep -q "Sent [0-9]* bytes $2 pkt"
+}
+
+cleanup()
+{
+	ip netns del $NS1 &> /dev/null
+	ip netns del $NS2 &> /dev/null
+}
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "SKIP: need root privileges"
+	exit 4
+fi
+
+if ! ping6 -V > /dev/null 2>&1; then
+	echo "SKIP: ping6 not available"
+	exit 4
+fi
+
+trap cleanup EXIT
+
+set -e
+ip netns add $NS1
+ip netns add $NS2
+ip link add veth1 netns $NS1 type veth peer name veth2 netns $NS2
+
+# no link-local address, hence no traffic but the pings on the veths
+ip -netns $NS1 link set dev veth1 addrgenmode none arp off
+ip -netns $NS2 link set dev veth2 addrgenmode none
+ip -netns $NS1 link set dev lo up
+ip -netns $NS1 link set dev veth1 up
+ip -netns $NS2 link set dev veth2 up
+
+ip -netns $NS1 -6 addr add 2001:db8:1::1/128 dev lo
+ip -netns $NS1 -6 route add fc00::1 dev veth1
+ip netns exec $NS1 $SEG6_ROUTE add 2001:db8:2::/64 dev veth1 \
+	segs fc00::1,fc00::2,fc00::3 tag 42
+
+ip netns exec $NS2 tc qdisc add dev veth2 clsact
+filter 1 sl 2
+filter 2 sl 1
+filter 3 tag 42
+filter 4 tag 43
+filter 5 active fc00::1
+filter 6 active fc00::3
+filter 7 last fc00::3
+filter 8 last fc00::1
+filter 9 sl 2 tag 42 active fc00::1 last fc00::3
+filter 10 sl 2 tag 43 active fc00::1 last fc00::3
+set +e
+
+ip netns exec $NS1 ping6 -q -c $COUNT -i 0.1 -W 1 2001:db8:2::1 > /dev/null
+
+check_count 1 $COUNT && check_count 2 0
+log_test $? "segments left"
+
+check_count 3 $COUNT && check_count 4 0
+log_test $? "tag"
+
+check_count 5 $COUNT && check_count 6 0
+log_test $? "active segment"
+
+check_count 7 $COUNT && check_count 8 0
+log_test $? "last segment"
+
+check_count 9 $COUNT && check_count 10 0
+log_test $? "all SRH keys"
+
+exit $ret
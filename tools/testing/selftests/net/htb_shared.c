@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Helper of htb_shared.sh for the TCA_HTB_SHARED class attribute, which
+ * tc does not know about:
+ *
+ *   set <dev> <classid> <pool>	(re)configure an HTB class at 10mbit,
+ *				in pool <pool>, 0 detaching it
+ *   show <dev>			print "<classid> <pool>" for every HTB
+ *				class of <dev>, pool 0 meaning none
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/pkt_sched.h>
+
+#define RATE	(10 * 1000 * 1000 / 8)	/* bytes per second */
+
+struct nl_req {
+	struct nlmsghdr nh;
+	struct tcmsg tcm;
+	char buf[512];
+};
+
+static struct rtattr *nl_attr(struct nlmsghdr *nh, int type,
+			      const void *data, int len)
+{
+	struct rtattr *rta;
+
+	rta = (struct rtattr *)((char *)nh + NLMSG_ALIGN(nh->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len)
+		memcpy(RTA_DATA(rta), data, len);
+	nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+
+	return rta;
+}
+
+static int parse_handle(const char *str, __u32 *handle)
+{
+	unsigned int maj, min;
+
+	if (sscanf(str, "%x:%x", &maj, &min) != 2 || maj > 0xffff ||
+	    min > 0xffff)
+		return -EINVAL;
+
+	*handle = TC_H_MAKE(maj << 16, min);
+	return 0;
+}
+
+static int nl_open(void)
+{
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (fd < 0)
+		perror("socket");
+	return fd;
+}
+
+static int set_class(int fd, int ifindex, __u32 classid, __u32 pool)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+	struct tc_htb_opt opt = {
+		.rate = {
+			.rate = RATE,
+			.linklayer = TC_LINKLAYER_ETHERNET,
+		},
+		.ceil = {
+			.rate = RATE,
+			.linklayer = TC_LINKLAYER_ETHERNET,
+		},
+		/* 10ms of burst, in psched ticks of 64ns */
+		.buffer = 10 * 1000 * 1000 / 64,
+		.cbuffer = 10 * 1000 * 1000 / 64,
+	};
+	struct rtattr *opts;
+	struct nlmsgerr *err;
+	struct nl_req req;
+	char ack[1024];
+	int len;
+
+	memset(&req, 0, sizeof(req));
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+	req.nh.nlmsg_type = RTM_NEWTCLASS;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE;
+	req.tcm.tcm_family = AF_UNSPEC;
+	req.tcm.tcm_ifindex = ifindex;
+	req.tcm.tcm_handle = classid;
+	req.tcm.tcm_parent = TC_H_MAJ(classid);
+
+	nl_attr(&req.nh, TCA_KIND, "htb", sizeof("htb"));
+	opts = nl_attr(&req.nh, TCA_OPTIONS, NULL, 0);
+	nl_attr(&req.nh, TCA_HTB_PARMS, &opt, sizeof(opt));
+	nl_attr(&req.nh, TCA_HTB_SHARED, &pool, sizeof(pool));
+	opts->rta_len = (char *)&req.nh + req.nh.nlmsg_len - (char *)opts;
+
+	if (sendto(fd, &req, req.nh.nlmsg_len, 0, (struct sockaddr *)&sa,
+		   sizeof(sa)) < 0)
+		return -errno;
+
+	len = recv(fd, ack, sizeof(ack), 0);
+	if (len < (int)NLMSG_LENGTH(sizeof(*err)))
+		return -EPROTO;
+
+	err = NLMSG_DATA((struct nlmsghdr *)ack);
+	return err->error;
+}
+
+static void show_class(struct nlmsghdr *nh)
+{
+	struct tcmsg *tcm = NLMSG_DATA(nh);
+	struct rtattr *rta, *opt;
+	int len, olen;
+	__u32 pool = 0;
+	int htb = 0;
+
+	len = nh->nlmsg_len - NLMSG_LENGTH(sizeof(*tcm));
+	for (rta = TCA_RTA(tcm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == TCA_KIND)
+			htb = !strcmp(RTA_DATA(rta), "htb");
+		if (rta->rta_type != TCA_OPTIONS)
+			continue;
+
+		olen = RTA_PAYLOAD(rta);
+		for (opt = RTA_DATA(rta); RTA_OK(opt, olen);
+		     opt = RTA_NEXT(opt, olen))
+			if (opt->rta_type == TCA_HTB_SHARED)
+				pool = *(__u32 *)RTA_DATA(opt);
+	}
+
+	if (htb)
+		printf("%x:%x %u\n", TC_H_MAJ(tcm->tcm_handle) >> 16,
+		       TC_H_MIN(tcm->tcm_handle), pool);
+}
+
+static int show_classes(int fd, int ifindex)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+	struct nlmsghdr *nh;
+	struct nl_req req;
+	char buf[16384];
+	int len;
+
+	memset(&req, 0, sizeof(req));
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+	req.nh.nlmsg_type = RTM_GETTCLASS;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.tcm.tcm_family = AF_UNSPEC;
+	req.tcm.tcm_ifindex = ifindex;
+
+	if (sendto(fd, &req, req.nh.nlmsg_len, 0, (struct sockaddr *)&sa,
+		   sizeof(sa)) < 0)
+		return -errno;
+
+	for (;;) {
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0)
+			return -errno;
+
+		for (nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, len);
+		     nh = NLMSG_NEXT(nh, len)) {
+			if (nh->nlmsg_type == NLMSG_DONE)
+				return 0;
+			if (nh->nlmsg_type == NLMSG_ERROR)
+				return ((struct nlmsgerr *)NLMSG_DATA(nh))->error;
+			if (nh->nlmsg_type == RTM_NEWTCLASS)
+				show_class(nh);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	__u32 classid, pool;
+	int fd, ifindex, err;
+
+	if (argc < 3)
+		goto usage;
+
+	ifindex = if_nametoindex(argv[2]);
+	if (!ifindex) {
+		perror(argv[2]);
+		return EXIT_FAILURE;
+	}
+
+	fd = nl_open();
+	if (fd < 0)
+		return EXIT_FAILURE;
+
+	if (!strcmp(argv[1], "set") && argc == 5) {
+		if (parse_handle(argv[3], &classid))
+			goto usage;
+		pool = strtoul(argv[4], NULL, 0);
+		err = set_class(fd, ifindex, classid, pool);
+	} else if (!strcmp(argv[1], "show") && argc == 3) {
+		err = show_classes(fd, ifindex);
+	} else {
+		goto usage;
+	}
+	close(fd);
+
+	if (err) {
+		errno = -err;
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+
+usage:
+	fprintf(stderr, "usage: %s set <dev> <classid> <pool>\n"
+		"       %s show <dev>\n", argv[0], argv[0]);
+	return EXIT_FAILURE;
+}
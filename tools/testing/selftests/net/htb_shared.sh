@@ -0,0 +1,77 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Checks the TCA_HTB_SHARED attribute of HTB classes, which puts classes of
+# the HTB instances grafted on the queues of an mq root in one token pool:
+# classes join a pool, are dumped with it, stay in it when reconfigured by
+# tools unaware of pools, and leave it only when given pool 0.
+
+DEV=htbshared0
+HTB_SHARED=./htb_shared
+
+ret=0
+
+log_test()
+{
+	local rc=$1
+	local msg="$2"
+
+	if [ ${rc} -eq 0 ]; then
+		printf "    TEST: %-60s  [ OK ]\n" "${msg}"
+	else
+		ret=1
+		printf "    TEST: %-60s  [FAIL]\n" "${msg}"
+	fi
+}
+
+# check_pool <classid> <pool>
+check_pool()
+{
+	$HTB_SHARED show $DEV | grep -qx "$1 $2"
+}
+
+cleanup()
+{
+	ip link del $DEV &> /dev/null
+}
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "SKIP: need root privileges"
+	exit 4
+fi
+
+trap cleanup EXIT
+
+set -e
+ip link add $DEV numtxqueues 2 type dummy
+ip link set dev $DEV up
+tc qdisc add dev $DEV root handle 1: mq
+tc qdisc add dev $DEV parent 1:1 handle 10: htb
+tc qdisc add dev $DEV parent 1:2 handle 20: htb
+tc class add dev $DEV parent 10: classid 10:1 htb rate 10mbit
+tc class add dev $DEV parent 20: classid 20:1 htb rate 10mbit
+set +e
+
+check_pool 10:1 0 && check_pool 20:1 0
+log_test $? "classes start without a pool"
+
+$HTB_SHARED set $DEV 10:1 7 && $HTB_SHARED set $DEV 20:1 7
+log_test $? "attach classes of two queues to one pool"
+
+check_pool 10:1 7 && check_pool 20:1 7
+log_test $? "dump the pool of both classes"
+
+tc class change dev $DEV parent 10: classid 10:1 htb rate 20mbit && \
+	check_pool 10:1 7
+log_test $? "reconfiguring a class without the attribute keeps its pool"
+
+$HTB_SHARED set $DEV 10:1 0 && check_pool 10:1 0 && check_pool 20:1 7
+log_test $? "detach a class with pool 0"
+
+$HTB_SHARED set $DEV 10:1 8 && check_pool 10:1 8 && check_pool 20:1 7
+log_test $? "move a class to another pool"
+
+tc class del dev $DEV classid 20:1 && ! check_pool 20:1 7
+log_test $? "delete a class in a pool"
+
+exit $ret
@@ -42,6 +42,17 @@
 #	and check that configured MTU is used on link creation and changes, and
 #	that MTU is properly calculated instead when MTU is not configured from
 #	userspace
+#
+# - pmtu_seg6_exception
+#	Set up a seg6 encap policy with an MTU on a router forwarding from A
+#	to a third namespace. Check that policies with an MTU too small for
+#	their headers are refused, and that packets exceeding the MTU minus
+#	the encapsulation headers create a route exception on the sender with
+#	that PMTU, through an ICMPv6 Packet Too Big from the router
+#
+# - pmtu_seg6_mss_clamp
+#	Same setup, with MSS clamping enabled on the policy: check that the
+#	MSS option of forwarded TCP SYNs is lowered to fit the policy MTU
 
 tests="
 	pmtu_vti6_exception		vti6: PMTU exceptions
@@ -50,12 +61,16 @@ tests="
 	pmtu_vti6_default_mtu		vti6: default MTU assignment
 	pmtu_vti4_link_add_mtu		vti4: MTU setting on link creation
 	pmtu_vti6_link_add_mtu		vti6: MTU setting on link creation
-	pmtu_vti6_link_change_mtu	vti6: MTU changes on link changes"
+	pmtu_vti6_link_change_mtu	vti6: MTU changes on link changes
+	pmtu_seg6_exception		seg6: PMTU exceptions
+	pmtu_seg6_mss_clamp		seg6: MSS clamping of forwarded SYNs"
 
 NS_A="ns-$(mktemp -u XXXXXX)"
 NS_B="ns-$(mktemp -u XXXXXX)"
+NS_C="ns-$(mktemp -u XXXXXX)"
 ns_a="ip netns exec ${NS_A}"
 ns_b="ip netns exec ${NS_B}"
+ns_c="ip netns exec ${NS_C}"
 
 veth4_a_addr="192.168.1.1"
 veth4_b_addr="192.168.1.2"
@@ -75,6 +90,15 @@ dummy6_0_addr="fc00:1000::0"
 dummy6_1_addr="fc00:1001::0"
 dummy6_mask="64"
 
+seg6_b_addr="fd00:3::b"
+seg6_c_addr="fd00:3::c"
+seg6_mask="64"
+seg6_sid="fc00:3::c"
+seg6_dst="fd00:4::c"
+seg6_mtu=1400
+# outer IPv6 header and SRH with one segment
+seg6_headroom=$((40 + 8 + 16))
+
 cleanup_done=1
 err_buf=
 
@@ -161,6 +185,39 @@ setup_xfrm6() {
 	setup_xfrm 6 ${veth6_a_addr} ${veth6_b_addr}
 }
 
+# B steers traffic towards ${seg6_dst} into a seg6 encap policy, ending on C
+setup_seg6() {
+	[ -x ./seg6_route ] || return 1
+	ip netns add ${NS_C} || return 1
+
+	${ns_b} ip link add veth_bc type veth peer name veth_cb || return 1
+	${ns_b} ip link set veth_cb netns ${NS_C}
+
+	${ns_b} ip addr add ${seg6_b_addr}/${seg6_mask} dev veth_bc nodad
+	${ns_c} ip addr add ${seg6_c_addr}/${seg6_mask} dev veth_cb nodad
+	${ns_c} ip addr add ${seg6_sid}/128 dev lo
+	${ns_c} ip addr add ${seg6_dst}/128 dev lo
+
+	${ns_b} ip link set veth_bc up
+	${ns_c} ip link set veth_cb up
+	${ns_c} ip link set lo up
+
+	${ns_a} ip route add ${seg6_dst} via ${veth6_b_addr}
+	${ns_c} ip route add ${veth6_a_addr} via ${seg6_b_addr}
+	${ns_b} ip route add ${seg6_sid} via ${seg6_c_addr}
+
+	${ns_b} sysctl -qw net.ipv6.conf.all.forwarding=1
+	${ns_c} sysctl -qw net.ipv6.conf.all.seg6_enabled=1
+	${ns_c} sysctl -qw net.ipv6.conf.veth_cb.seg6_enabled=1
+
+	# wait for DAD on the addresses of setup_veth
+	sleep 2
+}
+
+seg6_route_add() {
+	${ns_b} ./seg6_route add ${seg6_dst}/128 dev veth_bc segs ${seg6_sid} "${@}"
+}
+
 setup() {
 	[ "$(id -u)" -ne 0 ] && echo "  need to run as root" && return 1
 
@@ -174,6 +231,7 @@ cleanup() {
 	[ ${cleanup_done} -eq 1 ] && return
 	ip netns del ${NS_A} 2 > /dev/null
 	ip netns del ${NS_B} 2 > /dev/null
+	ip netns del ${NS_C} 2> /dev/null
 	cleanup_done=1
 }
 
@@ -439,6 +497,79 @@ test_pmtu_vti6_link_change_mtu() {
 	return ${fail}
 }
 
+test_pmtu_seg6_exception() {
+	setup namespaces veth seg6 || return 2
+
+	# The policy must carry IPv6 minimum sized packets
+	if seg6_route_add mtu $((seg6_headroom + 1280)) 2> /dev/null; then
+		err "  seg6 policy accepted with MTU $((seg6_headroom + 1280))"
+		return 1
+	fi
+
+	seg6_route_add mtu ${seg6_mtu}
+	[ $? -ne 0 ] && err "  seg6 policy MTU not supported" && return 2
+
+	# Fit the policy MTU without the encapsulation, check that no exception
+	# is created
+	ping_payload=$((seg6_mtu - seg6_headroom - 40 - 8))
+	${ns_a} ping6 -q -i 0.1 -w 2 -s ${ping_payload} ${seg6_dst} > /dev/null
+	pmtu="$(route_get_dst_pmtu_from_exception "${ns_a}" ${seg6_dst})"
+	if [ "${pmtu}" != "" ]; then
+		err "  unexpected exception created with PMTU ${pmtu}"
+		return 1
+	fi
+
+	# Exceed it by one byte, check that the exception has the policy MTU
+	# minus the encapsulation headers
+	${ns_a} ping6 -q -i 0.1 -w 2 -s $((ping_payload + 1)) ${seg6_dst} > /dev/null
+	pmtu="$(route_get_dst_pmtu_from_exception "${ns_a}" ${seg6_dst})"
+	if [ "${pmtu}" = "" ]; then
+		err "  exception not created for packets exceeding the policy MTU"
+		return 1
+	fi
+
+	if [ ${pmtu} -ne $((seg6_mtu - seg6_headroom)) ]; then
+		err "  wrong PMTU ${pmtu} in exception, expected: $((seg6_mtu - seg6_headroom))"
+		return 1
+	fi
+}
+
+test_pmtu_seg6_mss_clamp() {
+	setup namespaces veth seg6 || return 2
+
+	tcpdump --version > /dev/null 2>&1
+	[ $? -ne 0 ] && err "  tcpdump not available" && return 2
+
+	seg6_route_add mtu ${seg6_mtu} mssclamp
+	[ $? -ne 0 ] && err "  seg6 policy MSS clamping not supported" && return 2
+
+	# C decapsulates the SYN and receives it again on veth_cb, where the
+	# filter sees the TCP header right after the IPv6 one
+	dump=$(mktemp)
+	${ns_c} tcpdump -nvl -c 1 -i veth_cb "ip6[6] == 6 and ip6[53] & 2 != 0" > ${dump} 2> /dev/null &
+	dump_pid=$!
+	sleep 1
+
+	${ns_c} nc -6 -l -p 7331 > /dev/null &
+	nc_pid=$!
+	sleep 1
+	${ns_a} nc -6 -w 1 ${seg6_dst} 7331 < /dev/null
+	sleep 1
+
+	kill ${nc_pid} ${dump_pid} 2> /dev/null
+	wait ${dump_pid} 2> /dev/null
+
+	mss=$(sed -n 's/.*mss \([0-9]*\).*/\1/p' ${dump} | head -1)
+	rm -f ${dump}
+
+	# policy MTU minus the encapsulation, IPv6 and TCP headers
+	exp=$((seg6_mtu - seg6_headroom - 40 - 20))
+	if [ "${mss}" != "${exp}" ]; then
+		err "  SYN MSS is ${mss:-not found}, expected: ${exp}"
+		return 1
+	fi
+}
+
 trap cleanup EXIT
 
 exitcode=0
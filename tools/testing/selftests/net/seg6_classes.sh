@@ -0,0 +1,131 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Checks that seg6 encap policies with traffic classes pick the segment
+# list of the class matching the mark or the DSCP of each packet, and the
+# default one for packets matching no class.
+#
+# The first segments fc00::a, fc00::b and fc00::c are each routed through
+# their own veth, so that the tx counter of the veth tells which segment
+# list a packet was given:
+#
+#   2001:db8:2::/64  default fc00::a, mark 1 -> fc00::b, mark 2 -> fc00::c
+#   2001:db8:3::/64  default fc00::a, DSCP 10 -> fc00::b, DSCP 46 -> fc00::c
+
+NS=seg6cls
+SEG6_ROUTE=./seg6_route
+COUNT=3
+
+ret=0
+
+log_test()
+{
+	local rc=$1
+	local msg="$2"
+
+	if [ ${rc} -eq 0 ]; then
+		printf "    TEST: %-60s  [ OK ]\n" "${msg}"
+	else
+		ret=1
+		printf "    TEST: %-60s  [FAIL]\n" "${msg}"
+	fi
+}
+
+tx_packets()
+{
+	ip netns exec $NS cat /sys/class/net/$1/statistics/tx_packets
+}
+
+# check_path <segment dev> <ping options>...
+#
+# pings the destination COUNT times and succeeds if all the packets went
+# out of the given device, and none out of the others
+check_path()
+{
+	local dev=$1
+	local -A before
+	local d
+
+	shift
+	for d in a0 b0 c0; do
+		before[$d]=$(tx_packets $d)
+	done
+
+	ip netns exec $NS ping6 -q -c $COUNT -i 0.1 -W 1 "$@" > /dev/null
+
+	for d in a0 b0 c0; do
+		if [ $d = $dev ]; then
+			[ $(($(tx_packets $d) - before[$d])) -eq $COUNT ] || return 1
+		else
+			[ $(tx_packets $d) -eq ${before[$d]} ] || return 1
+		fi
+	done
+}
+
+cleanup()
+{
+	ip netns del $NS &> /dev/null
+}
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "SKIP: need root privileges"
+	exit 4
+fi
+
+if ! ping6 -V > /dev/null 2>&1; then
+	echo "SKIP: ping6 not available"
+	exit 4
+fi
+
+trap cleanup EXIT
+
+set -e
+ip netns add $NS
+ip -netns $NS link set dev lo up
+ip -netns $NS -6 addr add 2001:db8:1::1/128 dev lo
+
+# no link-local address, hence no DAD, RS or MLD traffic on the veths
+for d in a b c; do
+	ip -netns $NS link add ${d}0 type veth peer name ${d}1
+	ip -netns $NS link set dev ${d}0 addrgenmode none arp off
+	ip -netns $NS link set dev ${d}1 addrgenmode none
+	ip -netns $NS link set dev ${d}0 up
+	ip -netns $NS link set dev ${d}1 up
+	ip -netns $NS -6 route add fc00::$d dev ${d}0
+done
+
+ip netns exec $NS $SEG6_ROUTE add 2001:db8:2::/64 dev a0 segs fc00::a \
+	key mark class 1 fc00::b class 2 fc00::c
+ip netns exec $NS $SEG6_ROUTE add 2001:db8:3::/64 dev a0 segs fc00::a \
+	key dscp class 10 fc00::b class 46 fc00::c
+set +e
+
+check_path b0 -m 1 2001:db8:2::1
+log_test $? "mark 1 selects its class"
+
+check_path c0 -m 2 2001:db8:2::1
+log_test $? "mark 2 selects its class"
+
+check_path a0 -m 7 2001:db8:2::1
+log_test $? "unknown mark falls back to the default segments"
+
+check_path a0 2001:db8:2::1
+log_test $? "unmarked packets use the default segments"
+
+check_path b0 -Q 0x28 2001:db8:3::1
+log_test $? "DSCP 10 selects its class"
+
+check_path c0 -Q 0xb8 2001:db8:3::1
+log_test $? "DSCP 46 selects its class"
+
+check_path a0 -Q 0x20 2001:db8:3::1
+log_test $? "unknown DSCP falls back to the default segments"
+
+# the DSCP of a policy keyed on the mark does not matter, and conversely
+check_path a0 -Q 0xb8 2001:db8:2::1
+log_test $? "mark policy ignores the DSCP"
+
+check_path a0 -m 1 2001:db8:3::1
+log_test $? "DSCP policy ignores the mark"
+
+exit $ret
@@ -0,0 +1,132 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Checks that the netfilter flowtable fast path pushes the seg6 encap of
+# flows routed through a seg6 route:
+#
+#   NS1 ---------------- NS2 ---------------- NS3
+#   2001:db8:1::1   encap seg6 towards   fd00::3 (decap)
+#                   fd00::3, flowtable   2001:db8:3::3
+#
+# A TCP transfer from 2001:db8:1::1 to 2001:db8:3::3 must complete while
+# most of its packets skip the forward chain of NS2. With seg6_flowlabel
+# enabled, the outer flowlabel of the flow must not change when it moves
+# from the slow path to the fast path.
+
+TMP_FILE="/tmp/selftest_seg6_flowtable"
+SIZE=4096	# KiB sent through the tunnel
+
+cleanup()
+{
+	if [ "$?" = "0" ]; then
+		echo "selftests: seg6_flowtable [PASS]";
+	else
+		echo "selftests: seg6_flowtable [FAILED]";
+	fi
+
+	set +e
+	ip netns del ns1 2> /dev/null
+	ip netns del ns2 2> /dev/null
+	ip netns del ns3 2> /dev/null
+	rm -f $TMP_FILE.*
+}
+
+# number of packets that went through the forward chain of NS2
+forwarded()
+{
+	ip netns exec ns2 nft list chain inet filter forward | \
+		sed -n 's/.*counter packets \([0-9]*\) .*/\1/p'
+}
+
+if ! nft --version > /dev/null 2>&1; then
+	echo "SKIP: nft not available"
+	exit 4
+fi
+
+set -e
+
+ip netns add ns1
+ip netns add ns2
+ip netns add ns3
+
+trap cleanup 0 2 3 6 9
+
+ip link add veth1 netns ns1 type veth peer name veth2 netns ns2
+ip link add veth3 netns ns2 type veth peer name veth4 netns ns3
+
+# room for the outer header and the SRH
+ip -netns ns2 link set dev veth3 mtu 1600
+ip -netns ns3 link set dev veth4 mtu 1600
+
+for ns in ns1 ns2 ns3; do
+	ip -netns $ns link set dev lo up
+done
+ip -netns ns1 link set dev veth1 up
+ip -netns ns2 link set dev veth2 up
+ip -netns ns2 link set dev veth3 up
+ip -netns ns3 link set dev veth4 up
+
+ip -netns ns1 -6 addr add 2001:db8:1::1/64 dev veth1 nodad
+ip -netns ns1 -6 route add default via 2001:db8:1::2
+
+ip -netns ns2 -6 addr add 2001:db8:1::2/64 dev veth2 nodad
+ip -netns ns2 -6 addr add 2001:db8:2::2/64 dev veth3 nodad
+ip -netns ns2 -6 route add fd00::3 via 2001:db8:2::3 dev veth3
+ip -netns ns2 -6 route add 2001:db8:3::/64 dev veth3 \
+	encap seg6 mode encap segs fd00::3
+ip netns exec ns2 sysctl -qw net.ipv6.conf.all.forwarding=1
+ip netns exec ns2 sysctl -qw net.ipv6.seg6_flowlabel=1
+
+ip -netns ns3 -6 addr add 2001:db8:2::3/64 dev veth4 nodad
+ip -netns ns3 -6 addr add fd00::3/128 dev lo
+ip -netns ns3 -6 addr add 2001:db8:3::3/128 dev lo
+ip -netns ns3 -6 route add default via 2001:db8:2::2
+ip netns exec ns3 sysctl -qw net.ipv6.conf.all.seg6_enabled=1
+ip netns exec ns3 sysctl -qw net.ipv6.conf.veth4.seg6_enabled=1
+
+ip netns exec ns2 nft -f - <<EOF
+table inet filter {
+	flowtable f {
+		hook ingress priority 0
+		devices = { veth2, veth3 }
+	}
+
+	chain forward {
+		type filter hook forward priority 0; policy accept;
+		meta l4proto tcp flow offload @f
+		counter
+	}
+}
+EOF
+
+if tcpdump --version > /dev/null 2>&1; then
+	ip netns exec ns3 tcpdump -nvl -i veth4 "ip6 dst fd00::3" \
+		> $TMP_FILE.dump 2> /dev/null &
+	dump=$!
+	sleep 1
+fi
+
+ip netns exec ns3 nc -l -6 -p 7331 > $TMP_FILE.out &
+recv=$!
+sleep 1
+
+dd if=/dev/urandom of=$TMP_FILE.in bs=1024 count=$SIZE 2> /dev/null
+ip netns exec ns1 nc -6 -w 5 -s 2001:db8:1::1 2001:db8:3::3 7331 \
+	< $TMP_FILE.in
+wait $recv
+
+cmp -s $TMP_FILE.in $TMP_FILE.out
+
+# a few packets set the flow up, the others take the fast path
+[ $(forwarded) -lt $((SIZE / 16)) ]
+
+if [ -n "$dump" ]; then
+	sleep 1
+	kill $dump
+	wait $dump || true
+
+	[ $(grep -o 'flowlabel 0x[0-9a-f]*' $TMP_FILE.dump | \
+		sort -u | wc -l) -eq 1 ]
+fi
+
+exit 0
@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Helper of seg6_oam.sh for the End.OAM behaviour, which iproute2 does not
+ * know about.
+ *
+ *   route <sid> dev <dev> [flags <n>]
+ *	adds an End.OAM route for <sid>/128, with the given SEG6_LOCAL_OAM
+ *	flags if any
+ *
+ *   probe <dst> [via <seg>] [tstamp <ifindex>]
+ *	sends an ICMPv6 echo request to <dst>, through the segment <seg> if
+ *	any, and succeeds if a reply comes back from <dst>. With tstamp, the
+ *	reply must carry an SRH with a timestamp TLV of the given ingress
+ *	ifindex, and without it no routing header at all.
+ */
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/icmp6.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/ipv6.h>
+#include <linux/lwtunnel.h>
+#include <linux/seg6.h>
+#include <linux/seg6_local.h>
+
+#define ECHO_ID		0x5336
+#define TIMEOUT_MS	2000
+/* rx and tx times at the SID must be this close to ours, same clock */
+#define TSTAMP_SLACK_NS	(10 * 1000000000LL)
+
+struct nl_req {
+	struct nlmsghdr nh;
+	struct rtmsg rtm;
+	char buf[1024];
+};
+
+static struct rtattr *nl_attr(struct nlmsghdr *nh, int type,
+			      const void *data, int len)
+{
+	struct rtattr *rta;
+
+	rta = (struct rtattr *)((char *)nh + NLMSG_ALIGN(nh->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len)
+		memcpy(RTA_DATA(rta), data, len);
+	nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+
+	return rta;
+}
+
+static void nl_nest_end(struct nlmsghdr *nh, struct rtattr *nest)
+{
+	nest->rta_len = (char *)nh + nh->nlmsg_len - (char *)nest;
+}
+
+static int add_route(int argc, char **argv)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+	__u32 action = SEG6_LOCAL_ACTION_END_OAM;
+	__u16 encap_type = LWTUNNEL_ENCAP_SEG6_LOCAL;
+	struct nlmsgerr *err;
+	struct rtattr *nest;
+	struct in6_addr dst;
+	struct nl_req req;
+	int fd, len, oif;
+	__u32 flags;
+
+	if ((argc != 3 && argc != 5) || strcmp(argv[1], "dev"))
+		return -EINVAL;
+
+	if (inet_pton(AF_INET6, argv[0], &dst) != 1)
+		return -EINVAL;
+
+	oif = if_nametoindex(argv[2]);
+	if (!oif)
+		return -ENODEV;
+
+	memset(&req, 0, sizeof(req));
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+	req.nh.nlmsg_type = RTM_NEWROUTE;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE |
+			     NLM_F_EXCL;
+	req.rtm.rtm_family = AF_INET6;
+	req.rtm.rtm_dst_len = 128;
+	req.rtm.rtm_table = RT_TABLE_MAIN;
+	req.rtm.rtm_protocol = RTPROT_BOOT;
+	req.rtm.rtm_scope = RT_SCOPE_UNIVERSE;
+	req.rtm.rtm_type = RTN_UNICAST;
+
+	nl_attr(&req.nh, RTA_DST, &dst, sizeof(dst));
+	nl_attr(&req.nh, RTA_OIF, &oif, sizeof(oif));
+	nl_attr(&req.nh, RTA_ENCAP_TYPE, &encap_type, sizeof(encap_type));
+	nest = nl_attr(&req.nh, RTA_ENCAP, NULL, 0);
+	nl_attr(&req.nh, SEG6_LOCAL_ACTION, &action, sizeof(action));
+	if (argc == 5) {
+		if (strcmp(argv[3], "flags"))
+			return -EINVAL;
+		flags = strtoul(argv[4], NULL, 0);
+		nl_attr(&req.nh, SEG6_LOCAL_OAM, &flags, sizeof(flags));
+	}
+	nl_nest_end(&req.nh, nest);
+
+	fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (fd < 0)
+		return -errno;
+
+	if (sendto(fd, &req, req.nh.nlmsg_len, 0, (struct sockaddr *)&sa,
+		   sizeof(sa)) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	len = recv(fd, &req, sizeof(req), 0);
+	close(fd);
+	if (len < (int)NLMSG_LENGTH(sizeof(*err)))
+		return -EPROTO;
+
+	err = NLMSG_DATA(&req.nh);
+	return err->error;
+}
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static unsigned long long be64_get(const __be64 *p)
+{
+	const unsigned char *b = (const unsigned char *)p;
+	unsigned long long v = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		v = v << 8 | b[i];
+
+	return v;
+}
+
+/* the SRH of a reply has a single segment, the prober, and one TLV */
+static int check_tstamp(struct ipv6_sr_hdr *srh, int len, int ifindex,
+			long long sent)
+{
+	struct sr6_tlv_tstamp *tlv;
+	long long rx, tx;
+
+	if (len < (int)(sizeof(*srh) + sizeof(struct in6_addr) +
+			sizeof(*tlv)) ||
+	    srh->type != IPV6_SRCRT_TYPE_4 || srh->first_segment)
+		return -EBADMSG;
+
+	tlv = (struct sr6_tlv_tstamp *)(srh->segments + 1);
+	if (tlv->type != SR6_TLV_TIMESTAMP ||
+	    tlv->len != sizeof(*tlv) - sizeof(struct sr6_tlv) ||
+	    ntohl(tlv->ifindex) != (__u32)ifindex)
+		return -EBADMSG;
+
+	rx = be64_get(&tlv->rx_tstamp);
+	tx = be64_get(&tlv->tx_tstamp);
+	if (rx > tx || rx < sent - TSTAMP_SLACK_NS ||
+	    tx > now_ns() + TSTAMP_SLACK_NS)
+		return -EBADMSG;
+
+	return 0;
+}
+
+static int probe(int argc, char **argv)
+{
+	char srhbuf[sizeof(struct ipv6_sr_hdr) + 2 * sizeof(struct in6_addr)];
+	struct ipv6_sr_hdr *srh = (struct ipv6_sr_hdr *)srhbuf;
+	struct sockaddr_in6 dst = {
+		.sin6_family = AF_INET6,
+	};
+	struct icmp6_hdr req = {
+		.icmp6_type = ICMP6_ECHO_REQUEST,
+		.icmp6_id = htons(ECHO_ID),
+		.icmp6_seq = htons(1),
+	};
+	int fd, ret, on = 1, ifindex = 0, rthdr = 0;
+	char buf[1024], cbuf[1024];
+	struct icmp6_filter filter;
+	struct sockaddr_in6 from;
+	struct icmp6_hdr *reply;
+	struct cmsghdr *cmsg;
+	struct pollfd pfd;
+	struct msghdr msg;
+	struct iovec iov;
+	long long sent;
+
+	if (argc < 1 || inet_pton(AF_INET6, argv[0], &dst.sin6_addr) != 1)
+		return -EINVAL;
+
+	memset(srhbuf, 0, sizeof(srhbuf));
+	for (argc--, argv++; argc > 1; argc -= 2, argv += 2) {
+		if (!strcmp(argv[0], "via") &&
+		    inet_pton(AF_INET6, argv[1], &srh->segments[1]) == 1) {
+			srh->hdrlen = 4;
+			srh->type = IPV6_SRCRT_TYPE_4;
+			srh->segments_left = 1;
+			srh->first_segment = 1;
+		} else if (!strcmp(argv[0], "tstamp")) {
+			ifindex = strtoul(argv[1], NULL, 0);
+		} else {
+			return -EINVAL;
+		}
+	}
+	if (argc)
+		return -EINVAL;
+
+	fd = socket(AF_INET6, SOCK_RAW, IPPROTO_ICMPV6);
+	if (fd < 0)
+		return -errno;
+
+	ICMP6_FILTER_SETBLOCKALL(&filter);
+	ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY, &filter);
+	if (setsockopt(fd, IPPROTO_ICMPV6, ICMP6_FILTER, &filter,
+		       sizeof(filter)) ||
+	    setsockopt(fd, IPPROTO_IPV6, IPV6_RECVRTHDR, &on, sizeof(on)) ||
+	    (srh->type && setsockopt(fd, IPPROTO_IPV6, IPV6_RTHDR, srh,
+				     sizeof(srhbuf)))) {
+		ret = -errno;
+		goto out;
+	}
+
+	sent = now_ns();
+	if (sendto(fd, &req, sizeof(req), 0, (struct sockaddr *)&dst,
+		   sizeof(dst)) < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	for (;;) {
+		ret = poll(&pfd, 1, TIMEOUT_MS);
+		if (ret <= 0) {
+			ret = ret ? -errno : -ETIMEDOUT;
+			goto out;
+		}
+
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf);
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &from;
+		msg.msg_namelen = sizeof(from);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+
+		ret = recvmsg(fd, &msg, 0);
+		if (ret < 0) {
+			ret = -errno;
+			goto out;
+		}
+
+		reply = (struct icmp6_hdr *)buf;
+		if (ret >= (int)sizeof(*reply) &&
+		    reply->icmp6_id == htons(ECHO_ID) &&
+		    IN6_ARE_ADDR_EQUAL(&from.sin6_addr, &dst.sin6_addr))
+			break;
+	}
+
+	ret = 0;
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != IPPROTO_IPV6 ||
+		    cmsg->cmsg_type != IPV6_RTHDR)
+			continue;
+
+		rthdr = 1;
+		if (ifindex)
+			ret = check_tstamp((struct ipv6_sr_hdr *)CMSG_DATA(cmsg),
+					   cmsg->cmsg_len - CMSG_LEN(0),
+					   ifindex, sent);
+	}
+	if (!ret && rthdr != !!ifindex)
+		ret = -EBADMSG;
+
+out:
+	close(fd);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+
+	if (argc < 2)
+		goto usage;
+
+	if (!strcmp(argv[1], "route"))
+		err = add_route(argc - 2, argv + 2);
+	else if (!strcmp(argv[1], "probe"))
+		err = probe(argc - 2, argv + 2);
+	else
+		goto usage;
+
+	if (err) {
+		errno = -err;
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+
+usage:
+	fprintf(stderr, "usage: %s route <sid> dev <dev> [flags <n>]\n"
+		"       %s probe <dst> [via <seg>] [tstamp <ifindex>]\n",
+		argv[0], argv[0]);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,81 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Checks the End.OAM behaviour of seg6local. NS1 probes the SIDs of NS2:
+#
+#   fc00::100  End.OAM without flags, replies carry no routing header
+#   fc00::200  End.OAM with SEG6_LOCAL_OAM_TSTAMP, replies carry an SRH
+#              with a timestamp TLV of the ingress interface of NS2
+#
+# The SIDs are not addresses of NS2, so only End.OAM can answer them.
+
+NS1=seg6oam1
+NS2=seg6oam2
+SEG6_OAM=./seg6_oam
+
+ret=0
+
+log_test()
+{
+	local rc=$1
+	local msg="$2"
+
+	if [ ${rc} -eq 0 ]; then
+		printf "    TEST: %-60s  [ OK ]\n" "${msg}"
+	else
+		ret=1
+		printf "    TEST: %-60s  [FAIL]\n" "${msg}"
+	fi
+}
+
+cleanup()
+{
+	ip netns del $NS1 &> /dev/null
+	ip netns del $NS2 &> /dev/null
+}
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "SKIP: need root privileges"
+	exit 4
+fi
+
+trap cleanup EXIT
+
+set -e
+ip netns add $NS1
+ip netns add $NS2
+ip link add veth1 netns $NS1 type veth peer name veth2 netns $NS2
+
+for ns in $NS1 $NS2; do
+	ip netns exec $ns sysctl -qw net.ipv6.conf.all.seg6_enabled=1
+	ip -netns $ns link set dev lo up
+done
+ip netns exec $NS1 sysctl -qw net.ipv6.conf.veth1.seg6_enabled=1
+ip netns exec $NS2 sysctl -qw net.ipv6.conf.veth2.seg6_enabled=1
+ip -netns $NS1 link set dev veth1 up
+ip -netns $NS2 link set dev veth2 up
+
+ip -netns $NS1 -6 addr add 2001:db8:1::1/64 dev veth1 nodad
+ip -netns $NS2 -6 addr add 2001:db8:1::2/64 dev veth2 nodad
+ip -netns $NS1 -6 route add fc00::/16 via 2001:db8:1::2
+
+ip netns exec $NS2 $SEG6_OAM route fc00::100 dev veth2
+ip netns exec $NS2 $SEG6_OAM route fc00::200 dev veth2 flags 1
+ifindex=$(ip netns exec $NS2 cat /sys/class/net/veth2/ifindex)
+set +e
+
+ip netns exec $NS1 $SEG6_OAM probe fc00::100
+log_test $? "echo request answered by the SID"
+
+ip netns exec $NS1 $SEG6_OAM probe fc00::200 tstamp $ifindex
+log_test $? "reply carries a timestamp TLV"
+
+# fc00::100 has segments left and forwards the probe to fc00::200
+ip netns exec $NS1 $SEG6_OAM probe fc00::200 via fc00::100 tstamp $ifindex
+log_test $? "SID with segments left acts as End"
+
+ip netns exec $NS2 $SEG6_OAM route fc00::300 dev veth2 flags 2 2> /dev/null
+[ $? -ne 0 ]
+log_test $? "unknown OAM flags are rejected"
+
+exit $ret
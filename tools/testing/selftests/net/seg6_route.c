@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Helper of the seg6 selftests for the seg6 encap attributes iproute2
+ * does not know about. Adds, in the current namespace, an encap policy
+ * steering <prefix> into the segments <segs> (comma separated, first
+ * segment first):
+ *
+ *   add <prefix>/<len> dev <dev> segs <segs> [tag <tag>]
+ *	[key mark|dscp] [class <value> <segs>]... [mtu <mtu>] [mssclamp]
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/ipv6.h>
+#include <linux/lwtunnel.h>
+#include <linux/seg6.h>
+#include <linux/seg6_iptunnel.h>
+
+#define SEGS_MAX	16
+#define SRH_MAX		(sizeof(struct ipv6_sr_hdr) + \
+			 SEGS_MAX * sizeof(struct in6_addr))
+
+struct nl_req {
+	struct nlmsghdr nh;
+	struct rtmsg rtm;
+	char buf[4096];
+};
+
+static struct rtattr *nl_attr(struct nlmsghdr *nh, int type,
+			      const void *data, int len)
+{
+	struct rtattr *rta;
+
+	rta = (struct rtattr *)((char *)nh + NLMSG_ALIGN(nh->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len)
+		memcpy(RTA_DATA(rta), data, len);
+	nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+
+	return rta;
+}
+
+static void nl_nest_end(struct nlmsghdr *nh, struct rtattr *nest)
+{
+	nest->rta_len = (char *)nh + nh->nlmsg_len - (char *)nest;
+}
+
+/* build the SRH of segs into srh as iproute2 does, return its length */
+static int parse_srh(char *segs, struct ipv6_sr_hdr *srh)
+{
+	struct in6_addr addrs[SEGS_MAX];
+	char *seg, *save;
+	int i, nr = 0;
+
+	for (seg = strtok_r(segs, ",", &save); seg;
+	     seg = strtok_r(NULL, ",", &save)) {
+		if (nr == SEGS_MAX || inet_pton(AF_INET6, seg, &addrs[nr]) != 1)
+			return -EINVAL;
+		nr++;
+	}
+
+	if (!nr)
+		return -EINVAL;
+
+	memset(srh, 0, sizeof(*srh));
+	srh->hdrlen = 2 * nr;
+	srh->type = IPV6_SRCRT_TYPE_4;
+	srh->segments_left = nr - 1;
+	srh->first_segment = nr - 1;
+	for (i = 0; i < nr; i++)
+		srh->segments[nr - 1 - i] = addrs[i];
+
+	return sizeof(*srh) + nr * sizeof(struct in6_addr);
+}
+
+static int add_route(int argc, char **argv)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+	char tuninfo[sizeof(struct seg6_iptunnel_encap) + SRH_MAX];
+	struct seg6_iptunnel_encap *encap = (void *)tuninfo;
+	__u16 encap_type = LWTUNNEL_ENCAP_SEG6;
+	struct rtattr *nest, *list = NULL, *class;
+	__u32 key = SEG6_IPTUN_CLASS_NONE;
+	char srh[SRH_MAX], *plen;
+	struct nlmsgerr *err;
+	struct in6_addr dst;
+	struct nl_req req;
+	__u32 value, mtu;
+	char ack[1024];
+	int fd, len, oif;
+
+	if (argc < 5 || strcmp(argv[1], "dev") || strcmp(argv[3], "segs"))
+		return -EINVAL;
+
+	plen = strchr(argv[0], '/');
+	if (!plen)
+		return -EINVAL;
+	*plen++ = '\0';
+	if (inet_pton(AF_INET6, argv[0], &dst) != 1)
+		return -EINVAL;
+
+	oif = if_nametoindex(argv[2]);
+	if (!oif)
+		return -ENODEV;
+
+	encap->mode = SEG6_IPTUN_MODE_ENCAP;
+	len = parse_srh(argv[4], encap->srh);
+	if (len < 0)
+		return len;
+
+	if (argc > 6 && !strcmp(argv[5], "tag")) {
+		encap->srh->tag = htons(strtoul(argv[6], NULL, 0));
+		argc -= 2, argv += 2;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+	req.nh.nlmsg_type = RTM_NEWROUTE;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE |
+			     NLM_F_EXCL;
+	req.rtm.rtm_family = AF_INET6;
+	req.rtm.rtm_dst_len = atoi(plen);
+	req.rtm.rtm_table = RT_TABLE_MAIN;
+	req.rtm.rtm_protocol = RTPROT_BOOT;
+	req.rtm.rtm_scope = RT_SCOPE_UNIVERSE;
+	req.rtm.rtm_type = RTN_UNICAST;
+
+	nl_attr(&req.nh, RTA_DST, &dst, sizeof(dst));
+	nl_attr(&req.nh, RTA_OIF, &oif, sizeof(oif));
+	nl_attr(&req.nh, RTA_ENCAP_TYPE, &encap_type, sizeof(encap_type));
+	nest = nl_attr(&req.nh, RTA_ENCAP, NULL, 0);
+	nl_attr(&req.nh, SEG6_IPTUNNEL_SRH, tuninfo, sizeof(*encap) + len);
+
+	for (argc -= 5, argv += 5; argc; argc--, argv++) {
+		if (!strcmp(argv[0], "key") && argc > 1) {
+			if (!strcmp(argv[1], "mark"))
+				key = SEG6_IPTUN_CLASS_MARK;
+			else if (!strcmp(argv[1], "dscp"))
+				key = SEG6_IPTUN_CLASS_DSCP;
+			else
+				return -EINVAL;
+			nl_attr(&req.nh, SEG6_IPTUNNEL_CLASS_KEY, &key,
+				sizeof(key));
+			argc--, argv++;
+		} else if (!strcmp(argv[0], "class") && argc > 2) {
+			if (!list)
+				list = nl_attr(&req.nh, SEG6_IPTUNNEL_CLASSES,
+					       NULL, 0);
+			len = parse_srh(argv[2], (struct ipv6_sr_hdr *)srh);
+			if (len < 0)
+				return len;
+			value = strtoul(argv[1], NULL, 0);
+			class = nl_attr(&req.nh, SEG6_IPTUNNEL_CLASS, NULL, 0);
+			nl_attr(&req.nh, SEG6_IPTUNNEL_CLASS_VALUE, &value,
+				sizeof(value));
+			nl_attr(&req.nh, SEG6_IPTUNNEL_CLASS_SRH, srh, len);
+			nl_nest_end(&req.nh, class);
+			nl_nest_end(&req.nh, list);
+			argc -= 2, argv += 2;
+		} else if (!strcmp(argv[0], "mtu") && argc > 1) {
+			mtu = strtoul(argv[1], NULL, 0);
+			nl_attr(&req.nh, SEG6_IPTUNNEL_MTU, &mtu, sizeof(mtu));
+			argc--, argv++;
+		} else if (!strcmp(argv[0], "mssclamp")) {
+			nl_attr(&req.nh, SEG6_IPTUNNEL_MSS_CLAMP, NULL, 0);
+		} else {
+			return -EINVAL;
+		}
+	}
+	nl_nest_end(&req.nh, nest);
+
+	fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (fd < 0)
+		return -errno;
+
+	if (sendto(fd, &req, req.nh.nlmsg_len, 0, (struct sockaddr *)&sa,
+		   sizeof(sa)) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	len = recv(fd, ack, sizeof(ack), 0);
+	close(fd);
+	if (len < (int)NLMSG_LENGTH(sizeof(*err)))
+		return -EPROTO;
+
+	err = NLMSG_DATA((struct nlmsghdr *)ack);
+	return err->error;
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+
+	if (argc < 2 || strcmp(argv[1], "add"))
+		goto usage;
+
+	err = add_route(argc - 2, argv + 2);
+	if (err) {
+		errno = -err;
+		perror("add");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+
+usage:
+	fprintf(stderr, "usage: %s add <prefix>/<len> dev <dev> segs <segs> "
+		"[tag <tag>]\n"
+		"\t[key mark|dscp] [class <value> <segs>]... [mtu <mtu>] "
+		"[mssclamp]\n", argv[0]);
+	return EXIT_FAILURE;
+}